@@ -5,7 +5,8 @@ debug.getinfo = nil
 
 --- Runs given callbacks.
 --
--- Note: this function is also called from C++
+-- Note: callbacks run from C++ are dispatched natively, see
+-- ScriptApiBase::runCallbacksRaw
 -- @tparam table  callbacks a table with registered callbacks, like `core.registered_on_*`
 -- @tparam number mode      a RunCallbacksMode, as defined in src/script/common/c_internal.h
 -- @param         ...       arguments for the callback
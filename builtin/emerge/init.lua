@@ -0,0 +1,20 @@
+core.log("info", "Initializing mapgen environment")
+
+-- The mapgen environment has the same helpers and read-only registration
+-- data as the async environment
+dofile(core.get_builtin_path() .. "async" .. DIR_DELIM .. "game.lua")
+core.job_processor = nil
+
+core.callback_origins = {}
+
+core.registered_on_generateds = {}
+
+-- Called by C++ for each chunk before it is written to the map:
+-- func(vmanip, minp, maxp, blockseed)
+function core.register_on_generated(func)
+	core.registered_on_generateds[#core.registered_on_generateds + 1] = func
+	core.callback_origins[func] = {
+		mod = core.get_current_modname() or "??",
+		name = "register_on_generated"
+	}
+end
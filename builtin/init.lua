@@ -35,6 +35,7 @@ local gamepath = scriptdir .. "game" .. DIR_DELIM
 local clientpath = scriptdir .. "client" .. DIR_DELIM
 local commonpath = scriptdir .. "common" .. DIR_DELIM
 local asyncpath = scriptdir .. "async" .. DIR_DELIM
+local emergepath = scriptdir .. "emerge" .. DIR_DELIM
 
 dofile(commonpath .. "vector.lua")
 dofile(commonpath .. "strict.lua")
@@ -66,6 +67,8 @@ elseif INIT == "async"  then
 	dofile(asyncpath .. "mainmenu.lua")
 elseif INIT == "async_game" then
 	dofile(asyncpath .. "game.lua")
+elseif INIT == "emerge" then
+	dofile(emergepath .. "init.lua")
 elseif INIT == "client" then
 	dofile(clientpath .. "init.lua")
 else
@@ -42,7 +42,8 @@ function profiler.init_chatcommand()
 		instrumentation.init_chatcommand()
 	end
 
-	local param_usage = S("print [<filter>] | dump [<filter>] | save [<format> [<filter>]] | reset")
+	local param_usage = S("print [<filter>] | dump [<filter>] | save [<format> [<filter>]] | reset") ..
+		" | " .. S("native start [<interval_us>] | native stop | native save")
 	core.register_chatcommand("profiler", {
 		description = S("Handle the profiler and profiling data"),
 		params = param_usage,
@@ -61,6 +62,16 @@ function profiler.init_chatcommand()
 			elseif command == "reset" then
 				sampler.reset()
 				return true, S("Statistics were reset.")
+			elseif command == "native" then
+				if args[1] == "start" then
+					core.sampling_profiler_start(tonumber(args[2]))
+					return true, S("Native profiler started.")
+				elseif args[1] == "stop" then
+					core.sampling_profiler_stop()
+					return true, S("Native profiler stopped.")
+				elseif args[1] == "save" then
+					return reporter.save_folded(core.sampling_profiler_get_folded(true))
+				end
 			end
 
 			return false,
@@ -277,4 +277,23 @@ function reporter.save(profile, format, filter)
 	return true, S("Profile saved to @1", path)
 end
 
+---
+-- Save stacks of the native sampling profiler to the world path.
+-- The folded format can be read by flamegraph.pl and compatible tools.
+-- @return success, log message
+--
+function reporter.save_folded(content)
+	local path = get_save_path("folded")
+
+	local output, io_err = io.open(path, "w")
+	if not output then
+		return false, S("Saving of profile failed: @1", io_err)
+	end
+	output:write(content)
+	output:close()
+
+	core.log("action", "Profile saved to " .. path)
+	return true, S("Profile saved to @1", path)
+end
+
 return reporter
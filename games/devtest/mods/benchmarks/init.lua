@@ -114,4 +114,74 @@ minetest.register_chatcommand("bench_bulk_set_node", {
 	end,
 })
 
+minetest.register_chatcommand("bench_vmanip_buffer", {
+	params = "",
+	description = "Benchmark: VoxelManip data tables vs. buffers",
+	func = function(name, param)
+		local player = minetest.get_player_by_name(name)
+		if not player then
+			return false, "No player."
+		end
+		local pos = player:get_pos():round()
+		local vm = VoxelManip(pos, pos + vector.new(79, 79, 79))
 
+		minetest.chat_send_player(name, "Benchmarking VoxelManip:get_buffer ...")
+
+		local start_time = minetest.get_us_time()
+		local data = vm:get_data()
+		for i = 1, #data do
+			data[i] = data[i]
+		end
+		vm:set_data(data)
+		local middle_time = minetest.get_us_time()
+		local buf = vm:get_buffer()
+		for i = 1, #buf do
+			buf[i] = buf[i]
+		end
+		local end_time = minetest.get_us_time()
+		local msg = string.format("Benchmark results: get_data/set_data: %.2f ms; get_buffer: %.2f ms",
+			((middle_time - start_time)) / 1000,
+			((end_time - middle_time)) / 1000
+		)
+		return true, msg
+	end,
+})
+
+minetest.register_chatcommand("bench_bulk_get_node", {
+	params = "",
+	description = "Benchmark: Bulk-get 40×40×40 nodes",
+	func = function(name, param)
+		local player = minetest.get_player_by_name(name)
+		if not player then
+			return false, "No player."
+		end
+		local pos_list = {}
+		local ppos = player:get_pos():round()
+		for x=1,40 do
+			for y=1,40 do
+				for z=1,40 do
+					pos_list[#pos_list+1] = ppos:offset(x, y, z)
+				end
+			end
+		end
+
+		minetest.chat_send_player(name, "Benchmarking minetest.bulk_get_node ...")
+
+		local start_time = minetest.get_us_time()
+		for i=1,#pos_list do
+			minetest.get_node(pos_list[i])
+		end
+		local middle_time = minetest.get_us_time()
+		minetest.bulk_get_node(pos_list)
+		local middle_time2 = minetest.get_us_time()
+		minetest.bulk_get_node_raw(pos_list)
+		local end_time = minetest.get_us_time()
+		local msg = string.format("Benchmark results: minetest.get_node loop: %.2f ms; " ..
+			"minetest.bulk_get_node: %.2f ms; minetest.bulk_get_node_raw: %.2f ms",
+			((middle_time - start_time)) / 1000,
+			((middle_time2 - middle_time)) / 1000,
+			((end_time - middle_time2)) / 1000
+		)
+		return true, msg
+	end,
+})
@@ -166,3 +166,33 @@ local function test_userdata_passing2(cb, _, pos)
 	end, vm, pos)
 end
 unittests.register("test_userdata_passing2", test_userdata_passing2, {map=true, async=true})
+
+local function test_vmanip_snapshot(cb, _, pos)
+	local vm = core.get_voxel_manip(pos, pos)
+	local expect = vm:get_node_at(pos)
+	local snapshot = vm:snapshot()
+	assert(snapshot:is_snapshot() and not vm:is_snapshot())
+	assert(snapshot:snapshot() == snapshot)
+	assert(not pcall(snapshot.set_node_at, snapshot, pos, {name = "air"}))
+	assert(not pcall(snapshot.write_to_map, snapshot))
+	assert(not pcall(function() snapshot:get_buffer()[1] = 0 end))
+	assert(not pcall(function() snapshot:get_buffer():get_pointer() end))
+
+	core.handle_async(function(snapshot_, pos_)
+		assert(snapshot_:is_snapshot())
+		local data = snapshot_:get_data()
+		return snapshot_:get_node_at(pos_), #data, snapshot_
+	end, function(node, volume, snapshot2)
+		if not deepequal(expect, node) then
+			return cb("Node data mismatch")
+		end
+		if volume ~= #vm:get_data() then
+			return cb("Volume mismatch")
+		end
+		if not snapshot2:is_snapshot() then
+			return cb("Snapshot lost on the way back")
+		end
+		cb()
+	end, snapshot, pos)
+end
+unittests.register("test_vmanip_snapshot", test_vmanip_snapshot, {map=true, async=true})
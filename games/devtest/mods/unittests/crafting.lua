@@ -110,3 +110,39 @@ local function test_get_craft_result()
 	assert(output.item:is_empty())
 end
 unittests.register("test_get_craft_result", test_get_craft_result)
+
+-- Test that results cached by minetest.get_craft_result stay correct
+local function test_get_craft_result_cached()
+	local function get_result(items, width)
+		local output = minetest.get_craft_result({
+			method = "normal",
+			width = width or 2,
+			items = items,
+		})
+		return output.item
+	end
+
+	-- Repeated lookups
+	for _ = 1, 3 do
+		local item = get_result({"", "unittests:coal_lump", "", "unittests:stick"})
+		assert(item:get_name() == "unittests:torch")
+	end
+
+	-- The tool repair result depends on the wear
+	assert(get_result({"unittests:repairable_tool 1 65000",
+		"unittests:repairable_tool 1 65000"}):is_empty())
+	assert(get_result({"unittests:repairable_tool 1 60000",
+		"unittests:repairable_tool 1 60000"}):get_wear() == 51187)
+
+	-- Registering and clearing recipes invalidates the cache
+	local items = {"unittests:stick", "unittests:stick", "unittests:coal_lump"}
+	assert(get_result(items, 3):is_empty())
+	minetest.register_craft({
+		output = "unittests:steel_ingot",
+		recipe = {items},
+	})
+	assert(get_result(items, 3):get_name() == "unittests:steel_ingot")
+	minetest.clear_craft({recipe = {items}})
+	assert(get_result(items, 3):is_empty())
+end
+unittests.register("test_get_craft_result_cached", test_get_craft_result_cached)
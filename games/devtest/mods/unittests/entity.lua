@@ -130,3 +130,49 @@ local function test_entity_attach(player, pos)
 	obj:remove()
 end
 unittests.register("test_entity_attach", test_entity_attach, {player=true, map=true})
+
+local batch_log = {}
+
+core.register_entity("unittests:batched", {
+	initial_properties = {
+		visual = "upright_sprite",
+		textures = { "unittests_callback.png" },
+		static_save = false,
+	},
+
+	on_step_batch = function(entities, dtime, moveresults, count)
+		assert(#entities == count and #moveresults == count)
+		local seen = {}
+		for i = 1, count do
+			local self = entities[i]
+			assert(self.name == "unittests:batched")
+			assert(moveresults[i] == false)
+			seen[#seen+1] = self
+		end
+		batch_log[#batch_log+1] = seen
+	end,
+})
+
+local function test_entity_step_batch(cb, _, pos)
+	batch_log = {}
+	local objs = {}
+	for i = 1, 3 do
+		objs[i] = core.add_entity(pos, "unittests:batched")
+	end
+
+	core.after(0.2, function()
+		for _, obj in ipairs(objs) do
+			obj:remove()
+		end
+		if #batch_log == 0 then
+			return cb("on_step_batch was not called")
+		end
+		for _, seen in ipairs(batch_log) do
+			if #seen ~= 3 then
+				return cb("on_step_batch got " .. #seen .. " entities, expected 3")
+			end
+		end
+		cb()
+	end)
+end
+unittests.register("test_entity_step_batch", test_entity_step_batch, {map=true, async=true})
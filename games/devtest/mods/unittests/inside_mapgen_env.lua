@@ -0,0 +1,34 @@
+-- Runs in the mapgen environment, see mapgen_env.lua
+
+local marker_pos = vector.new(0, 20000, 0)
+local c_stone = core.get_content_id("basenodes:stone")
+
+local function check_env()
+	-- stuff that should not be here
+	assert(not core.get_player_by_name)
+	assert(not core.set_node)
+	assert(not core.register_node)
+	-- stuff that should be here
+	assert(core.get_mapgen_object)
+	assert(VoxelManip and ItemStack)
+	assert(core.registered_nodes["basenodes:stone"])
+end
+check_env()
+
+local function in_area(p, pmin, pmax)
+	return p.x >= pmin.x and p.x <= pmax.x and p.y >= pmin.y and
+		p.y <= pmax.y and p.z >= pmin.z and p.z <= pmax.z
+end
+
+core.register_on_generated(function(vm, minp, maxp, blockseed)
+	assert(type(blockseed) == "number")
+	local emin, emax = vm:get_emerged_area()
+	assert(in_area(minp, emin, emax) and in_area(maxp, emin, emax))
+
+	if not in_area(marker_pos, minp, maxp) then
+		return
+	end
+	local data = vm:get_data()
+	data[VoxelArea(emin, emax):indexp(marker_pos)] = c_stone
+	vm:set_data(data)
+end)
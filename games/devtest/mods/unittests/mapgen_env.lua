@@ -0,0 +1,21 @@
+core.register_mapgen_script(core.get_modpath(core.get_current_modname()) ..
+	DIR_DELIM .. "inside_mapgen_env.lua")
+
+local function test_mapgen_env(cb)
+	-- Set by inside_mapgen_env.lua when generating this chunk
+	local marker_pos = vector.new(0, 20000, 0)
+	core.emerge_area(marker_pos, marker_pos, function(blockpos, action, blocks_left)
+		if blocks_left > 0 then
+			return
+		end
+		if action == core.EMERGE_CANCELLED or action == core.EMERGE_ERRORED then
+			return cb("Emerging the marker block failed")
+		end
+		local node = core.get_node(marker_pos)
+		if node.name ~= "basenodes:stone" then
+			return cb("Marker not placed by the mapgen environment, got " .. node.name)
+		end
+		cb()
+	end)
+end
+unittests.register("test_mapgen_env", test_mapgen_env, {async=true})
@@ -81,6 +81,61 @@ unittests.register("test_punch_node", function(_, pos)
 	-- currently failing: assert(on_punch_called)
 end, {map=true})
 
+local function test_voxelmanip_buffer(_, pos)
+	local vm = VoxelManip(pos, pos)
+	local data = vm:get_data()
+	local buf = vm:get_buffer()
+	assert(#buf == #data)
+	assert(buf:len() == #data)
+	for i = 1, #data, 97 do
+		assert(buf[i] == data[i] and buf:get(i) == data[i])
+	end
+
+	-- Writes go to the VoxelManip directly
+	local c_stone = core.get_content_id("basenodes:stone")
+	buf[1] = c_stone
+	assert(vm:get_data()[1] == c_stone)
+	buf:set(2, c_stone)
+	assert(vm:get_data()[2] == c_stone)
+
+	local param2 = vm:get_buffer("param2")
+	param2[3] = 7
+	assert(vm:get_param2_data()[3] == 7)
+
+	local slice = buf:slice(2, 10)
+	assert(#slice == 9 and slice[1] == c_stone)
+	assert(not pcall(function() return slice[10] end))
+	assert(not pcall(function() buf[0] = 1 end))
+	assert(not pcall(vm.get_buffer, vm, "foo"))
+end
+unittests.register("test_voxelmanip_buffer", test_voxelmanip_buffer, {map=true})
+
+local function test_bulk_get_node(_, pos)
+	local positions = {}
+	for i = 0, 20 do
+		-- Spans several MapBlocks, in no particular order
+		positions[#positions+1] = vector.offset(pos, (i * 7) % 20, i % 3, -i)
+	end
+	positions[#positions+1] = vector.new(0, 31000, 0)
+
+	local nodes = core.bulk_get_node(positions)
+	local cids, param1s, param2s = core.bulk_get_node_raw(positions)
+	assert(#nodes == #positions and #cids == #positions)
+	for i, p in ipairs(positions) do
+		local n = core.get_node(p)
+		assert(nodes[i].name == n.name and nodes[i].param2 == n.param2)
+		assert(cids[i] == core.get_content_id(n.name))
+		assert(param1s[i] == n.param1 and param2s[i] == n.param2)
+	end
+	assert(nodes[#positions].name == "ignore")
+
+	-- Reuse of result tables
+	local buf = {}
+	assert(core.bulk_get_node_raw(positions, buf) == buf and buf[1] == cids[1])
+	assert(#core.bulk_get_node({}) == 0)
+end
+unittests.register("test_bulk_get_node", test_bulk_get_node, {map=true})
+
 local function test_compress()
 	-- This text should be compressible, to make sure the results are... normal
 	local text = "The\000 icey canoe couldn't move very well on the\128 lake. The\000 ice was too stiff and the icey canoe's paddles simply wouldn't punch through."
@@ -0,0 +1,217 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark_setup.h"
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include "client/mapblock_mesh.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "light.h"
+#include "mapblock.h"
+#include "noise.h"
+#include "porting.h"
+#include "settings.h"
+#include "threading/thread.h"
+
+/*
+	Meshes a fixed area of terrain the way the mesh update workers do, but
+	without a client or a video driver: the node tiles only get texture ids,
+	no textures. Reports the blocks per second with one thread up to
+	mesh_generation_threads threads, or one per core (at most 8) if it is 0.
+*/
+
+// Area including the neighbors of the meshed blocks
+static const v3s16 AREA_BPMIN(-3, -2, -3);
+static const v3s16 AREA_BPMAX(2, 1, 2);
+
+namespace {
+
+struct MeshNodes {
+	content_t stone, grass, water, leaves, plant;
+};
+
+}
+
+static content_t register_node(NodeDefManager *ndef, const std::string &name,
+	NodeDrawType drawtype, u32 texture_id)
+{
+	ContentFeatures f;
+	f.name = name;
+	f.drawtype = drawtype;
+	f.param_type = CPT_LIGHT;
+
+	// What ContentFeatures::updateTextures would set up
+	u8 material_type = TILE_MATERIAL_OPAQUE;
+	switch (drawtype) {
+	case NDT_LIQUID:
+		f.liquid_type = LIQUID_SOURCE;
+		f.liquid_alternative_source = name;
+		f.liquid_alternative_flowing = name;
+		f.walkable = false;
+		f.light_propagates = true;
+		f.solidness = 1;
+		material_type = TILE_MATERIAL_LIQUID_TRANSPARENT;
+		break;
+	case NDT_ALLFACES:
+		f.light_propagates = true;
+		f.solidness = 0;
+		f.visual_solidness = 1;
+		material_type = TILE_MATERIAL_BASIC;
+		break;
+	case NDT_PLANTLIKE:
+		f.walkable = false;
+		f.light_propagates = true;
+		f.sunlight_propagates = true;
+		f.solidness = 0;
+		material_type = TILE_MATERIAL_BASIC;
+		break;
+	default:
+		break;
+	}
+
+	for (TileSpec &tile : f.tiles) {
+		tile.layers[0].texture_id = texture_id;
+		tile.layers[0].material_type = material_type;
+	}
+	for (TileSpec &tile : f.special_tiles) {
+		tile.layers[0].texture_id = texture_id;
+		tile.layers[0].material_type = material_type;
+	}
+
+	return ndef->set(name, f);
+}
+
+// Hills with a lake, trees and plants, lit by the sun
+static void fill_area(Map *map, const MeshNodes &nodes)
+{
+	PcgRandom pr(42);
+	v3s16 nmin = AREA_BPMIN * MAP_BLOCKSIZE;
+	v3s16 nmax = (AREA_BPMAX + 1) * MAP_BLOCKSIZE - 1;
+
+	for (s16 z = nmin.Z; z <= nmax.Z; z++)
+	for (s16 x = nmin.X; x <= nmax.X; x++) {
+		s16 ground = 6.0f * std::sin(x * 0.15f) + 5.0f * std::cos(z * 0.11f);
+		bool tree = ground > 0 && pr.range(0, 40) == 0;
+		bool plant = ground > 0 && pr.range(0, 6) == 0;
+
+		for (s16 y = nmin.Y; y <= nmax.Y; y++) {
+			MapNode n(CONTENT_AIR, LIGHT_SUN);
+			if (y < ground)
+				n = MapNode(nodes.stone);
+			else if (y == ground)
+				n = MapNode(nodes.grass);
+			else if (y <= 0)
+				n = MapNode(nodes.water, LIGHT_SUN - 1);
+			else if (tree && y <= ground + 4)
+				n = MapNode(nodes.leaves, LIGHT_SUN - 1);
+			else if (plant && y == ground + 1)
+				n = MapNode(nodes.plant, LIGHT_SUN);
+			map->setNode(v3s16(x, y, z), n);
+		}
+	}
+}
+
+static u32 mesh_blocks(Map *map, const NodeDefManager *ndef,
+	const std::vector<v3s16> &blocks, u32 num_threads)
+{
+	std::atomic<u32> next(0);
+	std::atomic<u32> num_buffers(0);
+
+	auto worker = [&] () {
+		u32 i;
+		while ((i = next++) < blocks.size()) {
+			MeshMakeData data(ndef, nullptr, nullptr, nullptr, false);
+			data.fill(map->getBlockNoCreate(blocks[i]));
+			data.setSmoothLighting(true);
+			MapBlockMesh mesh(&data, v3s16(0, 0, 0));
+			for (int layer = 0; layer < MAX_TILE_LAYERS; layer++)
+				num_buffers += mesh.getMesh(layer)->getMeshBufferCount();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (u32 t = 1; t < num_threads; t++)
+		threads.emplace_back(worker);
+	worker();
+	for (std::thread &t : threads)
+		t.join();
+
+	return num_buffers;
+}
+
+TEST_CASE("benchmark_mapblock_mesh")
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+	MeshNodes nodes;
+	nodes.stone = register_node(ndef, "stone", NDT_NORMAL, 1);
+	nodes.grass = register_node(ndef, "grass", NDT_NORMAL, 2);
+	nodes.water = register_node(ndef, "water", NDT_LIQUID, 3);
+	nodes.leaves = register_node(ndef, "leaves", NDT_ALLFACES, 4);
+	nodes.plant = register_node(ndef, "plant", NDT_PLANTLIKE, 5);
+	ndef->resolveCrossrefs();
+
+	DummyMap map(&gamedef, AREA_BPMIN, AREA_BPMAX);
+	fill_area(&map, nodes);
+
+	std::vector<v3s16> blocks;
+	for (s16 z = AREA_BPMIN.Z + 1; z < AREA_BPMAX.Z; z++)
+	for (s16 y = AREA_BPMIN.Y + 1; y < AREA_BPMAX.Y; y++)
+	for (s16 x = AREA_BPMIN.X + 1; x < AREA_BPMAX.X; x++)
+		blocks.emplace_back(x, y, z);
+
+	// Hardware buffers can't be released without a video driver
+	std::string enable_vbo = g_settings->get("enable_vbo");
+	g_settings->setBool("enable_vbo", false);
+
+	u32 max_threads = rangelim(g_settings->getS32("mesh_generation_threads"), 0, 8);
+	if (max_threads == 0)
+		max_threads = MYMIN(8U, Thread::getNumberOfProcessors());
+	max_threads = MYMAX(1U, max_threads);
+	std::vector<u32> thread_counts;
+	for (u32 n = 1; n < max_threads; n *= 2)
+		thread_counts.push_back(n);
+	thread_counts.push_back(max_threads);
+
+	for (u32 num_threads : thread_counts) {
+		u32 num_meshed = 0;
+		u64 time_us = 0;
+
+		BENCHMARK_ADVANCED("MapBlockMesh, " + std::to_string(num_threads) +
+				" threads")(Catch::Benchmark::Chronometer meter) {
+			u64 t0 = porting::getTimeUs();
+			meter.measure([&] {
+				return mesh_blocks(&map, ndef, blocks, num_threads);
+			});
+			time_us += porting::getTimeUs() - t0;
+			num_meshed += meter.runs() * blocks.size();
+		};
+
+		if (time_us > 0) {
+			std::cout << "meshing with " << num_threads << " threads: "
+				<< (u64)(num_meshed * 1000000.0 / time_us) << " blocks/s"
+				<< std::endl;
+		}
+	}
+
+	g_settings->set("enable_vbo", enable_vbo);
+}
@@ -0,0 +1,533 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest Authors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark_setup.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include "benchmark_config.h"
+#include "content/subgames.h"
+#include "dummymap.h"
+#include "emerge.h"
+#include "filesys.h"
+#include "map_settings_manager.h"
+#include "mapgen/mapgen.h"
+#include "mapgen/mg_biome.h"
+#include "mapgen/mg_decoration.h"
+#include "mapgen/mg_ore.h"
+#include "mapgen/mg_schematic.h"
+#include "nodedef.h"
+#include "porting.h"
+#include "profiler.h"
+#include "server.h"
+#include "settings.h"
+#include "util/numeric.h"
+#include "util/string.h"
+
+/*
+	Runs makeChunk of every mapgen on a fixed set of chunks and seeds.
+
+	"benchmark_mapgen" reports the time per chunk and the throughput of the
+	individual phases, taken from the g_profiler entries of the mapgens.
+
+	"benchmark_mapgen_determinism" hashes the generated VoxelManips and
+	fails if a hash differs from the reference in benchmark_mapgen_hashes.txt,
+	e.g. when an optimisation changed the generated output, or is missing.
+	Intended changes are accepted by running it with the environment variable
+	MINETEST_UPDATE_MAPGEN_HASHES=1, which writes the hashes instead.
+*/
+
+static const char *MAPGEN_NAMES[] = {
+	"v5", "v6", "v7", "flat", "fractal", "valleys", "carpathian", "singlenode",
+};
+
+static const u64 SEEDS[] = { 1, 13371337 };
+
+// Phase name and profiler entry
+static const char *PHASES[][2] = {
+	{ "terrain",     "Mapgen: terrain [ms]" },
+	{ "caves",       "Mapgen: caves [ms]" },
+	{ "dungeons",    "Mapgen: dungeons [ms]" },
+	{ "biomes",      "Mapgen: biomes [ms]" },
+	{ "ores",        "Mapgen: ores [ms]" },
+	{ "decorations", "Mapgen: decorations [ms]" },
+	{ "lighting",    "EmergeThread: update lighting [ms]" },
+};
+
+namespace {
+
+class BenchmarkServer : public Server
+{
+public:
+	BenchmarkServer() : Server(porting::path_user + DIR_DELIM "benchmark_world",
+		SubgameSpec("fakespec", "fakespec"), true, Address(), true, nullptr)
+	{}
+
+private:
+	void SendChatMessage(session_t peer_id, const ChatMessage &message) {}
+};
+
+enum NodeKind {
+	NODE_GROUND,
+	NODE_STRUCTURE,
+	NODE_LIQUID,
+	NODE_LEAVES,
+	NODE_PLANT,
+};
+
+// One mapgen with its own EmergeManager, set up like the one of the server
+class MapgenContext
+{
+public:
+	MapgenContext(Server *server, const std::string &mgname, u64 seed);
+
+	// Same as ServerMap::initBlockMake, on blank blocks
+	std::unique_ptr<BlockMakeData> initBlockMake(v3s16 bpmin);
+
+	Mapgen *mapgen = nullptr;
+	std::vector<v3s16> chunks;
+
+private:
+	void registerDefinitions();
+
+	const NodeDefManager *m_ndef;
+	MapSettingsManager m_settings_mgr;
+	MetricsBackend m_metrics;
+	std::unique_ptr<EmergeManager> m_emerge;
+	std::unique_ptr<DummyMap> m_map;
+};
+
+}
+
+static void register_node(NodeDefManager *ndef, const std::string &name,
+	NodeKind kind)
+{
+	ContentFeatures f;
+	f.name = name;
+	f.param_type = CPT_LIGHT;
+
+	switch (kind) {
+	case NODE_GROUND:
+		f.is_ground_content = true;
+		break;
+	case NODE_STRUCTURE:
+		break;
+	case NODE_LIQUID:
+		f.drawtype = NDT_LIQUID;
+		f.liquid_type = LIQUID_SOURCE;
+		f.liquid_alternative_source = name;
+		f.liquid_alternative_flowing = name;
+		f.walkable = false;
+		f.pointable = false;
+		f.diggable = false;
+		f.buildable_to = true;
+		f.light_propagates = true;
+		break;
+	case NODE_LEAVES:
+		f.drawtype = NDT_ALLFACES_OPTIONAL;
+		f.light_propagates = true;
+		f.is_ground_content = true;
+		break;
+	case NODE_PLANT:
+		f.drawtype = NDT_PLANTLIKE;
+		f.walkable = false;
+		f.buildable_to = true;
+		f.floodable = true;
+		f.light_propagates = true;
+		f.sunlight_propagates = true;
+		break;
+	}
+	if (name == "mapgen_lava_source")
+		f.light_source = LIGHT_MAX;
+
+	ndef->set(name, f);
+}
+
+// The nodes looked up by the mapgens, registered directly instead of
+// through aliases
+static void register_mapgen_nodes(NodeDefManager *ndef)
+{
+	for (const char *name : { "mapgen_stone", "mapgen_dirt",
+			"mapgen_dirt_with_grass", "mapgen_dirt_with_snow", "mapgen_sand",
+			"mapgen_desert_sand", "mapgen_desert_stone", "mapgen_gravel",
+			"mapgen_snowblock", "mapgen_ice" })
+		register_node(ndef, name, NODE_GROUND);
+
+	for (const char *name : { "mapgen_cobble", "mapgen_mossycobble",
+			"mapgen_stair_cobble", "mapgen_stair_desert_stone", "mapgen_tree",
+			"mapgen_jungletree", "mapgen_pine_tree", "mapgen_singlenode" })
+		register_node(ndef, name, NODE_STRUCTURE);
+
+	for (const char *name : { "mapgen_water_source",
+			"mapgen_river_water_source", "mapgen_lava_source" })
+		register_node(ndef, name, NODE_LIQUID);
+
+	for (const char *name : { "mapgen_leaves", "mapgen_jungleleaves",
+			"mapgen_pine_needles", "mapgen_apple" })
+		register_node(ndef, name, NODE_LEAVES);
+
+	for (const char *name : { "mapgen_junglegrass", "mapgen_snow" })
+		register_node(ndef, name, NODE_PLANT);
+
+	ndef->setNodeRegistrationStatus(true);
+}
+
+// FNV-1a over the content and params of every node, independent of the
+// memory layout of MapNode
+static u64 hash_vmanip(const MMVManip &vm)
+{
+	u64 hash = 0xcbf29ce484222325ULL;
+	auto add = [&hash] (u8 byte) {
+		hash ^= byte;
+		hash *= 0x100000001b3ULL;
+	};
+
+	s32 volume = vm.m_area.getVolume();
+	for (s32 i = 0; i < volume; i++) {
+		const MapNode &n = vm.m_data[i];
+		content_t c = n.getContent();
+		add(c & 0xFF);
+		add(c >> 8);
+		add(n.getParam1());
+		add(n.getParam2());
+	}
+	return hash;
+}
+
+MapgenContext::MapgenContext(Server *server, const std::string &mgname, u64 seed) :
+	m_ndef(server->getNodeDefManager()),
+	m_settings_mgr("")
+{
+	// Fixed common parameters, the mapgen specific ones are the defaults
+	m_settings_mgr.setMapSetting("mg_name", mgname, true);
+	m_settings_mgr.setMapSetting("seed", std::to_string(seed), true);
+	m_settings_mgr.setMapSetting("chunksize", "5", true);
+	m_settings_mgr.setMapSetting("water_level", "1", true);
+	m_settings_mgr.setMapSetting("mg_flags",
+		"caves,dungeons,light,decorations,biomes,ores", true);
+
+	std::string num_threads = g_settings->get("num_emerge_threads");
+	g_settings->set("num_emerge_threads", "1");
+	m_emerge = std::make_unique<EmergeManager>(server, &m_metrics);
+	g_settings->set("num_emerge_threads", num_threads);
+
+	registerDefinitions();
+
+	MapgenParams *params = m_settings_mgr.makeMapgenParams();
+	m_emerge->initMapgens(params);
+	mapgen = m_emerge->getMapgen(0);
+
+	// Underground, surface and sky of a few neighbouring columns
+	s16 csize = params->chunksize;
+	v3s16 coff = v3s16(1, 1, 1) * (-csize / 2);
+	for (s16 y : { -3, -1, 0, 1 })
+	for (s16 z = 0; z <= 1; z++)
+	for (s16 x = 0; x <= 1; x++)
+		chunks.push_back(v3s16(x, y, z) * csize + coff);
+
+	// Including the border blocks
+	v3s16 bpmin = v3s16(0, -3, 0) * csize + coff - v3s16(1, 1, 1);
+	v3s16 bpmax = v3s16(1, 1, 1) * (2 * csize) + coff;
+	m_map = std::make_unique<DummyMap>(server, bpmin, bpmax);
+}
+
+static void register_biome(const NodeDefManager *ndef, BiomeManager *biomemgr,
+	const std::string &name, s16 y_min, s16 y_max,
+	const std::string &top, s16 depth_top,
+	const std::string &filler, s16 depth_filler,
+	const std::string &riverbed, s16 depth_riverbed,
+	const std::vector<std::string> &cave_liquids)
+{
+	Biome *b = BiomeManager::create(BIOMETYPE_NORMAL);
+	b->name = name;
+	b->depth_top = depth_top;
+	b->depth_filler = depth_filler;
+	b->depth_water_top = 0;
+	b->depth_riverbed = depth_riverbed;
+	b->heat_point = 50.0f;
+	b->humidity_point = 50.0f;
+	b->vertical_blend = 0;
+	b->flags = 0;
+	b->min_pos = v3s16(-31000, y_min, -31000);
+	b->max_pos = v3s16(31000, y_max, 31000);
+
+	std::vector<std::string> &nn = b->m_nodenames;
+	nn.push_back(top);
+	nn.push_back(filler);
+	nn.push_back(""); // stone
+	nn.push_back(""); // water_top
+	nn.push_back(""); // water
+	nn.push_back(""); // river_water
+	nn.push_back(riverbed);
+	nn.push_back(""); // dust
+	nn.insert(nn.end(), cave_liquids.begin(), cave_liquids.end());
+	if (cave_liquids.empty())
+		nn.emplace_back("ignore");
+	b->m_nnlistsizes.push_back(std::max<size_t>(cave_liquids.size(), 1));
+	nn.emplace_back("mapgen_cobble");
+	nn.emplace_back("mapgen_mossycobble");
+	nn.emplace_back("mapgen_stair_cobble");
+
+	ndef->pendNodeResolve(b);
+	biomemgr->add(b);
+}
+
+void MapgenContext::registerDefinitions()
+{
+	// The biomes of devtest's mapgen mod
+	BiomeManager *biomemgr = m_emerge->getWritableBiomeManager();
+	register_biome(m_ndef, biomemgr, "grassland", 4, 31000,
+		"mapgen_dirt_with_grass", 1, "mapgen_dirt", 1, "mapgen_sand", 2, {});
+	register_biome(m_ndef, biomemgr, "grassland_ocean", -255, 3,
+		"mapgen_sand", 1, "mapgen_sand", 3, "mapgen_sand", 2,
+		{ "mapgen_water_source" });
+	register_biome(m_ndef, biomemgr, "grassland_under", -31000, -256,
+		"", 0, "", -31000, "", 0,
+		{ "mapgen_water_source", "mapgen_lava_source" });
+
+	// Devtest has no ores and decorations, these resemble the common ones
+	// of games
+	OreManager *oremgr = m_emerge->getWritableOreManager();
+	{
+		Ore *ore = oremgr->create(ORE_SCATTER);
+		ore->name = "scatter";
+		ore->clust_scarcity = 8 * 8 * 8;
+		ore->clust_num_ores = 9;
+		ore->clust_size = 3;
+		ore->y_min = -31000;
+		ore->y_max = 64;
+		ore->ore_param2 = 0;
+		ore->nthresh = 0.0f;
+		ore->noise = nullptr;
+		oremgr->add(ore);
+		ore->m_nodenames.emplace_back("mapgen_gravel");
+		ore->m_nodenames.emplace_back("mapgen_stone");
+		ore->m_nnlistsizes.push_back(1);
+		m_ndef->pendNodeResolve(ore);
+	}
+	{
+		Ore *ore = oremgr->create(ORE_BLOB);
+		ore->name = "blob";
+		ore->clust_scarcity = 16 * 16 * 16;
+		ore->clust_num_ores = 1;
+		ore->clust_size = 8;
+		ore->y_min = -31000;
+		ore->y_max = 31000;
+		ore->ore_param2 = 0;
+		ore->nthresh = 0.0f;
+		ore->noise = nullptr;
+		ore->np = NoiseParams(0.0f, 1.0f, v3f(5, 5, 5), 766, 2, 0.7f, 2.0f);
+		ore->flags = OREFLAG_USE_NOISE;
+		oremgr->add(ore);
+		ore->m_nodenames.emplace_back("mapgen_dirt");
+		ore->m_nodenames.emplace_back("mapgen_stone");
+		ore->m_nnlistsizes.push_back(1);
+		m_ndef->pendNodeResolve(ore);
+	}
+
+	DecorationManager *decomgr = m_emerge->getWritableDecorationManager();
+	{
+		DecoSimple *deco = (DecoSimple *)decomgr->create(DECO_SIMPLE);
+		deco->name = "grass";
+		deco->fill_ratio = 0.05f;
+		deco->sidelen = 16;
+		deco->y_min = 1;
+		deco->y_max = 31000;
+		deco->nspawnby = -1;
+		deco->m_nodenames.emplace_back("mapgen_dirt_with_grass");
+		deco->m_nnlistsizes.push_back(1);
+		deco->m_nnlistsizes.push_back(0); // spawn_by
+		deco->deco_height = 1;
+		deco->deco_height_max = 0;
+		deco->deco_param2 = 0;
+		deco->deco_param2_max = 0;
+		deco->m_nodenames.emplace_back("mapgen_junglegrass");
+		deco->m_nnlistsizes.push_back(1);
+		m_ndef->pendNodeResolve(deco);
+		decomgr->add(deco);
+	}
+	{
+		// 5x6x5 tree: trunk in the center, leaves with a probability of 3/4
+		// on the upper three layers
+		SchematicManager *schemmgr = m_emerge->getWritableSchematicManager();
+		Schematic *schem = SchematicManager::create(SCHEMATIC_NORMAL);
+		schem->name = "tree";
+		schem->size = v3s16(5, 6, 5);
+		u32 volume = schem->size.X * schem->size.Y * schem->size.Z;
+		schem->schemdata = new MapNode[volume];
+		schem->slice_probs = new u8[schem->size.Y];
+		for (s16 y = 0; y < schem->size.Y; y++)
+			schem->slice_probs[y] = MTSCHEM_PROB_ALWAYS;
+		// Indices into m_nodenames, resolved to content ids
+		schem->m_nodenames = { "air", "mapgen_tree", "mapgen_leaves" };
+		schem->m_nnlistsizes.push_back(schem->m_nodenames.size());
+		u32 i = 0;
+		for (s16 z = 0; z < schem->size.Z; z++)
+		for (s16 y = 0; y < schem->size.Y; y++)
+		for (s16 x = 0; x < schem->size.X; x++, i++) {
+			if (x == 2 && z == 2 && y < 5)
+				schem->schemdata[i] = MapNode(1, MTSCHEM_PROB_ALWAYS | MTSCHEM_FORCE_PLACE, 0);
+			else if (y >= 3)
+				schem->schemdata[i] = MapNode(2, 0x60, 0);
+			else
+				schem->schemdata[i] = MapNode(0, MTSCHEM_PROB_NEVER, 0);
+		}
+		m_ndef->pendNodeResolve(schem);
+		schemmgr->add(schem);
+
+		DecoSchematic *deco = (DecoSchematic *)decomgr->create(DECO_SCHEMATIC);
+		deco->name = "tree";
+		deco->fill_ratio = 0.005f;
+		deco->sidelen = 16;
+		deco->y_min = 1;
+		deco->y_max = 31000;
+		deco->nspawnby = -1;
+		deco->flags = DECO_PLACE_CENTER_X | DECO_PLACE_CENTER_Z;
+		deco->m_nodenames.emplace_back("mapgen_dirt_with_grass");
+		deco->m_nnlistsizes.push_back(1);
+		deco->m_nnlistsizes.push_back(0); // spawn_by
+		deco->rotation = ROTATE_RAND;
+		deco->schematic = schem;
+		m_ndef->pendNodeResolve(deco);
+		decomgr->add(deco);
+	}
+}
+
+std::unique_ptr<BlockMakeData> MapgenContext::initBlockMake(v3s16 bpmin)
+{
+	s16 csize = m_emerge->mgparams->chunksize;
+
+	std::unique_ptr<BlockMakeData> data = std::make_unique<BlockMakeData>();
+	data->seed = m_emerge->mgparams->seed;
+	data->blockpos_min = bpmin;
+	data->blockpos_max = bpmin + v3s16(1, 1, 1) * (csize - 1);
+	data->nodedef = m_ndef;
+
+	data->vmanip = new MMVManip(m_map.get());
+	data->vmanip->initialEmerge(data->blockpos_min - v3s16(1, 1, 1),
+		data->blockpos_max + v3s16(1, 1, 1), false);
+	return data;
+}
+
+static void print_phases(const char *mgname, u32 num_chunks)
+{
+	std::cout << "mapgen " << mgname << ", " << num_chunks << " chunks:"
+		<< std::endl;
+
+	char buf[100];
+	for (const auto &phase : PHASES) {
+		// SPT_AVG entries (lighting) return the average per call
+		float total_ms = g_profiler->getValue(phase[1]) *
+			g_profiler->getAvgCount(phase[1]);
+		if (total_ms <= 0.0f)
+			continue;
+		porting::mt_snprintf(buf, sizeof(buf), "  %-12s %9.3f ms/chunk %10.1f chunks/s",
+			phase[0], total_ms / num_chunks, num_chunks * 1000.0f / total_ms);
+		std::cout << buf << std::endl;
+	}
+}
+
+TEST_CASE("benchmark_mapgen")
+{
+	BenchmarkServer server;
+	register_mapgen_nodes(server.getWritableNodeDefManager());
+
+	for (const char *mgname : MAPGEN_NAMES) {
+		MapgenContext ctx(&server, mgname, SEEDS[0]);
+
+		u32 num_chunks = 0;
+		g_profiler->clear();
+
+		BENCHMARK_ADVANCED(std::string("makeChunk ") + mgname)(
+				Catch::Benchmark::Chronometer meter) {
+			// Prepared outside of the measurement, the server does this
+			// under the environment lock
+			std::vector<std::unique_ptr<BlockMakeData>> data;
+			for (int i = 0; i < meter.runs(); i++) {
+				const v3s16 &bpmin = ctx.chunks[(num_chunks + i) % ctx.chunks.size()];
+				data.push_back(ctx.initBlockMake(bpmin));
+			}
+			meter.measure([&] (int i) {
+				ctx.mapgen->makeChunk(data[i].get());
+			});
+			num_chunks += meter.runs();
+		};
+
+		if (num_chunks > 0)
+			print_phases(mgname, num_chunks);
+	}
+}
+
+TEST_CASE("benchmark_mapgen_determinism")
+{
+	BenchmarkServer server;
+	register_mapgen_nodes(server.getWritableNodeDefManager());
+
+	const char *hashes_path = BENCHMARK_MAPGEN_HASHES_PATH;
+	const char *update_env = getenv("MINETEST_UPDATE_MAPGEN_HASHES");
+	const bool update = update_env && is_yes(update_env);
+	Settings hashes;
+	hashes.readConfigFile(hashes_path);
+
+	for (const char *mgname : MAPGEN_NAMES)
+	for (u64 seed : SEEDS) {
+		MapgenContext ctx(&server, mgname, seed);
+		const size_t n = ctx.chunks.size();
+
+		auto generate = [&] (size_t i) {
+			auto data = ctx.initBlockMake(ctx.chunks[i]);
+			// Schematics and the v6 trees draw from the global random
+			// number generator, which is seeded per chunk to make them
+			// reproducible
+			mysrand(Mapgen::getBlockSeed2(ctx.chunks[i], seed));
+			ctx.mapgen->makeChunk(data.get());
+			return hash_vmanip(*data->vmanip);
+		};
+
+		// Chunks are generated in any order by several threads, so the
+		// output must not depend on the previously generated chunks
+		std::vector<u64> forward(n), backward(n);
+		for (size_t i = 0; i < n; i++)
+			forward[i] = generate(i);
+		for (size_t i = n; i-- > 0;)
+			backward[i] = generate(i);
+
+		u64 hash = 0xcbf29ce484222325ULL;
+		for (u64 h : forward)
+			hash = (hash ^ h) * 0x100000001b3ULL;
+
+		std::string key = std::string(mgname) + "_" + std::to_string(seed);
+		INFO("mapgen " << mgname << ", seed " << seed);
+		CHECK(forward == backward);
+		if (update) {
+			hashes.setU64(key, hash);
+		} else if (!hashes.exists(key)) {
+			FAIL_CHECK("No reference hash in " << hashes_path);
+		} else {
+			CHECK(hashes.getU64(key) == hash);
+		}
+	}
+
+	if (update) {
+		REQUIRE(hashes.updateConfigFile(hashes_path));
+		std::cout << "Reference mapgen hashes written to " << hashes_path
+			<< std::endl;
+	}
+}
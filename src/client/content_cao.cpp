@@ -1714,18 +1714,30 @@ void GenericCAO::processMessage(const std::string &data)
 			updateNametag();
 			updateMarker();
 		}
-	} else if (cmd == AO_CMD_UPDATE_POSITION) {
+	} else if (cmd == AO_CMD_UPDATE_POSITION || cmd == AO_CMD_UPDATE_MOVEMENT) {
 		// Not sent by the server if this object is an attachment.
 		// We might however get here if the server notices the object being detached before the client.
-		m_position = readV3F32(is);
-		m_velocity = readV3F32(is);
-		m_acceleration = readV3F32(is);
-		m_rotation = readV3F32(is);
-
-		m_rotation = wrapDegrees_0_360_v3f(m_rotation);
-		bool do_interpolate = readU8(is);
-		bool is_end_position = readU8(is);
-		float update_interval = readF32(is);
+		ObjectMovement movement;
+		if (cmd == AO_CMD_UPDATE_POSITION) {
+			movement.position = readV3F32(is);
+			movement.velocity = readV3F32(is);
+			movement.acceleration = readV3F32(is);
+			movement.rotation = readV3F32(is);
+			movement.do_interpolate = readU8(is);
+			movement.is_movement_end = readU8(is);
+			movement.update_interval = readF32(is);
+		} else if (!m_movement_decoder.decode(is, movement)) {
+			// Reference keyframe or delta to an unknown keyframe
+			return;
+		}
+
+		m_position = movement.position;
+		m_velocity = movement.velocity;
+		m_acceleration = movement.acceleration;
+		m_rotation = wrapDegrees_0_360_v3f(movement.rotation);
+		bool do_interpolate = movement.do_interpolate;
+		bool is_end_position = movement.is_movement_end;
+		float update_interval = movement.update_interval;
 
 		// Place us a bit higher if we're physical, to not sink into
 		// the ground due to sucky collision detection...
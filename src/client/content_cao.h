@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <map>
 #include "irrlichttypes_extrabloated.h"
 #include "clientobject.h"
+#include "object_movement.h"
 #include "object_properties.h"
 #include "itemgroup.h"
 #include "constants.h"
@@ -93,6 +94,7 @@ class GenericCAO : public ClientActiveObject
 	u16 m_hp = 1;
 	SmoothTranslator<v3f> pos_translator;
 	SmoothTranslatorWrappedv3f rot_translator;
+	ObjectMovementDecoder m_movement_decoder;
 	// Spritesheet/animation stuff
 	v2f m_tx_size = v2f(1,1);
 	v2s16 m_tx_basepos;
@@ -37,7 +37,21 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 MeshMakeData::MeshMakeData(Client *client, bool use_shaders):
-	m_client(client),
+	m_nodedef(client->ndef()),
+	m_tsrc(client->getTextureSource()),
+	m_shdrsrc(client->getShaderSource()),
+	m_meshmanip(client->getSceneManager()->getMeshManipulator()),
+	m_use_minimap(client->getMinimap() != nullptr),
+	m_use_shaders(use_shaders)
+{}
+
+MeshMakeData::MeshMakeData(const NodeDefManager *ndef, ITextureSource *tsrc,
+		IShaderSource *shdrsrc, scene::IMeshManipulator *meshmanip,
+		bool use_shaders):
+	m_nodedef(ndef),
+	m_tsrc(tsrc),
+	m_shdrsrc(shdrsrc),
+	m_meshmanip(meshmanip),
 	m_use_shaders(use_shaders)
 {}
 
@@ -163,7 +177,7 @@ u16 getFaceLight(MapNode n, MapNode n2, const v3s16 &face_dir,
 static u16 getSmoothLightCombined(const v3s16 &p,
 	const std::array<v3s16,8> &dirs, MeshMakeData *data)
 {
-	const NodeDefManager *ndef = data->m_client->ndef();
+	const NodeDefManager *ndef = data->m_nodedef;
 
 	u16 ambient_occlusion = 0;
 	u16 light_count = 0;
@@ -686,7 +700,7 @@ static u8 face_contents(content_t m1, content_t m2, bool *equivalent,
 */
 void getNodeTileN(MapNode mn, const v3s16 &p, u8 tileindex, MeshMakeData *data, TileSpec &tile)
 {
-	const NodeDefManager *ndef = data->m_client->ndef();
+	const NodeDefManager *ndef = data->m_nodedef;
 	const ContentFeatures &f = ndef->get(mn);
 	tile = f.tiles[tileindex];
 	bool has_crack = p == data->m_crack_pos_relative;
@@ -706,7 +720,7 @@ void getNodeTileN(MapNode mn, const v3s16 &p, u8 tileindex, MeshMakeData *data,
 */
 void getNodeTile(MapNode mn, const v3s16 &p, const v3s16 &dir, MeshMakeData *data, TileSpec &tile)
 {
-	const NodeDefManager *ndef = data->m_client->ndef();
+	const NodeDefManager *ndef = data->m_nodedef;
 
 	// Direction must be (1,0,0), (-1,0,0), (0,1,0), (0,-1,0),
 	// (0,0,1), (0,0,-1) or (0,0,0)
@@ -780,7 +794,7 @@ static void getTileInfo(
 	)
 {
 	VoxelManipulator &vmanip = data->m_vmanip;
-	const NodeDefManager *ndef = data->m_client->ndef();
+	const NodeDefManager *ndef = data->m_nodedef;
 	v3s16 blockpos_nodes = data->m_blockpos * MAP_BLOCKSIZE;
 
 	const MapNode &n0 = vmanip.getNodeRefUnsafe(blockpos_nodes + p);
@@ -1184,8 +1198,8 @@ void PartialMeshBuffer::afterDraw() const
 
 MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 	m_minimap_mapblock(NULL),
-	m_tsrc(data->m_client->getTextureSource()),
-	m_shdrsrc(data->m_client->getShaderSource()),
+	m_tsrc(data->m_tsrc),
+	m_shdrsrc(data->m_shdrsrc),
 	m_animation_force_timer(0), // force initial animation
 	m_last_crack(-1),
 	m_last_daynight_ratio((u32) -1)
@@ -1195,7 +1209,7 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 	m_enable_shaders = data->m_use_shaders;
 	m_enable_vbo = g_settings->getBool("enable_vbo");
 
-	if (data->m_client->getMinimap()) {
+	if (data->m_use_minimap) {
 		m_minimap_mapblock = new MinimapMapblock;
 		m_minimap_mapblock->getMinimapNodes(
 			&data->m_vmanip, data->m_blockpos * MAP_BLOCKSIZE);
@@ -1251,8 +1265,7 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 	*/
 
 	{
-		MapblockMeshGenerator(data, &collector,
-			data->m_client->getSceneManager()->getMeshManipulator()).generate();
+		MapblockMeshGenerator(data, &collector, data->m_meshmanip).generate();
 	}
 
 	/*
@@ -24,9 +24,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "voxel.h"
 #include <array>
 #include <map>
+#include <IMeshManipulator.h>
 
 class Client;
 class IShaderSource;
+class NodeDefManager;
 
 /*
 	Mesh making stuff
@@ -43,11 +45,23 @@ struct MeshMakeData
 	v3s16 m_crack_pos_relative = v3s16(-1337,-1337,-1337);
 	bool m_smooth_lighting = false;
 
-	Client *m_client;
+	const NodeDefManager *m_nodedef;
+	ITextureSource *m_tsrc;
+	IShaderSource *m_shdrsrc;
+	scene::IMeshManipulator *m_meshmanip;
+	bool m_use_minimap = false;
 	bool m_use_shaders;
 
 	MeshMakeData(Client *client, bool use_shaders);
 
+	/*
+		Without a client, e.g. for benchmarks. tsrc is only used for cracks,
+		shdrsrc if use_shaders is set and meshmanip for mesh nodes.
+	*/
+	MeshMakeData(const NodeDefManager *ndef, ITextureSource *tsrc,
+		IShaderSource *shdrsrc, scene::IMeshManipulator *meshmanip,
+		bool use_shaders);
+
 	/*
 		Copy block data manually (to allow optimizations by the caller)
 	*/
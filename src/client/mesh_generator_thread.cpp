@@ -142,20 +142,34 @@ QueuedMeshUpdate *MeshUpdateQueue::pop()
 {
 	MutexAutoLock lock(m_mutex);
 
-	bool must_be_urgent = !m_urgents.empty();
-	for (std::vector<QueuedMeshUpdate*>::iterator i = m_queue.begin();
-			i != m_queue.end(); ++i) {
-		QueuedMeshUpdate *q = *i;
-		if(must_be_urgent && m_urgents.count(q->p) == 0)
+	// Urgent blocks first, then the others. Blocks another worker is
+	// meshing stay queued: their results must not overtake each other.
+	for (bool must_be_urgent : { true, false }) {
+		if (must_be_urgent && m_urgents.empty())
 			continue;
-		m_queue.erase(i);
-		m_urgents.erase(q->p);
-		fillDataFromMapBlockCache(q);
-		return q;
+		for (std::vector<QueuedMeshUpdate*>::iterator i = m_queue.begin();
+				i != m_queue.end(); ++i) {
+			QueuedMeshUpdate *q = *i;
+			if (must_be_urgent && m_urgents.count(q->p) == 0)
+				continue;
+			if (m_inflight_blocks.count(q->p) != 0)
+				continue;
+			m_queue.erase(i);
+			m_urgents.erase(q->p);
+			m_inflight_blocks.insert(q->p);
+			fillDataFromMapBlockCache(q);
+			return q;
+		}
 	}
 	return NULL;
 }
 
+void MeshUpdateQueue::done(v3s16 pos)
+{
+	MutexAutoLock lock(m_mutex);
+	m_inflight_blocks.erase(pos);
+}
+
 CachedMapBlockData* MeshUpdateQueue::cacheBlock(Map *map, v3s16 p, UpdateMode mode,
 			size_t *cache_hit_counter)
 {
@@ -264,18 +278,65 @@ void MeshUpdateQueue::cleanupCache()
 }
 
 /*
-	MeshUpdateThread
+	MeshUpdateWorkerThread
 */
 
-MeshUpdateThread::MeshUpdateThread(Client *client):
+MeshUpdateWorkerThread::MeshUpdateWorkerThread(MeshUpdateQueue *queue_in,
+		MeshUpdateManager *manager, v3s16 *camera_offset):
 	UpdateThread("Mesh"),
-	m_queue_in(client)
+	m_queue_in(queue_in),
+	m_manager(manager),
+	m_camera_offset(camera_offset)
 {
 	m_generation_interval = g_settings->getU16("mesh_generation_interval");
 	m_generation_interval = rangelim(m_generation_interval, 0, 50);
 }
 
-void MeshUpdateThread::updateBlock(Map *map, v3s16 p, bool ack_block_to_server,
+void MeshUpdateWorkerThread::doUpdate()
+{
+	QueuedMeshUpdate *q;
+	while ((q = m_queue_in->pop())) {
+		if (m_generation_interval)
+			sleep_ms(m_generation_interval);
+		ScopeProfiler sp(g_profiler, "Client: Mesh making (sum)");
+
+		MapBlockMesh *mesh_new = new MapBlockMesh(q->data, *m_camera_offset);
+
+		MeshUpdateResult r;
+		r.p = q->p;
+		r.mesh = mesh_new;
+		r.ack_block_to_server = q->ack_block_to_server;
+		r.urgent = q->urgent;
+
+		m_manager->putResult(r);
+		m_queue_in->done(q->p);
+
+		delete q;
+	}
+}
+
+/*
+	MeshUpdateManager
+*/
+
+MeshUpdateManager::MeshUpdateManager(Client *client):
+	m_queue_in(client)
+{
+	int number_of_threads = rangelim(
+			g_settings->getS32("mesh_generation_threads"), 0, 8);
+	// Automatically use a third of the cores, at most 4
+	if (number_of_threads == 0)
+		number_of_threads = MYMIN(4, (int)Thread::getNumberOfProcessors() / 3);
+	number_of_threads = MYMAX(1, number_of_threads);
+	infostream << "MeshUpdateManager: using " << number_of_threads
+			<< " threads" << std::endl;
+
+	for (int i = 0; i < number_of_threads; i++)
+		m_workers.push_back(std::make_unique<MeshUpdateWorkerThread>(
+				&m_queue_in, this, &m_camera_offset));
+}
+
+void MeshUpdateManager::updateBlock(Map *map, v3s16 p, bool ack_block_to_server,
 		bool urgent, bool update_neighbors)
 {
 	static thread_local const bool many_neighbors =
@@ -298,24 +359,47 @@ void MeshUpdateThread::updateBlock(Map *map, v3s16 p, bool ack_block_to_server,
 	deferUpdate();
 }
 
-void MeshUpdateThread::doUpdate()
+void MeshUpdateManager::putResult(const MeshUpdateResult &r)
 {
-	QueuedMeshUpdate *q;
-	while ((q = m_queue_in.pop())) {
-		if (m_generation_interval)
-			sleep_ms(m_generation_interval);
-		ScopeProfiler sp(g_profiler, "Client: Mesh making (sum)");
+	m_queue_out.push_back(r);
+}
 
-		MapBlockMesh *mesh_new = new MapBlockMesh(q->data, m_camera_offset);
+bool MeshUpdateManager::getNextResult(MeshUpdateResult &r)
+{
+	if (m_queue_out.empty())
+		return false;
+	r = m_queue_out.pop_frontNoEx();
+	return true;
+}
 
-		MeshUpdateResult r;
-		r.p = q->p;
-		r.mesh = mesh_new;
-		r.ack_block_to_server = q->ack_block_to_server;
-		r.urgent = q->urgent;
+void MeshUpdateManager::deferUpdate()
+{
+	for (auto &thread : m_workers)
+		thread->deferUpdate();
+}
 
-		m_queue_out.push_back(r);
+void MeshUpdateManager::start()
+{
+	for (auto &thread : m_workers)
+		thread->start();
+}
 
-		delete q;
-	}
+void MeshUpdateManager::stop()
+{
+	for (auto &thread : m_workers)
+		thread->stop();
+}
+
+void MeshUpdateManager::wait()
+{
+	for (auto &thread : m_workers)
+		thread->wait();
+}
+
+bool MeshUpdateManager::isRunning()
+{
+	for (auto &thread : m_workers)
+		if (thread->isRunning())
+			return true;
+	return false;
 }
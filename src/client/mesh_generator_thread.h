@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <ctime>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
@@ -52,7 +53,9 @@ struct QueuedMeshUpdate
 };
 
 /*
-	A thread-safe queue of mesh update tasks and a cache of MapBlock data
+	A thread-safe queue of mesh update tasks and a cache of MapBlock data.
+	A block is handed out to only one worker at a time, so that its results
+	arrive in order.
 */
 class MeshUpdateQueue
 {
@@ -72,9 +75,12 @@ class MeshUpdateQueue
 	bool addBlock(Map *map, v3s16 p, bool ack_block_to_server, bool urgent);
 
 	// Returned pointer must be deleted
-	// Returns NULL if queue is empty
+	// Returns NULL if queue is empty or all queued blocks are being meshed
 	QueuedMeshUpdate *pop();
 
+	// Must be called once the result of a popped update has been queued
+	void done(v3s16 pos);
+
 	u32 size()
 	{
 		MutexAutoLock lock(m_mutex);
@@ -85,6 +91,7 @@ class MeshUpdateQueue
 	Client *m_client;
 	std::vector<QueuedMeshUpdate *> m_queue;
 	std::unordered_set<v3s16> m_urgents;
+	std::unordered_set<v3s16> m_inflight_blocks;
 	std::unordered_map<v3s16, CachedMapBlockData *> m_cache;
 	u64 m_next_cache_cleanup; // milliseconds
 	std::mutex m_mutex;
@@ -111,25 +118,56 @@ struct MeshUpdateResult
 	MeshUpdateResult() = default;
 };
 
-class MeshUpdateThread : public UpdateThread
+class MeshUpdateManager;
+
+class MeshUpdateWorkerThread : public UpdateThread
 {
 public:
-	MeshUpdateThread(Client *client);
+	MeshUpdateWorkerThread(MeshUpdateQueue *queue_in,
+			MeshUpdateManager *manager, v3s16 *camera_offset);
+
+protected:
+	virtual void doUpdate();
+
+private:
+	MeshUpdateQueue *m_queue_in;
+	MeshUpdateManager *m_manager;
+	v3s16 *m_camera_offset;
+
+	// TODO: Add callback to update these when g_settings changes
+	int m_generation_interval;
+};
+
+/*
+	Meshes blocks with a pool of worker threads, sized by the
+	mesh_generation_threads setting. The results are picked up by the
+	main thread.
+*/
+class MeshUpdateManager
+{
+public:
+	MeshUpdateManager(Client *client);
 
 	// Caches the block at p and its neighbors (if needed) and queues a mesh
 	// update for the block at p
 	void updateBlock(Map *map, v3s16 p, bool ack_block_to_server, bool urgent,
 			bool update_neighbors = false);
 
+	void putResult(const MeshUpdateResult &r);
+	// Returns false if no result is available
+	bool getNextResult(MeshUpdateResult &r);
+
 	v3s16 m_camera_offset;
-	MutexedQueue<MeshUpdateResult> m_queue_out;
 
-private:
-	MeshUpdateQueue m_queue_in;
+	void start();
+	void stop();
+	void wait();
+	bool isRunning();
 
-	// TODO: Add callback to update these when g_settings changes
-	int m_generation_interval;
+private:
+	void deferUpdate();
 
-protected:
-	virtual void doUpdate();
+	MeshUpdateQueue m_queue_in;
+	MutexedQueue<MeshUpdateResult> m_queue_out;
+	std::vector<std::unique_ptr<MeshUpdateWorkerThread>> m_workers;
 };
@@ -66,6 +66,8 @@ RemoteClient::RemoteClient() :
 
 void RemoteClient::ResendBlockIfOnWire(v3s16 p)
 {
+	RecursiveMutexAutoLock lock(m_blocks_mutex);
+
 	// if this block is on wire, mark it for sending again as soon as possible
 	if (m_blocks_sending.find(p) != m_blocks_sending.end()) {
 		SetBlockNotSent(p);
@@ -97,6 +99,8 @@ void RemoteClient::GetNextBlocks (
 		float dtime,
 		std::vector<PrioritySortedBlockTransfer> &dest)
 {
+	RecursiveMutexAutoLock lock(m_blocks_mutex);
+
 	// Increment timers
 	m_nothing_to_send_pause_timer -= dtime;
 
@@ -397,6 +401,8 @@ void RemoteClient::GetNextBlocks (
 
 void RemoteClient::GotBlock(v3s16 p)
 {
+	RecursiveMutexAutoLock lock(m_blocks_mutex);
+
 	if (m_blocks_sending.find(p) != m_blocks_sending.end()) {
 		m_blocks_sending.erase(p);
 		// only add to sent blocks if it actually was sending
@@ -409,6 +415,8 @@ void RemoteClient::GotBlock(v3s16 p)
 
 void RemoteClient::SentBlock(v3s16 p)
 {
+	RecursiveMutexAutoLock lock(m_blocks_mutex);
+
 	if (m_blocks_sending.find(p) == m_blocks_sending.end())
 		m_blocks_sending[p] = 0.0f;
 	else
@@ -418,6 +426,8 @@ void RemoteClient::SentBlock(v3s16 p)
 
 void RemoteClient::SetBlockNotSent(v3s16 p)
 {
+	RecursiveMutexAutoLock lock(m_blocks_mutex);
+
 	m_nothing_to_send_pause_timer = 0;
 
 	// remove the block from sending and sent sets,
@@ -428,6 +438,8 @@ void RemoteClient::SetBlockNotSent(v3s16 p)
 
 void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
 {
+	RecursiveMutexAutoLock lock(m_blocks_mutex);
+
 	m_nothing_to_send_pause_timer = 0;
 
 	for (auto &block : blocks) {
@@ -276,10 +276,15 @@ class RemoteClient
 	 */
 	void ResendBlockIfOnWire(v3s16 p);
 
-	u32 getSendingCount() const { return m_blocks_sending.size(); }
+	u32 getSendingCount() const
+	{
+		RecursiveMutexAutoLock lock(m_blocks_mutex);
+		return m_blocks_sending.size();
+	}
 
 	bool isBlockSent(v3s16 p) const
 	{
+		RecursiveMutexAutoLock lock(m_blocks_mutex);
 		return m_blocks_sent.find(p) != m_blocks_sent.end();
 	}
 
@@ -290,6 +295,7 @@ class RemoteClient
 
 	void PrintInfo(std::ostream &o)
 	{
+		RecursiveMutexAutoLock lock(m_blocks_mutex);
 		o<<"RemoteClient "<<peer_id<<": "
 				<<"m_blocks_sent.size()="<<m_blocks_sent.size()
 				<<", m_blocks_sending.size()="<<m_blocks_sending.size()
@@ -363,6 +369,12 @@ class RemoteClient
 	// Client sent language code
 	std::string m_lang_code;
 
+	/*
+		Protects the block sending state below. Packet workers update it
+		(GOTBLOCKS, DELETEDBLOCKS) without holding the environment lock.
+	*/
+	mutable std::recursive_mutex m_blocks_mutex;
+
 	/*
 		Blocks that have been sent to client.
 		- These don't have to be sent again.
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <sstream>
 #include <unordered_set>
 #include <algorithm>
+#include <mutex>
 #include "gamedef.h"
 #include "inventory.h"
 #include "util/serialize.h"
@@ -31,6 +32,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/numeric.h"
 #include "util/strfnd.h"
 #include "exceptions.h"
+#include "threading/mutex_auto_lock.h"
+#include "util/metricsbackend.h"
 
 inline bool isGroupRecipeStr(const std::string &rec_name)
 {
@@ -921,60 +924,36 @@ class CCraftDefManager: public IWritableCraftDefManager
 		if (input.empty())
 			return false;
 
-		std::vector<std::string> input_names;
-		input_names = craftGetItemNames(input.items, gamedef);
-		std::sort(input_names.begin(), input_names.end());
-
-		// Try hash types with increasing collision rate
-		// while remembering the latest, highest priority recipe.
-		CraftDefinition::RecipePriority priority_best =
-			CraftDefinition::PRIORITY_NO_RECIPE;
-		CraftDefinition *def_best = nullptr;
-		for (int type = 0; type <= craft_hash_type_max; type++) {
-			u64 hash = getHashForGrid((CraftHashType) type, input_names);
-
-			/*errorstream << "Checking type " << type << " with hash " << hash << std::endl;*/
-
-			// We'd like to do "const [...] hash_collisions = m_craft_defs[type][hash];"
-			// but that doesn't compile for some reason. This does.
-			auto col_iter = (m_craft_defs[type]).find(hash);
-
-			if (col_iter == (m_craft_defs[type]).end())
-				continue;
-
-			const std::vector<CraftDefinition*> &hash_collisions = col_iter->second;
-			// Walk crafting definitions from back to front, so that later
-			// definitions can override earlier ones.
-			for (std::vector<CraftDefinition*>::size_type
-					i = hash_collisions.size(); i > 0; i--) {
-				CraftDefinition *def = hash_collisions[i - 1];
-
-				/*errorstream << "Checking " << input.dump() << std::endl
-					<< " against " << def->dump() << std::endl;*/
-
-				CraftDefinition::RecipePriority priority = def->getPriority();
-				if (priority > priority_best
-						&& def->check(input, gamedef)) {
-					// Check if the crafted node/item exists
-					CraftOutput out = def->getOutput(input, gamedef);
-					ItemStack is;
-					is.deSerialize(out.item, gamedef->idef());
-					if (!is.isKnown(gamedef->idef())) {
-						infostream << "trying to craft non-existent "
-							<< out.item << ", ignoring recipe" << std::endl;
-						continue;
-					}
+		std::string key = getCacheKey(input);
+		CraftDefinition *def;
+		bool cached;
+		{
+			MutexAutoLock lock(m_result_cache_mutex);
+			auto it = m_result_cache.find(key);
+			cached = it != m_result_cache.end();
+			def = cached ? it->second : nullptr;
+		}
 
-					output = out;
-					priority_best = priority;
-					def_best = def;
-				}
-			}
+		if (cached) {
+			if (m_cache_hit_counter)
+				m_cache_hit_counter->increment();
+		} else {
+			if (m_cache_miss_counter)
+				m_cache_miss_counter->increment();
+			def = findCraft(input, gamedef);
+
+			MutexAutoLock lock(m_result_cache_mutex);
+			// Simply start over, the common inputs will be back soon
+			if (m_result_cache.size() >= RESULT_CACHE_SIZE)
+				m_result_cache.clear();
+			m_result_cache[key] = def;
 		}
-		if (priority_best == CraftDefinition::PRIORITY_NO_RECIPE)
+
+		if (!def)
 			return false;
+		output = def->getOutput(input, gamedef);
 		if (decrementInput)
-			def_best->decrementInput(input, output_replacement, gamedef);
+			def->decrementInput(input, output_replacement, gamedef);
 		return true;
 	}
 
@@ -1017,6 +996,7 @@ class CCraftDefManager: public IWritableCraftDefManager
 			delete def;
 		}
 		m_output_craft_definitions.erase(to_clear);
+		invalidateCache();
 		return true;
 	}
 
@@ -1049,6 +1029,7 @@ class CCraftDefManager: public IWritableCraftDefManager
 					return defs_to_remove.find(def) != defs_to_remove.end();
 				}), outdefs.end());
 			}
+			invalidateCache();
 		}
 
 		return !defs_to_remove.empty();
@@ -1082,6 +1063,7 @@ class CCraftDefManager: public IWritableCraftDefManager
 		std::string output_name = craftGetItemName(
 				def->getOutput(input, gamedef).item, gamedef);
 		m_output_craft_definitions[output_name].push_back(def);
+		invalidateCache();
 	}
 	virtual void clear()
 	{
@@ -1095,6 +1077,7 @@ class CCraftDefManager: public IWritableCraftDefManager
 			m_craft_defs[type].clear();
 		}
 		m_output_craft_definitions.clear();
+		invalidateCache();
 	}
 	virtual void initHashes(IGameDef *gamedef)
 	{
@@ -1111,12 +1094,107 @@ class CCraftDefManager: public IWritableCraftDefManager
 			m_craft_defs[type][hash].push_back(def);
 		}
 		unhashed.clear();
+		// Aliases are only resolved now
+		invalidateCache();
+	}
+	virtual void setMetricsBackend(MetricsBackend *mb)
+	{
+		m_cache_hit_counter = mb->addCounter("minetest_craft_cache_hits",
+			"Craft results found in the cache");
+		m_cache_miss_counter = mb->addCounter("minetest_craft_cache_misses",
+			"Craft results looked up in the recipes");
 	}
 private:
+	// Returns the highest priority recipe matching the input
+	CraftDefinition *findCraft(const CraftInput &input, IGameDef *gamedef) const
+	{
+		std::vector<std::string> input_names;
+		input_names = craftGetItemNames(input.items, gamedef);
+		std::sort(input_names.begin(), input_names.end());
+
+		// Try hash types with increasing collision rate
+		// while remembering the latest, highest priority recipe.
+		CraftDefinition::RecipePriority priority_best =
+			CraftDefinition::PRIORITY_NO_RECIPE;
+		CraftDefinition *def_best = nullptr;
+		for (int type = 0; type <= craft_hash_type_max; type++) {
+			u64 hash = getHashForGrid((CraftHashType) type, input_names);
+
+			/*errorstream << "Checking type " << type << " with hash " << hash << std::endl;*/
+
+			// We'd like to do "const [...] hash_collisions = m_craft_defs[type][hash];"
+			// but that doesn't compile for some reason. This does.
+			auto col_iter = (m_craft_defs[type]).find(hash);
+
+			if (col_iter == (m_craft_defs[type]).end())
+				continue;
+
+			const std::vector<CraftDefinition*> &hash_collisions = col_iter->second;
+			// Walk crafting definitions from back to front, so that later
+			// definitions can override earlier ones.
+			for (std::vector<CraftDefinition*>::size_type
+					i = hash_collisions.size(); i > 0; i--) {
+				CraftDefinition *def = hash_collisions[i - 1];
+
+				/*errorstream << "Checking " << input.dump() << std::endl
+					<< " against " << def->dump() << std::endl;*/
+
+				CraftDefinition::RecipePriority priority = def->getPriority();
+				if (priority > priority_best
+						&& def->check(input, gamedef)) {
+					// Check if the crafted node/item exists
+					CraftOutput out = def->getOutput(input, gamedef);
+					ItemStack is;
+					is.deSerialize(out.item, gamedef->idef());
+					if (!is.isKnown(gamedef->idef())) {
+						infostream << "trying to craft non-existent "
+							<< out.item << ", ignoring recipe" << std::endl;
+						continue;
+					}
+
+					priority_best = priority;
+					def_best = def;
+				}
+			}
+		}
+		return def_best;
+	}
+
+	// Everything the recipe checks depend on: the names, counts and wear
+	// (for tool repair) of the items in each slot
+	static std::string getCacheKey(const CraftInput &input)
+	{
+		std::string key = std::to_string(input.method);
+		key.append(" ").append(std::to_string(input.width));
+		for (const ItemStack &item : input.items) {
+			key.append("\n");
+			if (item.empty())
+				continue;
+			key.append(item.name).append(" ")
+				.append(std::to_string(item.count)).append(" ")
+				.append(std::to_string(item.wear));
+		}
+		return key;
+	}
+
+	// Must be called whenever recipes are added or removed
+	void invalidateCache()
+	{
+		MutexAutoLock lock(m_result_cache_mutex);
+		m_result_cache.clear();
+	}
+
 	std::vector<std::unordered_map<u64, std::vector<CraftDefinition*> > >
 		m_craft_defs;
 	std::unordered_map<std::string, std::vector<CraftDefinition*> >
 		m_output_craft_definitions;
+
+	// Input to highest priority recipe, nullptr if there is none
+	static constexpr size_t RESULT_CACHE_SIZE = 4096;
+	mutable std::mutex m_result_cache_mutex;
+	mutable std::unordered_map<std::string, CraftDefinition *> m_result_cache;
+	MetricCounterPtr m_cache_hit_counter;
+	MetricCounterPtr m_cache_miss_counter;
 };
 
 IWritableCraftDefManager* createCraftDefManager()
@@ -26,6 +26,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "gamedef.h"
 #include "inventory.h"
 
+class MetricsBackend;
+
 /*
 	Crafting methods.
 
@@ -458,6 +460,9 @@ class IWritableCraftDefManager : public ICraftDefManager
 
 	// To be called after all mods are loaded, so that we catch all aliases
 	virtual void initHashes(IGameDef *gamedef) = 0;
+
+	// Report the hit rate of the getCraftResult cache
+	virtual void setMetricsBackend(MetricsBackend *mb) = 0;
 };
 
 IWritableCraftDefManager* createCraftDefManager();
@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "emerge.h"
 
 #include <iostream>
+#include <memory>
 #include <queue>
 
 #include "util/container.h"
@@ -40,6 +41,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapgen/mg_schematic.h"
 #include "nodedef.h"
 #include "profiler.h"
+#include "scripting_emerge.h"
 #include "scripting_server.h"
 #include "server.h"
 #include "settings.h"
@@ -72,6 +74,8 @@ class EmergeThread : public Thread {
 	ServerMap *m_map;
 	EmergeManager *m_emerge;
 	Mapgen *m_mapgen;
+	// Mapgen environment, only if mods registered scripts for it
+	std::unique_ptr<EmergeScripting> m_script;
 
 	Event m_queue_event;
 	std::queue<v3s16> m_block_queue;
@@ -80,6 +84,11 @@ class EmergeThread : public Thread {
 
 	EmergeAction getBlockOrStartGen(
 		const v3s16 &pos, bool allow_gen, MapBlock **block, BlockMakeData *data);
+	// Needs the environment lock
+	EmergeAction startGen(const v3s16 &pos, bool allow_gen, BlockMakeData *data);
+	bool initScripting();
+	// Runs the mapgen environment on the chunk, without the environment lock
+	void runMapgenScripts(BlockMakeData *bmdata);
 	MapBlock *finishGen(v3s16 pos, BlockMakeData *bmdata,
 		std::map<v3s16, MapBlock *> *modified_blocks);
 
@@ -286,6 +295,15 @@ Mapgen *EmergeManager::getCurrentMapgen()
 }
 
 
+Mapgen *EmergeManager::getMapgen(u32 thread_id)
+{
+	if (m_threads_active || thread_id >= m_mapgens.size())
+		return nullptr;
+
+	return m_mapgens[thread_id];
+}
+
+
 void EmergeManager::startThreads()
 {
 	if (m_threads_active)
@@ -400,6 +418,14 @@ int EmergeManager::getSpawnLevelAtPoint(v2s16 p)
 		return 0;
 	}
 
+	// In generated terrain the mapgen can apply its rules to the recorded
+	// ground level instead of searching for the surface in the noise
+	s16 ground;
+	int level;
+	if (height_cache && height_cache->getGroundLevel(p, &ground) &&
+			m_mapgens[0]->getSpawnLevelAtGround(p, ground, &level))
+		return level;
+
 	return m_mapgens[0]->getSpawnLevelAtPoint(p);
 }
 
@@ -592,20 +618,43 @@ bool EmergeThread::popBlockEmerge(v3s16 *pos, BlockEmergeData *bedata)
 EmergeAction EmergeThread::getBlockOrStartGen(
 	const v3s16 &pos, bool allow_gen, MapBlock **block, BlockMakeData *bmdata)
 {
-	MutexAutoLock envlock(m_server->m_env_mutex);
+	{
+		MutexAutoLock envlock(m_server->m_env_mutex);
+
+		// 1). Attempt to fetch block from memory
+		*block = m_map->getBlockNoCreateNoEx(pos);
+		if (*block) {
+			if ((*block)->isGenerated())
+				return EMERGE_FROM_MEMORY;
+			return startGen(pos, allow_gen, bmdata);
+		}
+	}
 
-	// 1). Attempt to fetch block from memory
-	*block = m_map->getBlockNoCreateNoEx(pos);
-	if (*block) {
-		if ((*block)->isGenerated())
-			return EMERGE_FROM_MEMORY;
-	} else {
-		// 2). Attempt to load block from disk if it was not in the memory
-		*block = m_map->loadBlock(pos);
-		if (*block && (*block)->isGenerated())
-			return EMERGE_FROM_DISK;
+	// 2). Attempt to load block from disk if it was not in the memory.
+	// Reading and deserializing it does not need the lock.
+	std::string blob;
+	MapBlock *loaded = nullptr;
+	bool corrupt = false;
+	if (m_map->beginLoadBlock(pos, &blob)) {
+		ScopeProfiler sp(g_profiler,
+			"EmergeThread: deserialize block", SPT_AVG);
+		loaded = m_map->deSerializeBlock(pos, blob, &corrupt);
 	}
 
+	MutexAutoLock envlock(m_server->m_env_mutex);
+
+	// Someone else may have been faster
+	*block = m_map->finishLoadBlock(pos, blob, loaded, corrupt);
+	if (*block && (*block)->isGenerated())
+		return blob.empty() ? EMERGE_FROM_MEMORY : EMERGE_FROM_DISK;
+
+	return startGen(pos, allow_gen, bmdata);
+}
+
+
+EmergeAction EmergeThread::startGen(
+	const v3s16 &pos, bool allow_gen, BlockMakeData *bmdata)
+{
 	// 3). Attempt to start generation
 	if (allow_gen && m_map->initBlockMake(pos, bmdata))
 		return EMERGE_GENERATED;
@@ -615,6 +664,46 @@ EmergeAction EmergeThread::getBlockOrStartGen(
 }
 
 
+bool EmergeThread::initScripting()
+{
+	if (m_server->m_mapgen_init_files.empty())
+		return true;
+
+	m_script = std::make_unique<EmergeScripting>(m_server);
+	try {
+		m_script->loadScripts();
+	} catch (const ModError &e) {
+		errorstream << "Failed to load mod script inside mapgen environment."
+			<< std::endl;
+		m_server->setAsyncFatalError(e.what());
+		m_script.reset();
+		return false;
+	}
+	return true;
+}
+
+
+void EmergeThread::runMapgenScripts(BlockMakeData *bmdata)
+{
+	if (!m_script)
+		return;
+
+	ScopeProfiler sp(g_profiler,
+		"EmergeThread: mapgen env on_generated", SPT_AVG);
+
+	v3s16 minp = bmdata->blockpos_min * MAP_BLOCKSIZE;
+	v3s16 maxp = bmdata->blockpos_max * MAP_BLOCKSIZE +
+				 v3s16(1,1,1) * (MAP_BLOCKSIZE - 1);
+
+	try {
+		m_script->on_generated(bmdata->vmanip, minp, maxp,
+			m_mapgen->blockseed);
+	} catch (LuaError &e) {
+		m_server->setAsyncFatalError(e);
+	}
+}
+
+
 MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	std::map<v3s16, MapBlock *> *modified_blocks)
 {
@@ -646,7 +735,8 @@ MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 		VoxelArea(minp, maxp));
 
 	/*
-		Run Lua on_generated callbacks
+		Run Lua on_generated callbacks of the main environment.
+		Those of the mapgen environment already ran in runMapgenScripts().
 	*/
 	try {
 		m_server->getScriptIface()->environment_OnGenerated(
@@ -685,6 +775,11 @@ void *EmergeThread::run()
 	m_mapgen = m_emerge->m_mapgens[id];
 	enable_mapgen_debug_info = m_emerge->enable_mapgen_debug_info;
 
+	if (!initScripting()) {
+		cancelPendingItems();
+		return NULL;
+	}
+
 	try {
 	while (!stopRequested()) {
 		BlockEmergeData bedata;
@@ -712,6 +807,14 @@ void *EmergeThread::run()
 				m_mapgen->makeChunk(&bmdata);
 			}
 
+			if (m_mapgen->heightmap && m_emerge->height_cache) {
+				m_emerge->height_cache->update(m_mapgen->heightmap,
+					bmdata.blockpos_min * MAP_BLOCKSIZE,
+					(bmdata.blockpos_max + 1) * MAP_BLOCKSIZE - 1);
+			}
+
+			runMapgenScripts(&bmdata);
+
 			block = finishGen(pos, &bmdata, &modified_blocks);
 			if (!block)
 				action = EMERGE_ERRORED;
@@ -747,6 +850,7 @@ void *EmergeThread::run()
 	}
 
 	cancelPendingItems();
+	m_script.reset();
 
 	END_DEBUG_EXCEPTION_HANDLER
 	return NULL;
@@ -146,6 +146,9 @@ class EmergeManager {
 	// Environment is not created until after script initialization.
 	MapSettingsManager *map_settings_mgr;
 
+	// Owned by ServerMap, filled in by the emerge threads
+	TerrainHeightCache *height_cache = nullptr;
+
 	// Methods
 	EmergeManager(Server *server, MetricsBackend *mb);
 	~EmergeManager();
@@ -186,6 +189,9 @@ class EmergeManager {
 	bool isBlockInQueue(v3s16 pos);
 
 	Mapgen *getCurrentMapgen();
+	// Mapgen owned by the given emerge thread, nullptr before initMapgens().
+	// Only safe to use while the threads are not running (e.g. benchmarks).
+	Mapgen *getMapgen(u32 thread_id);
 
 	// Mapgen helpers methods
 	int getSpawnLevelAtPoint(v2s16 p);
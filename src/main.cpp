@@ -357,6 +357,8 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Feature an interactive terminal (Only works when using minetestserver or with --server)"))));
 	allowed_options->insert(std::make_pair("recompress", ValueSpec(VALUETYPE_FLAG,
 			_("Recompress the blocks of the given map database."))));
+	allowed_options->insert(std::make_pair("pregenerate", ValueSpec(VALUETYPE_STRING,
+			_("Generate the map in the area \"(x1,y1,z1) (x2,y2,z2)\" and exit (Only works when using minetestserver or with --server)"))));
 #ifndef SERVER
 	allowed_options->insert(std::make_pair("speedtests", ValueSpec(VALUETYPE_FLAG,
 			_("Run speed tests"))));
@@ -944,6 +946,9 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	if (cmd_args.getFlag("recompress"))
 		return recompress_map_database(game_params, cmd_args, bind_addr);
 
+	if (cmd_args.exists("pregenerate"))
+		return Server::pregenerateMap(game_params, cmd_args, bind_addr);
+
 	if (cmd_args.exists("terminal")) {
 #if USE_CURSES
 		bool name_ok = true;
@@ -33,6 +33,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "gamedef.h"
 #include "util/directiontables.h"
 #include "util/basic_macros.h"
+#include "threading/mutex_auto_lock.h"
 #include "rollback_interface.h"
 #include "environment.h"
 #include "reflowscan.h"
@@ -45,6 +46,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "database/database-dummy.h"
 #include "database/database-sqlite3.h"
 #include "script/scripting_server.h"
+#include <algorithm>
 #include <deque>
 #include <queue>
 #if USE_LEVELDB
@@ -164,6 +166,98 @@ MapNode Map::getNode(v3s16 p, bool *is_valid_position)
 	return node;
 }
 
+bool Map::findNodeNear(v3s16 pos, s32 start_radius, s32 radius,
+	const std::vector<content_t> &filter, v3s16 *found_pos)
+{
+	if (radius < start_radius || filter.empty())
+		return false;
+	bool want_ignore = CONTAINS(filter, CONTENT_IGNORE);
+
+	// Search cube, in s32 to not overflow with large radii
+	const s32 limit = MAX_MAP_GENERATION_LIMIT;
+	radius = std::min(radius, 2 * limit);
+	v3s32 center(pos.X, pos.Y, pos.Z);
+	v3s32 cmin(std::max(center.X - radius, -limit),
+		std::max(center.Y - radius, -limit), std::max(center.Z - radius, -limit));
+	v3s32 cmax(std::min(center.X + radius, limit),
+		std::min(center.Y + radius, limit), std::min(center.Z + radius, limit));
+	if (cmin.X > cmax.X || cmin.Y > cmax.Y || cmin.Z > cmax.Z)
+		return false;
+
+	bool found = false;
+	s32 best_d = radius;
+	s32 best_e = 0;
+
+	auto search_block = [&] (v3s16 bp) {
+		v3s32 bmin(bp.X * MAP_BLOCKSIZE, bp.Y * MAP_BLOCKSIZE, bp.Z * MAP_BLOCKSIZE);
+		v3s32 bmax = bmin + v3s32(MAP_BLOCKSIZE - 1, MAP_BLOCKSIZE - 1, MAP_BLOCKSIZE - 1);
+		// Nodes farther away than the best match can be ignored
+		v3s32 lo(std::max({bmin.X, cmin.X, center.X - best_d}),
+			std::max({bmin.Y, cmin.Y, center.Y - best_d}),
+			std::max({bmin.Z, cmin.Z, center.Z - best_d}));
+		v3s32 hi(std::min({bmax.X, cmax.X, center.X + best_d}),
+			std::min({bmax.Y, cmax.Y, center.Y + best_d}),
+			std::min({bmax.Z, cmax.Z, center.Z + best_d}));
+		if (lo.X > hi.X || lo.Y > hi.Y || lo.Z > hi.Z)
+			return;
+
+		MapBlock *block = getBlockNoCreateNoEx(bp);
+		if (block ? !block->containsAnyContent(filter) : !want_ignore)
+			return;
+
+		v3s32 p;
+		for (p.Z = lo.Z; p.Z <= hi.Z; p.Z++)
+		for (p.Y = lo.Y; p.Y <= hi.Y; p.Y++)
+		for (p.X = lo.X; p.X <= hi.X; p.X++) {
+			v3s32 diff = p - center;
+			s32 d = std::max({std::abs(diff.X), std::abs(diff.Y), std::abs(diff.Z)});
+			if (d < start_radius || d > best_d)
+				continue;
+			s32 e = diff.X * diff.X + diff.Y * diff.Y + diff.Z * diff.Z;
+			if (found && d == best_d && e >= best_e)
+				continue;
+
+			content_t c = block ? block->getNodeNoCheck(p.X - bmin.X,
+				p.Y - bmin.Y, p.Z - bmin.Z).getContent() : CONTENT_IGNORE;
+			if (!CONTAINS(filter, c))
+				continue;
+
+			found = true;
+			best_d = d;
+			best_e = e;
+			*found_pos = v3s16(p.X, p.Y, p.Z);
+		}
+	};
+
+	// Shells of blocks around the block containing pos
+	v3s16 bp0 = getNodeBlockPos(pos);
+	v3s16 bpmin = getNodeBlockPos(v3s16(cmin.X, cmin.Y, cmin.Z));
+	v3s16 bpmax = getNodeBlockPos(v3s16(cmax.X, cmax.Y, cmax.Z));
+	s32 max_shell = std::max({bp0.X - bpmin.X, bpmax.X - bp0.X,
+		bp0.Y - bpmin.Y, bpmax.Y - bp0.Y, bp0.Z - bpmin.Z, bpmax.Z - bp0.Z});
+	for (s32 shell = 0; shell <= max_shell; shell++) {
+		// Nodes in this shell are at least this far away from pos
+		if ((shell - 1) * MAP_BLOCKSIZE + 1 > best_d)
+			break;
+
+		for (s32 z = -shell; z <= shell; z++)
+		for (s32 y = -shell; y <= shell; y++) {
+			// Inside of the shell: only the two blocks on the X faces
+			bool inner = std::abs(z) != shell && std::abs(y) != shell;
+			s32 step = inner ? 2 * shell : 1;
+			for (s32 x = -shell; x <= shell; x += step) {
+				v3s32 bp(bp0.X + x, bp0.Y + y, bp0.Z + z);
+				if (bp.X * MAP_BLOCKSIZE > cmax.X || (bp.X + 1) * MAP_BLOCKSIZE <= cmin.X ||
+						bp.Y * MAP_BLOCKSIZE > cmax.Y || (bp.Y + 1) * MAP_BLOCKSIZE <= cmin.Y ||
+						bp.Z * MAP_BLOCKSIZE > cmax.Z || (bp.Z + 1) * MAP_BLOCKSIZE <= cmin.Z)
+					continue;
+				search_block(v3s16(bp.X, bp.Y, bp.Z));
+			}
+		}
+	}
+	return found;
+}
+
 static void set_node_in_block(MapBlock *block, v3s16 relpos, MapNode n)
 {
 	// Never allow placing CONTENT_IGNORE, it causes problems
@@ -535,7 +629,7 @@ void ServerMap::transformLiquids(std::map<v3s16, MapBlock*> &modified_blocks,
 
 	std::vector<v3s16> check_for_falling;
 
-	u32 liquid_loop_max = g_settings->getS32("liquid_loop_max");
+	u32 liquid_loop_max = m_liquid_loop_max.get();
 	u32 loop_max = liquid_loop_max;
 
 	while (m_transforming_liquid.size() != 0)
@@ -856,7 +950,7 @@ void ServerMap::transformLiquids(std::map<v3s16, MapBlock*> &modified_blocks,
 	/* ----------------------------------------------------------------------
 	 * Manage the queue so that it does not grow indefinitely
 	 */
-	u16 time_until_purge = g_settings->getU16("liquid_queue_purge_time");
+	u16 time_until_purge = m_liquid_queue_purge_time.get();
 
 	if (time_until_purge == 0)
 		return; // Feature disabled
@@ -1213,6 +1307,7 @@ ServerMap::ServerMap(const std::string &savedir, IGameDef *gamedef,
 
 	// Tell the EmergeManager about our MapSettingsManager
 	emerge->map_settings_mgr = &settings_mgr;
+	emerge->height_cache = &height_cache;
 
 	/*
 		Try to load map; if not found, create a new one.
@@ -1238,6 +1333,8 @@ ServerMap::ServerMap(const std::string &savedir, IGameDef *gamedef,
 	m_savedir = savedir;
 	m_map_saving_enabled = false;
 
+	height_cache.setSaveDir(savedir + DIR_DELIM + "heightcache");
+
 	m_save_time_counter = mb->addCounter(
 		"minetest_map_save_time", "Time spent saving blocks (in microseconds)");
 	m_save_count_counter = mb->addCounter(
@@ -1642,6 +1739,8 @@ void ServerMap::save(ModifiedState save_level)
 			m_map_metadata_changed = false;
 	}
 
+	height_cache.save();
+
 	// Profile modified reasons
 	Profiler modprofiler;
 
@@ -1698,6 +1797,7 @@ void ServerMap::save(ModifiedState save_level)
 
 void ServerMap::listAllLoadableBlocks(std::vector<v3s16> &dst)
 {
+	MutexAutoLock lock(m_db_mutex);
 	dbase->listAllLoadableBlocks(dst);
 	if (dbase_ro)
 		dbase_ro->listAllLoadableBlocks(dst);
@@ -1748,16 +1848,20 @@ MapDatabase *ServerMap::createDatabase(
 
 void ServerMap::beginSave()
 {
+	MutexAutoLock lock(m_db_mutex);
 	dbase->beginSave();
 }
 
 void ServerMap::endSave()
 {
+	MutexAutoLock lock(m_db_mutex);
 	dbase->endSave();
 }
 
 bool ServerMap::saveBlock(MapBlock *block)
 {
+	MutexAutoLock lock(m_db_mutex);
+	markBlockLoadOutdated(block->getPos());
 	return saveBlock(block, dbase, m_map_compression_level);
 }
 
@@ -1784,10 +1888,12 @@ bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_leve
 	return ret;
 }
 
-void ServerMap::loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool save_after_load)
+bool ServerMap::deSerializeBlock(MapBlock *block, const std::string &blob,
+		bool allocate_unknown, bool *corrupt)
 {
+	v3s16 p3d = block->getPos();
 	try {
-		std::istringstream is(*blob, std::ios_base::binary);
+		std::istringstream is(blob, std::ios_base::binary);
 
 		u8 version = SER_FMT_VER_INVALID;
 		is.read((char*)&version, 1);
@@ -1796,36 +1902,8 @@ void ServerMap::loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool
 			throw SerializationError("ServerMap::loadBlock(): Failed"
 					" to read MapBlock version");
 
-		MapBlock *block = NULL;
-		bool created_new = false;
-		block = sector->getBlockNoCreateNoEx(p3d.Y);
-		if(block == NULL)
-		{
-			block = sector->createBlankBlockNoInsert(p3d.Y);
-			created_new = true;
-		}
-
 		// Read basic data
-		block->deSerialize(is, version, true);
-
-		// If it's a new block, insert it to the map
-		if (created_new) {
-			sector->insertBlock(block);
-			ReflowScan scanner(this, m_emerge->ndef);
-			scanner.scan(block, &m_transforming_liquid);
-		}
-
-		/*
-			Save blocks loaded in old format in new format
-		*/
-
-		//if(version < SER_FMT_VER_HIGHEST_READ || save_after_load)
-		// Only save if asked to; no need to update version
-		if(save_after_load)
-			saveBlock(block);
-
-		// We just loaded it from, so it's up-to-date.
-		block->resetModified();
+		return block->deSerialize(is, version, true, allocate_unknown);
 	}
 	catch(SerializationError &e)
 	{
@@ -1836,6 +1914,9 @@ void ServerMap::loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool
 		// TODO: Block should be marked as invalid in memory so that it is
 		// not touched but the game can run
 
+		if (corrupt)
+			*corrupt = true;
+
 		if(g_settings->getBool("ignore_world_load_errors")){
 			errorstream<<"Ignoring block load error. Duck and cover! "
 					<<"(ignore_world_load_errors)"<<std::endl;
@@ -1843,50 +1924,142 @@ void ServerMap::loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool
 			throw SerializationError("Invalid block data in database");
 		}
 	}
+	return false;
 }
 
-MapBlock* ServerMap::loadBlock(v3s16 blockpos)
+bool ServerMap::readBlockData(v3s16 blockpos, std::string *blob)
 {
-	bool created_new = (getBlockNoCreateNoEx(blockpos) == NULL);
+	MutexAutoLock lock(m_db_mutex);
 
-	v2s16 p2d(blockpos.X, blockpos.Z);
+	dbase->loadBlock(blockpos, blob);
+	if (blob->empty() && dbase_ro)
+		dbase_ro->loadBlock(blockpos, blob);
+	return !blob->empty();
+}
 
-	std::string ret;
-	dbase->loadBlock(blockpos, &ret);
-	if (!ret.empty()) {
-		loadBlock(&ret, blockpos, createSector(p2d), false);
-	} else if (dbase_ro) {
-		dbase_ro->loadBlock(blockpos, &ret);
-		if (!ret.empty()) {
-			loadBlock(&ret, blockpos, createSector(p2d), false);
-		}
-	} else {
-		return NULL;
+bool ServerMap::beginLoadBlock(v3s16 blockpos, std::string *blob)
+{
+	MutexAutoLock lock(m_db_mutex);
+
+	m_loading_blocks[blockpos] = false;
+	dbase->loadBlock(blockpos, blob);
+	if (blob->empty() && dbase_ro)
+		dbase_ro->loadBlock(blockpos, blob);
+	return !blob->empty();
+}
+
+void ServerMap::markBlockLoadOutdated(v3s16 blockpos)
+{
+	auto it = m_loading_blocks.find(blockpos);
+	if (it != m_loading_blocks.end())
+		it->second = true;
+}
+
+MapBlock *ServerMap::deSerializeBlock(v3s16 blockpos, const std::string &blob,
+		bool *corrupt)
+{
+	MapBlock *block = new MapBlock(this, blockpos, m_gamedef);
+
+	std::shared_lock<std::shared_timed_mutex> lock(m_nodedef_mutex);
+	if (!deSerializeBlock(block, blob, false, corrupt)) {
+		delete block;
+		return nullptr;
 	}
+	return block;
+}
 
-	MapBlock *block = getBlockNoCreateNoEx(blockpos);
-	if (created_new && (block != NULL)) {
-		std::map<v3s16, MapBlock*> modified_blocks;
-		// Fix lighting if necessary
-		voxalgo::update_block_border_lighting(this, block, modified_blocks);
-		if (!modified_blocks.empty()) {
-			//Modified lighting, send event
-			MapEditEvent event;
-			event.type = MEET_OTHER;
-			std::map<v3s16, MapBlock *>::iterator it;
-			for (it = modified_blocks.begin();
-					it != modified_blocks.end(); ++it)
-				event.modified_blocks.insert(it->first);
-			dispatchEvent(event);
+MapBlock *ServerMap::finishLoadBlock(v3s16 blockpos, const std::string &blob,
+		MapBlock *block, bool corrupt)
+{
+	bool outdated;
+	{
+		MutexAutoLock lock(m_db_mutex);
+		auto it = m_loading_blocks.find(blockpos);
+		sanity_check(it != m_loading_blocks.end());
+		outdated = it->second;
+		m_loading_blocks.erase(it);
+	}
+
+	if (MapBlock *existing = getBlockNoCreateNoEx(blockpos)) {
+		// Created meanwhile, do not overwrite it
+		delete block;
+		return existing;
+	}
+
+	if (outdated) {
+		// Saved or deleted meanwhile, the data at hand is old
+		delete block;
+		return loadBlock(blockpos);
+	}
+
+	// Corrupt data was already reported, don't read it again
+	if (blob.empty() || corrupt) {
+		delete block;
+		return nullptr;
+	}
+
+	return loadBlock(blockpos, blob, block);
+}
+
+MapBlock *ServerMap::loadBlock(v3s16 blockpos, const std::string &blob,
+		MapBlock *block)
+{
+	if (MapBlock *existing = getBlockNoCreateNoEx(blockpos)) {
+		// Created meanwhile, do not overwrite it
+		delete block;
+		return existing;
+	}
+
+	if (!block) {
+		block = new MapBlock(this, blockpos, m_gamedef);
+
+		std::unique_lock<std::shared_timed_mutex> lock(m_nodedef_mutex);
+		if (!deSerializeBlock(block, blob, true)) {
+			delete block;
+			return nullptr;
 		}
 	}
+
+	createSector(v2s16(blockpos.X, blockpos.Z))->insertBlock(block);
+	ReflowScan scanner(this, m_emerge->ndef);
+	scanner.scan(block, &m_transforming_liquid);
+
+	// We just loaded it from, so it's up-to-date.
+	block->resetModified();
+
+	std::map<v3s16, MapBlock*> modified_blocks;
+	// Fix lighting if necessary
+	voxalgo::update_block_border_lighting(this, block, modified_blocks);
+	if (!modified_blocks.empty()) {
+		//Modified lighting, send event
+		MapEditEvent event;
+		event.type = MEET_OTHER;
+		std::map<v3s16, MapBlock *>::iterator it;
+		for (it = modified_blocks.begin();
+				it != modified_blocks.end(); ++it)
+			event.modified_blocks.insert(it->first);
+		dispatchEvent(event);
+	}
 	return block;
 }
 
+MapBlock* ServerMap::loadBlock(v3s16 blockpos)
+{
+	std::string blob;
+	if (!readBlockData(blockpos, &blob))
+		return nullptr;
+
+	return loadBlock(blockpos, blob);
+}
+
 bool ServerMap::deleteBlock(v3s16 blockpos)
 {
-	if (!dbase->deleteBlock(blockpos))
-		return false;
+	{
+		MutexAutoLock lock(m_db_mutex);
+		markBlockLoadOutdated(blockpos);
+		if (!dbase->deleteBlock(blockpos))
+			return false;
+	}
 
 	MapBlock *block = getBlockNoCreateNoEx(blockpos);
 	if (block) {
@@ -24,6 +24,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <set>
 #include <map>
 #include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 #include "irrlichttypes_bloated.h"
 #include "mapblock.h"
@@ -31,11 +34,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "constants.h"
 #include "voxel.h"
 #include "modifiedstate.h"
+#include "util/basic_macros.h"
 #include "util/container.h"
 #include "util/metricsbackend.h"
 #include "util/numeric.h"
 #include "nodetimer.h"
 #include "map_settings_manager.h"
+#include "mapgen/heightcache.h"
+#include "settings.h"
 #include "debug.h"
 
 class Settings;
@@ -267,6 +273,14 @@ class Map /*: public NodeContainer*/
 	// as its second. If it returns false, forEachNodeInArea returns early.
 	template<typename F>
 	void forEachNodeInArea(v3s16 minp, v3s16 maxp, F func)
+	{
+		forEachNodeInArea(minp, maxp, [] (MapBlock *) { return true; }, func);
+	}
+
+	// Like above, but skips the blocks for which block_pred returns false.
+	// block_pred is called with nullptr for blocks that are not loaded.
+	template<typename B, typename F>
+	void forEachNodeInArea(v3s16 minp, v3s16 maxp, B block_pred, F func)
 	{
 		v3s16 bpmin = getNodeBlockPos(minp);
 		v3s16 bpmax = getNodeBlockPos(maxp);
@@ -276,6 +290,9 @@ class Map /*: public NodeContainer*/
 			// y is iterated innermost to make use of the sector cache.
 			v3s16 bp(bx, by, bz);
 			MapBlock *block = getBlockNoCreateNoEx(bp);
+			if (!block_pred(block))
+				continue;
+
 			v3s16 basep = bp * MAP_BLOCKSIZE;
 			s16 minx_block = rangelim(minp.X - basep.X, 0, MAP_BLOCKSIZE - 1);
 			s16 miny_block = rangelim(minp.Y - basep.Y, 0, MAP_BLOCKSIZE - 1);
@@ -296,6 +313,30 @@ class Map /*: public NodeContainer*/
 		}
 	}
 
+	// Like forEachNodeInArea, but only visits nodes with one of the contents
+	// in 'filter'. Loaded blocks that contain none of them are skipped.
+	template<typename F>
+	void forEachNodeInAreaWithContent(v3s16 minp, v3s16 maxp,
+			const std::vector<content_t> &filter, F func)
+	{
+		bool want_ignore = CONTAINS(filter, CONTENT_IGNORE);
+		forEachNodeInArea(minp, maxp,
+			[&] (MapBlock *block) {
+				return block ? block->containsAnyContent(filter) : want_ignore;
+			},
+			[&] (v3s16 p, MapNode n) {
+				return !CONTAINS(filter, n.getContent()) || func(p, n);
+			});
+	}
+
+	// Finds the closest node with one of the contents in 'filter' whose
+	// distance to 'pos' (maximum metric) is within [start_radius, radius].
+	// Of equally distant nodes, the closest by euclidean distance wins.
+	// Blocks are searched in shells around pos, skipping those that do
+	// not contain any of the contents.
+	bool findNodeNear(v3s16 pos, s32 start_radius, s32 radius,
+			const std::vector<content_t> &filter, v3s16 *found_pos);
+
 	bool isBlockOccluded(MapBlock *block, v3s16 cam_pos_nodes);
 protected:
 	IGameDef *m_gamedef;
@@ -400,8 +441,23 @@ class ServerMap : public Map
 	bool saveBlock(MapBlock *block) override;
 	static bool saveBlock(MapBlock *block, MapDatabase *db, int compression_level = -1);
 	MapBlock* loadBlock(v3s16 p);
-	// Database version
-	void loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool save_after_load=false);
+
+	/*
+		Loading in steps, so that emerge threads do the slow part without
+		holding the environment lock:
+		beginLoadBlock() reads the data and deSerializeBlock() turns it into
+		a block that is not part of the map yet. Both are thread-safe.
+		deSerializeBlock() returns nullptr if the data is corrupt (sets
+		'corrupt') or if the block has to be deserialized with the lock.
+		finishLoadBlock() with the lock then adds the block to the map. It
+		takes ownership of 'block' and returns the block that is in the map.
+		If the block was saved or deleted since beginLoadBlock(), the data
+		is outdated and the block is read again.
+	*/
+	bool beginLoadBlock(v3s16 p, std::string *blob);
+	MapBlock *deSerializeBlock(v3s16 p, const std::string &blob, bool *corrupt);
+	MapBlock *finishLoadBlock(v3s16 p, const std::string &blob, MapBlock *block,
+			bool corrupt);
 
 	bool deleteBlock(v3s16 blockpos) override;
 
@@ -430,6 +486,8 @@ class ServerMap : public Map
 	void transforming_liquid_add(v3s16 p);
 
 	MapSettingsManager settings_mgr;
+	// Ground levels recorded by the mapgens, kept in the heightcache directory
+	TerrainHeightCache height_cache;
 
 protected:
 
@@ -438,6 +496,16 @@ class ServerMap : public Map
 private:
 	friend class LuaVoxelManip;
 
+	// Returns false if the block could not be read (sets 'corrupt'), or if it
+	// contains unknown nodes and allocate_unknown is false
+	static bool deSerializeBlock(MapBlock *block, const std::string &blob,
+			bool allocate_unknown, bool *corrupt = nullptr);
+
+	bool readBlockData(v3s16 p, std::string *blob);
+	MapBlock *loadBlock(v3s16 p, const std::string &blob, MapBlock *block = nullptr);
+	// Needs m_db_mutex
+	void markBlockLoadOutdated(v3s16 p);
+
 	// Emerge manager
 	EmergeManager *m_emerge;
 
@@ -451,6 +519,8 @@ class ServerMap : public Map
 	// Queued transforming water nodes
 	UniqueQueue<v3s16> m_transforming_liquid;
 	f32 m_transforming_liquid_loop_count_multiplier = 1.0f;
+	CachedSetting<s32> m_liquid_loop_max{"liquid_loop_max"};
+	CachedSetting<u16> m_liquid_queue_purge_time{"liquid_queue_purge_time"};
 	u32 m_unprocessed_count = 0;
 	u64 m_inc_trending_up_start_time = 0; // milliseconds
 	bool m_queue_size_timer_started = false;
@@ -462,6 +532,14 @@ class ServerMap : public Map
 	bool m_map_metadata_changed = true;
 	MapDatabase *dbase = nullptr;
 	MapDatabase *dbase_ro = nullptr;
+	// Guards the databases, which emerge threads read without the environment lock
+	std::mutex m_db_mutex;
+	// Blocks between beginLoadBlock() and finishLoadBlock(), set to true if
+	// their data was overwritten meanwhile. Guarded by m_db_mutex.
+	std::unordered_map<v3s16, bool> m_loading_blocks;
+	// Held exclusively while unknown nodes are added to the nodedef, which
+	// blocks deserialized without the environment lock may look at
+	std::shared_timed_mutex m_nodedef_mutex;
 
 	// Map metrics
 	MetricGaugePtr m_loaded_blocks_gauge;
@@ -498,6 +576,9 @@ class MMVManip : public VoxelManipulator
 	*/
 	MMVManip *clone() const;
 
+	// Creates an empty VManip not associated with a Map
+	static MMVManip *createOrphan() { return new MMVManip(); }
+
 	// Reassociates a copied VManip to a map
 	void reparent(Map *map);
 
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "mapblock.h"
 
+#include <algorithm>
 #include <sstream>
 #include "map.h"
 #include "light.h"
@@ -194,6 +195,8 @@ void MapBlock::copyTo(VoxelManipulator &dst)
 
 void MapBlock::copyFrom(VoxelManipulator &dst)
 {
+	m_present_contents_valid = false;
+
 	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
@@ -202,6 +205,33 @@ void MapBlock::copyFrom(VoxelManipulator &dst)
 			getPosRelative(), data_size);
 }
 
+bool MapBlock::containsAnyContent(const std::vector<content_t> &filter)
+{
+	if (!m_present_contents_valid) {
+		m_present_contents.clear();
+		content_t last = CONTENT_IGNORE;
+		for (u32 i = 0; i < nodecount; i++) {
+			content_t c = data[i].getContent();
+			// Skip runs of the same content before sorting
+			if (i == 0 || c != last)
+				m_present_contents.push_back(c);
+			last = c;
+		}
+		std::sort(m_present_contents.begin(), m_present_contents.end());
+		m_present_contents.erase(std::unique(m_present_contents.begin(),
+			m_present_contents.end()), m_present_contents.end());
+		m_present_contents.shrink_to_fit();
+		m_present_contents_valid = true;
+	}
+
+	for (content_t c : filter) {
+		if (std::binary_search(m_present_contents.begin(),
+				m_present_contents.end(), c))
+			return true;
+	}
+	return false;
+}
+
 void MapBlock::actuallyUpdateDayNightDiff()
 {
 	const NodeDefManager *nodemgr = m_gamedef->ndef();
@@ -307,10 +337,10 @@ static void getBlockNodeIdMapping(NameIdMapping *nimap, MapNode *nodes,
 }
 
 // Correct ids in the block to match nodedef based on names.
-// Unknown ones are added to nodedef.
+// Unknown ones are added to nodedef, or false is returned if allocate_unknown is false.
 // Will not update itself to match id-name pairs in nodedef.
-static void correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
-		IGameDef *gamedef)
+static bool correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
+		IGameDef *gamedef, bool allocate_unknown)
 {
 	const NodeDefManager *nodedef = gamedef->ndef();
 	// This means the block contains incorrect ids, and we contain
@@ -344,6 +374,8 @@ static void correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
 
 		content_t global_id;
 		if (!nodedef->getId(name, global_id)) {
+			if (!allocate_unknown)
+				return false;
 			global_id = gamedef->allocateUnknownNodeId(name);
 			if (global_id == CONTENT_IGNORE) {
 				unallocatable_contents.insert(name);
@@ -369,6 +401,7 @@ static void correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
 				<< "Could not allocate global id for node name \""
 				<< node_name << "\"" << std::endl;
 	}
+	return true;
 }
 
 void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int compression_level)
@@ -482,7 +515,8 @@ void MapBlock::serializeNetworkSpecific(std::ostream &os)
 	writeU8(os, 2); // version
 }
 
-void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
+bool MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk,
+		bool allocate_unknown)
 {
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
@@ -490,11 +524,11 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 	TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())<<std::endl);
 
 	m_day_night_differs_expired = false;
+	m_present_contents_valid = false;
 
 	if(version <= 21)
 	{
-		deSerialize_pre22(in_compressed, version, disk);
-		return;
+		return deSerialize_pre22(in_compressed, version, disk, allocate_unknown);
 	}
 
 	// Decompress the whole block (version >= 29)
@@ -608,7 +642,8 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 		}
 
 		// Dynamically re-set ids based on node names
-		correctBlockNodeIds(&nimap, data, m_gamedef);
+		if (!correctBlockNodeIds(&nimap, data, m_gamedef, allocate_unknown))
+			return false;
 
 		if(version >= 25){
 			TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
@@ -619,6 +654,7 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 
 	TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
 			<<": Done."<<std::endl);
+	return true;
 }
 
 void MapBlock::deSerializeNetworkSpecific(std::istream &is)
@@ -659,7 +695,8 @@ u32 MapBlock::clearObjects()
 	Legacy serialization
 */
 
-void MapBlock::deSerialize_pre22(std::istream &is, u8 version, bool disk)
+bool MapBlock::deSerialize_pre22(std::istream &is, u8 version, bool disk,
+		bool allocate_unknown)
 {
 	// Initialize default flags
 	is_underground = false;
@@ -791,7 +828,7 @@ void MapBlock::deSerialize_pre22(std::istream &is, u8 version, bool disk)
 			if(count != 0){
 				warningstream<<"MapBlock::deSerialize_pre22(): "
 						<<"Ignoring stuff coming at and after MBOs"<<std::endl;
-				return;
+				return true;
 			}
 		}
 
@@ -818,7 +855,8 @@ void MapBlock::deSerialize_pre22(std::istream &is, u8 version, bool disk)
 		} else {
 			content_mapnode_get_name_id_mapping(&nimap);
 		}
-		correctBlockNodeIds(&nimap, data, m_gamedef);
+		if (!correctBlockNodeIds(&nimap, data, m_gamedef, allocate_unknown))
+			return false;
 	}
 
 	// Legacy data changes
@@ -858,6 +896,7 @@ void MapBlock::deSerialize_pre22(std::istream &is, u8 version, bool disk)
 			data[i].setParam2(dir_new_format);
 		}
 	}
+	return true;
 }
 
 /*
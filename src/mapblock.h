@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <set>
+#include <vector>
 #include "irr_v3d.h"
 #include "mapnode.h"
 #include "exceptions.h"
@@ -111,8 +112,10 @@ class MapBlock
 		} else if (mod == m_modified) {
 			m_modified_reason |= reason;
 		}
-		if (mod == MOD_STATE_WRITE_NEEDED)
+		if (mod == MOD_STATE_WRITE_NEEDED) {
 			contents_cached = false;
+			m_present_contents_valid = false;
+		}
 	}
 
 	inline u32 getModified()
@@ -303,6 +306,10 @@ class MapBlock
 	bool isValidPositionParent(v3s16 p);
 	MapNode getNodeParent(v3s16 p, bool *is_valid_position = NULL);
 
+	// Returns false if no node in the block has one of the given contents.
+	// Unlike the ABM content cache this is always exact.
+	bool containsAnyContent(const std::vector<content_t> &filter);
+
 	// Copies data to VoxelManipulator to getPosRelative()
 	void copyTo(VoxelManipulator &dst);
 
@@ -428,8 +435,11 @@ class MapBlock
 	// Precondition: version >= SER_FMT_VER_LOWEST_WRITE
 	void serialize(std::ostream &result, u8 version, bool disk, int compression_level);
 	// If disk == true: In addition to doing other things, will add
-	// unknown blocks from id-name mapping to wndef
-	void deSerialize(std::istream &is, u8 version, bool disk);
+	// unknown blocks from id-name mapping to wndef.
+	// Unless allocate_unknown is false: then nothing is added to the
+	// nodedef (which is not thread-safe) and false is returned instead.
+	bool deSerialize(std::istream &is, u8 version, bool disk,
+			bool allocate_unknown = true);
 
 	void serializeNetworkSpecific(std::ostream &os);
 	void deSerializeNetworkSpecific(std::istream &is);
@@ -443,7 +453,8 @@ class MapBlock
 		Private methods
 	*/
 
-	void deSerialize_pre22(std::istream &is, u8 version, bool disk);
+	bool deSerialize_pre22(std::istream &is, u8 version, bool disk,
+			bool allocate_unknown);
 
 public:
 	/*
@@ -477,6 +488,10 @@ class MapBlock
 
 	// NOTE: Lots of things rely on this being the Map
 	Map *m_parent;
+
+	// Sorted contents of the nodes, see containsAnyContent()
+	std::vector<content_t> m_present_contents;
+	bool m_present_contents_valid = false;
 	// Position in blocks on parent
 	v3s16 m_pos;
 
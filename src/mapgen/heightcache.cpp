@@ -0,0 +1,245 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "heightcache.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "porting.h"
+#include "serialization.h"
+#include "threading/mutex_auto_lock.h"
+#include "util/serialize.h"
+#include "util/string.h"
+
+#define HEIGHTCACHE_SER_VER 2
+
+static inline s16 floor_div(s16 a, s16 b)
+{
+	return (a >= 0) ? a / b : -((b - 1 - a) / b);
+}
+
+static inline u32 sample_index(s16 sx, s16 sz, v2s16 regionpos)
+{
+	return (sz - regionpos.Y * HEIGHTCACHE_REGION_SAMPLES) * HEIGHTCACHE_REGION_SAMPLES +
+		(sx - regionpos.X * HEIGHTCACHE_REGION_SAMPLES);
+}
+
+
+void TerrainHeightCache::setSaveDir(const std::string &dir)
+{
+	MutexAutoLock lock(m_mutex);
+	m_savedir = dir;
+	m_regions.clear();
+}
+
+
+std::string TerrainHeightCache::getRegionPath(v2s16 regionpos) const
+{
+	return m_savedir + DIR_DELIM + itos(regionpos.X) + "_" + itos(regionpos.Y);
+}
+
+
+TerrainHeightCache::Region *TerrainHeightCache::getRegion(v2s16 regionpos,
+	bool create)
+{
+	auto it = m_regions.find(regionpos);
+	if (it == m_regions.end()) {
+		std::unique_ptr<Region> region;
+		if (!m_savedir.empty()) {
+			std::ifstream is(getRegionPath(regionpos).c_str(), std::ios_base::binary);
+			if (is.good()) {
+				try {
+					u8 version = readU8(is);
+					if (version != HEIGHTCACHE_SER_VER)
+						throw SerializationError("unsupported version");
+
+					std::stringstream data(std::ios_base::binary |
+						std::ios_base::in | std::ios_base::out);
+					decompressZlib(is, data);
+					region.reset(new Region());
+					for (s16 &h : region->heights)
+						h = readS16(data);
+				} catch (SerializationError &e) {
+					warningstream << "TerrainHeightCache: Failed to load region ("
+						<< regionpos.X << "," << regionpos.Y << "): "
+						<< e.what() << std::endl;
+					region.reset();
+				}
+			}
+		}
+		it = m_regions.emplace(regionpos, CachedRegion{std::move(region), 0}).first;
+	}
+	it->second.last_used = porting::getTimeS();
+
+	if (!it->second.region && create)
+		it->second.region.reset(new Region());
+	return it->second.region.get();
+}
+
+
+s16 TerrainHeightCache::getSample(s16 sx, s16 sz)
+{
+	v2s16 regionpos(floor_div(sx, HEIGHTCACHE_REGION_SAMPLES),
+		floor_div(sz, HEIGHTCACHE_REGION_SAMPLES));
+	Region *region = getRegion(regionpos, false);
+	if (!region)
+		return HEIGHTCACHE_UNKNOWN;
+	return region->heights[sample_index(sx, sz, regionpos)];
+}
+
+
+void TerrainHeightCache::update(const s16 *heightmap, v3s16 nmin, v3s16 nmax)
+{
+	const s16 csize_x = nmax.X - nmin.X + 1;
+	const s16 smin_x = floor_div(nmin.X + HEIGHTCACHE_SPACING - 1, HEIGHTCACHE_SPACING);
+	const s16 smax_x = floor_div(nmax.X, HEIGHTCACHE_SPACING);
+	const s16 smin_z = floor_div(nmin.Z + HEIGHTCACHE_SPACING - 1, HEIGHTCACHE_SPACING);
+	const s16 smax_z = floor_div(nmax.Z, HEIGHTCACHE_SPACING);
+
+	MutexAutoLock lock(m_mutex);
+
+	for (s16 sz = smin_z; sz <= smax_z; sz++)
+	for (s16 sx = smin_x; sx <= smax_x; sx++) {
+		s16 x = sx * HEIGHTCACHE_SPACING;
+		s16 z = sz * HEIGHTCACHE_SPACING;
+		s16 y = heightmap[(z - nmin.Z) * csize_x + (x - nmin.X)];
+		// Ground must have been found below the top of the mapchunk
+		if (y < nmin.Y || y >= nmax.Y)
+			continue;
+
+		v2s16 regionpos(floor_div(sx, HEIGHTCACHE_REGION_SAMPLES),
+			floor_div(sz, HEIGHTCACHE_REGION_SAMPLES));
+		Region *region = getRegion(regionpos, true);
+		s16 &h = region->heights[sample_index(sx, sz, regionpos)];
+		if (y > h) {
+			h = y;
+			region->modified = true;
+		}
+	}
+}
+
+
+bool TerrainHeightCache::getGroundLevel(v2s16 p, s16 *level)
+{
+	// Samples at or around p. The highest one is taken, as a position
+	// above the ground can still be searched upwards from.
+	const s16 smin_x = floor_div(p.X, HEIGHTCACHE_SPACING);
+	const s16 smin_z = floor_div(p.Y, HEIGHTCACHE_SPACING);
+	const s16 smax_x = smin_x + (p.X != smin_x * HEIGHTCACHE_SPACING);
+	const s16 smax_z = smin_z + (p.Y != smin_z * HEIGHTCACHE_SPACING);
+
+	MutexAutoLock lock(m_mutex);
+
+	s16 max_h = HEIGHTCACHE_UNKNOWN;
+	for (s16 sz = smin_z; sz <= smax_z; sz++)
+	for (s16 sx = smin_x; sx <= smax_x; sx++) {
+		s16 h = getSample(sx, sz);
+		if (h == HEIGHTCACHE_UNKNOWN)
+			return false;
+		max_h = std::max(max_h, h);
+	}
+
+	*level = max_h;
+	return true;
+}
+
+
+size_t TerrainHeightCache::getRegionCount()
+{
+	MutexAutoLock lock(m_mutex);
+	size_t count = 0;
+	for (const auto &it : m_regions) {
+		if (it.second.region)
+			count++;
+	}
+	return count;
+}
+
+
+bool TerrainHeightCache::save(u32 unload_timeout)
+{
+	// Copied, so that the emerge threads are not kept waiting for the disk
+	std::vector<std::pair<v2s16, Region>> modified;
+	{
+		MutexAutoLock lock(m_mutex);
+		if (m_savedir.empty())
+			return true;
+
+		for (auto &it : m_regions) {
+			Region *region = it.second.region.get();
+			if (!region || !region->modified)
+				continue;
+			modified.emplace_back(it.first, *region);
+			region->modified = false;
+		}
+	}
+
+	const bool dir_ok = modified.empty() || fs::CreateAllDirs(m_savedir);
+	if (!dir_ok) {
+		errorstream << "TerrainHeightCache: Failed to create directory "
+			<< m_savedir << std::endl;
+	}
+
+	std::vector<v2s16> failed;
+	for (const auto &it : modified) {
+		if (!dir_ok) {
+			failed.push_back(it.first);
+			continue;
+		}
+
+		std::ostringstream data(std::ios_base::binary);
+		for (s16 h : it.second.heights)
+			writeS16(data, h);
+
+		std::ostringstream os(std::ios_base::binary);
+		writeU8(os, HEIGHTCACHE_SER_VER);
+		compressZlib(data.str(), os);
+
+		std::string path = getRegionPath(it.first);
+		if (!fs::safeWriteToFile(path, os.str())) {
+			errorstream << "TerrainHeightCache: Failed to write " << path
+				<< std::endl;
+			failed.push_back(it.first);
+		}
+	}
+
+	MutexAutoLock lock(m_mutex);
+	for (v2s16 regionpos : failed) {
+		Region *region = m_regions[regionpos].region.get();
+		if (region)
+			region->modified = true;
+	}
+
+	// Regions modified since they were copied, or that failed to save,
+	// are kept
+	const u64 now = porting::getTimeS();
+	for (auto it = m_regions.begin(); it != m_regions.end();) {
+		const CachedRegion &cached = it->second;
+		if ((!cached.region || !cached.region->modified) &&
+				now - cached.last_used >= unload_timeout)
+			it = m_regions.erase(it);
+		else
+			++it;
+	}
+	return failed.empty();
+}
@@ -0,0 +1,112 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "irr_v2d.h"
+#include "irr_v3d.h"
+#include "util/basic_macros.h"
+
+/*
+	Ground level of the unmodified terrain, sampled every
+	HEIGHTCACHE_SPACING nodes and recorded when a mapchunk is generated.
+	Lets spawn level queries skip the mapgen noise in generated areas.
+
+	A sample is only recorded if the ground was found inside the mapchunk:
+	all-air and all-solid columns say nothing about the surface. If several
+	mapchunks of a column have ground (floatlands) the highest one is kept.
+
+	The samples are kept in regions, one file each in the save directory.
+	Like map blocks, regions are loaded when first needed, only the
+	modified ones are written by save() and the ones that were not used
+	for a while are unloaded again.
+
+	Thread-safe, written by the emerge threads.
+*/
+
+#define HEIGHTCACHE_SPACING 4
+// Samples per region side
+#define HEIGHTCACHE_REGION_SAMPLES 64
+#define HEIGHTCACHE_UNKNOWN S16_MIN
+// Seconds after which save() unloads an unused region
+#define HEIGHTCACHE_UNLOAD_TIMEOUT 60
+
+class TerrainHeightCache {
+public:
+	TerrainHeightCache() = default;
+	DISABLE_CLASS_COPY(TerrainHeightCache);
+
+	// Directory the regions are loaded from and saved to. Without one,
+	// the cache is only kept in memory.
+	void setSaveDir(const std::string &dir);
+
+	// heightmap as in Mapgen::heightmap, covering nmin-nmax
+	void update(const s16 *heightmap, v3s16 nmin, v3s16 nmax);
+
+	// Ground level at p. Between the sample points this is the highest of
+	// the surrounding samples. False if one of them was not recorded.
+	bool getGroundLevel(v2s16 p, s16 *level);
+
+	// Writes the modified regions and unloads the ones that were not used
+	// for unload_timeout seconds. Returns false if one could not be written.
+	bool save(u32 unload_timeout = HEIGHTCACHE_UNLOAD_TIMEOUT);
+
+	// Number of regions with samples in memory
+	size_t getRegionCount();
+
+private:
+	struct Region {
+		s16 heights[HEIGHTCACHE_REGION_SAMPLES * HEIGHTCACHE_REGION_SAMPLES];
+		bool modified = false;
+
+		Region()
+		{
+			for (s16 &h : heights)
+				h = HEIGHTCACHE_UNKNOWN;
+		}
+	};
+
+	struct RegionPosHash {
+		size_t operator()(const v2s16 &p) const
+		{
+			return ((u32)(u16)p.X << 16) | (u16)p.Y;
+		}
+	};
+
+	struct CachedRegion {
+		// nullptr for regions known to have no samples
+		std::unique_ptr<Region> region;
+		u64 last_used;
+	};
+
+	// Needs m_mutex. Returns nullptr if there are no samples in the region
+	// and create is false.
+	Region *getRegion(v2s16 regionpos, bool create);
+	// Needs m_mutex. HEIGHTCACHE_UNKNOWN if no sample was recorded.
+	s16 getSample(s16 sx, s16 sz);
+	std::string getRegionPath(v2s16 regionpos) const;
+
+	std::mutex m_mutex;
+	std::string m_savedir;
+	std::unordered_map<v2s16, CachedRegion, RegionPosHash> m_regions;
+};
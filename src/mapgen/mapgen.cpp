@@ -428,13 +428,8 @@ void Mapgen::setLighting(u8 light, v3s16 nmin, v3s16 nmax)
 }
 
 
-void Mapgen::lightSpread(VoxelArea &a, std::queue<std::pair<v3s16, u8>> &queue,
-	const v3s16 &p, u8 light)
+void Mapgen::lightSpread(const v3s16 &p, u32 vi, u8 light)
 {
-	if (light <= 1 || !a.contains(p))
-		return;
-
-	u32 vi = vm->m_area.index(p);
 	MapNode &n = vm->m_data[vi];
 
 	// Decay light in each of the banks separately
@@ -461,7 +456,37 @@ void Mapgen::lightSpread(VoxelArea &a, std::queue<std::pair<v3s16, u8>> &queue,
 	n.param1 = light;
 
 	// add to queue
-	queue.emplace(p, light);
+	u8 level = MYMAX(light & 0x0F, light >> 4);
+	if (level <= 1)
+		return;
+	m_light_queue[level].push_back({vi, p, light});
+	m_light_queue_top = MYMAX(m_light_queue_top, level);
+}
+
+
+void Mapgen::lightSpreadNeighbors(const VoxelArea &a, const v3s16 &p, u32 vi,
+	u8 light)
+{
+	if (light <= 1)
+		return;
+
+	const v3s16 &em = vm->m_area.getExtent();
+	const u32 ystride = em.X;
+	const u32 zstride = em.X * em.Y;
+
+	// Same order as g_6dirs
+	if (p.Z < a.MaxEdge.Z)
+		lightSpread(v3s16(p.X, p.Y, p.Z + 1), vi + zstride, light);
+	if (p.Y < a.MaxEdge.Y)
+		lightSpread(v3s16(p.X, p.Y + 1, p.Z), vi + ystride, light);
+	if (p.X < a.MaxEdge.X)
+		lightSpread(v3s16(p.X + 1, p.Y, p.Z), vi + 1, light);
+	if (p.Z > a.MinEdge.Z)
+		lightSpread(v3s16(p.X, p.Y, p.Z - 1), vi - zstride, light);
+	if (p.Y > a.MinEdge.Y)
+		lightSpread(v3s16(p.X, p.Y - 1, p.Z), vi - ystride, light);
+	if (p.X > a.MinEdge.X)
+		lightSpread(v3s16(p.X - 1, p.Y, p.Z), vi - 1, light);
 }
 
 
@@ -485,26 +510,44 @@ void Mapgen::propagateSunlight(v3s16 nmin, v3s16 nmax, bool propagate_shadow)
 	// NOTE: Direct access to the low 4 bits of param1 is okay here because,
 	// by definition, sunlight will never be in the night lightbank.
 
+	// The columns of a Z slice are walked down together, so that each step
+	// reads a contiguous row of nodes instead of one node per column.
+	// Columns of the slice that sunlight still reaches:
+	std::vector<u8> sunlit(a.MaxEdge.X - a.MinEdge.X + 1);
+
 	for (int z = a.MinEdge.Z; z <= a.MaxEdge.Z; z++) {
-		for (int x = a.MinEdge.X; x <= a.MaxEdge.X; x++) {
-			// see if we can get a light value from the overtop
-			u32 i = vm->m_area.index(x, a.MaxEdge.Y + 1, z);
+		// see if we can get a light value from the overtop
+		u32 sunlit_count = 0;
+		u32 i = vm->m_area.index(a.MinEdge.X, a.MaxEdge.Y + 1, z);
+		for (u8 &column : sunlit) {
+			column = 1;
 			if (vm->m_data[i].getContent() == CONTENT_IGNORE) {
 				if (block_is_underground)
-					continue;
+					column = 0;
 			} else if ((vm->m_data[i].param1 & 0x0F) != LIGHT_SUN &&
 					propagate_shadow) {
-				continue;
+				column = 0;
 			}
-			VoxelArea::add_y(em, i, -1);
+			sunlit_count += column;
+			i++;
+		}
 
-			for (int y = a.MaxEdge.Y; y >= a.MinEdge.Y; y--) {
-				MapNode &n = vm->m_data[i];
-				if (!ndef->getLightingFlags(n).sunlight_propagates)
-					break;
+		i = vm->m_area.index(a.MinEdge.X, a.MaxEdge.Y, z);
+		for (int y = a.MaxEdge.Y; y >= a.MinEdge.Y && sunlit_count > 0; y--) {
+			MapNode *row = &vm->m_data[i];
+			for (size_t x = 0; x < sunlit.size(); x++) {
+				if (!sunlit[x])
+					continue;
+
+				MapNode &n = row[x];
+				if (!ndef->getLightingFlags(n).sunlight_propagates) {
+					sunlit[x] = 0;
+					sunlit_count--;
+					continue;
+				}
 				n.param1 = LIGHT_SUN;
-				VoxelArea::add_y(em, i, -1);
 			}
+			VoxelArea::add_y(em, i, -1);
 		}
 	}
 	//printf("propagateSunlight: %dms\n", t.stop());
@@ -514,7 +557,6 @@ void Mapgen::propagateSunlight(v3s16 nmin, v3s16 nmax, bool propagate_shadow)
 void Mapgen::spreadLight(const v3s16 &nmin, const v3s16 &nmax)
 {
 	//TimeTaker t("spreadLight");
-	std::queue<std::pair<v3s16, u8>> queue;
 	VoxelArea a(nmin, nmax);
 
 	for (int z = a.MinEdge.Z; z <= a.MaxEdge.Z; z++) {
@@ -536,23 +578,39 @@ void Mapgen::spreadLight(const v3s16 &nmin, const v3s16 &nmax)
 				if (light_produced)
 					n.param1 = light_produced | (light_produced << 4);
 
-				u8 light = n.param1;
-				if (light) {
-					const v3s16 p(x, y, z);
-					// spread to all 6 neighbor nodes
-					for (const auto &dir : g_6dirs)
-						lightSpread(a, queue, p + dir, light);
-				}
+				// spread to all 6 neighbor nodes
+				lightSpreadNeighbors(a, v3s16(x, y, z), i, n.param1);
 			}
 		}
 	}
 
-	while (!queue.empty()) {
-		const auto &i = queue.front();
+	// Brightest nodes first: most nodes then get their final light the first
+	// time they are reached, instead of being raised again later. The result
+	// does not depend on the order.
+	m_light_queue_top = 0;
+	for (u8 level = LIGHT_SUN; level > 1;) {
+		std::vector<LightSpreadNode> &bucket = m_light_queue[level];
+		if (bucket.empty()) {
+			level--;
+			continue;
+		}
+
+		const LightSpreadNode node = bucket.back();
+		bucket.pop_back();
+
+		// Skip if the node was raised since, the newer entry covers this one
+		u8 light = vm->m_data[node.vi].param1;
+		if (light != node.light && (light & 0x0F) >= (node.light & 0x0F) &&
+				(light & 0xF0) >= (node.light & 0xF0))
+			continue;
+
 		// spread to all 6 neighbor nodes
-		for (const auto &dir : g_6dirs)
-			lightSpread(a, queue, i.first + dir, i.second);
-		queue.pop();
+		lightSpreadNeighbors(a, node.p, node.vi, node.light);
+
+		// Raising a node in one bank may keep the other, brighter one
+		if (m_light_queue_top > level)
+			level = m_light_queue_top;
+		m_light_queue_top = 0;
 	}
 
 	//printf("spreadLight: %lums\n", t.stop());
@@ -627,6 +685,8 @@ MapgenBasic::~MapgenBasic()
 
 void MapgenBasic::generateBiomes()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: biomes", SPT_ADD);
+
 	// can't generate biomes without a biome generator!
 	assert(biomegen);
 	assert(biomemap);
@@ -634,7 +694,7 @@ void MapgenBasic::generateBiomes()
 	const v3s16 &em = vm->m_area.getExtent();
 	u32 index = 0;
 
-	noise_filler_depth->perlinMap2D(node_min.X, node_min.Z);
+	noise2d_cache.perlinMap2D(noise_filler_depth, v2s16(node_min.X, node_min.Z));
 
 	for (s16 z = node_min.Z; z <= node_max.Z; z++)
 	for (s16 x = node_min.X; x <= node_max.X; x++, index++) {
@@ -764,6 +824,8 @@ void MapgenBasic::generateBiomes()
 
 void MapgenBasic::dustTopNodes()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: biomes", SPT_ADD);
+
 	if (node_max.Y < water_level)
 		return;
 
@@ -828,6 +890,8 @@ void MapgenBasic::dustTopNodes()
 
 void MapgenBasic::generateCavesNoiseIntersection(s16 max_stone_y)
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: caves", SPT_ADD);
+
 	// cave_width >= 10 is used to disable generation and avoid the intensive
 	// 3D noise calculations. Tunnels already have zero width when cave_width > 1.
 	if (node_min.Y > max_stone_y || cave_width >= 10.0f)
@@ -842,6 +906,8 @@ void MapgenBasic::generateCavesNoiseIntersection(s16 max_stone_y)
 
 void MapgenBasic::generateCavesRandomWalk(s16 max_stone_y, s16 large_cave_ymax)
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: caves", SPT_ADD);
+
 	if (node_min.Y > max_stone_y)
 		return;
 
@@ -873,6 +939,8 @@ void MapgenBasic::generateCavesRandomWalk(s16 max_stone_y, s16 large_cave_ymax)
 
 bool MapgenBasic::generateCavernsNoise(s16 max_stone_y)
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: caves", SPT_ADD);
+
 	if (node_min.Y > max_stone_y || node_min.Y > cavern_limit)
 		return false;
 
@@ -885,6 +953,8 @@ bool MapgenBasic::generateCavernsNoise(s16 max_stone_y)
 
 void MapgenBasic::generateDungeons(s16 max_stone_y)
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: dungeons", SPT_ADD);
+
 	if (node_min.Y > max_stone_y || node_min.Y > dungeon_ymax ||
 			node_max.Y < dungeon_ymin)
 		return;
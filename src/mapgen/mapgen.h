@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "noise.h"
 #include "nodedef.h"
+#include "light.h"
 #include "util/string.h"
 #include "util/container.h"
 #include <utility>
@@ -234,6 +235,13 @@ class Mapgen {
 	// signify this and to cause Server::findSpawnPos() to try another (X, Z).
 	virtual int getSpawnLevelAtPoint(v2s16 p) { return 0; }
 
+	// Same as getSpawnLevelAtPoint(), but for a point where the ground level
+	// of the generated terrain is already known. Applies the same rules
+	// without the terrain noise. Returns false if the mapgen can't tell from
+	// the ground level alone, getSpawnLevelAtPoint() must be used then.
+	virtual bool getSpawnLevelAtGround(v2s16 p, s16 ground, int *level)
+	{ return false; }
+
 	// Mapgen management functions
 	static MapgenType getMapgenType(const std::string &mgname);
 	static const char *getMapgenName(MapgenType mgtype);
@@ -243,18 +251,39 @@ class Mapgen {
 	static void getMapgenNames(std::vector<const char *> *mgnames, bool include_hidden);
 	static void setDefaultSettings(Settings *settings);
 
+protected:
+	// 2D noise maps of the recently generated mapchunk columns
+	Noise2DCache noise2d_cache;
+
 private:
+	struct LightSpreadNode {
+		u32 vi;
+		v3s16 p;
+		u8 light;
+	};
+
 	/**
-	 * Spread light to the node at the given position, add to queue if changed.
+	 * Spread light to the node at the given position, queue it if changed.
 	 * The given light value is diminished once.
+	 * @param p Node position, must be within the spread area
+	 * @param vi Index of p in the VoxelManip
+	 * @param light Light value (contains both banks)
+	 */
+	void lightSpread(const v3s16 &p, u32 vi, u8 light);
+	/**
+	 * Spread light to the neighbors of the given node within the area.
 	 * @param a VoxelArea being operated on
-	 * @param queue Queue for later lightSpread() calls
 	 * @param p Node position
-	 * @param light Light value (contains both banks)
-	 *
+	 * @param vi Index of p in the VoxelManip
+	 * @param light Light value of the node (contains both banks)
 	 */
-	void lightSpread(VoxelArea &a, std::queue<std::pair<v3s16, u8>> &queue,
-		const v3s16 &p, u8 light);
+	void lightSpreadNeighbors(const VoxelArea &a, const v3s16 &p, u32 vi, u8 light);
+
+	// Nodes which still have to spread their light, indexed by the brighter
+	// of both banks. Nodes with light 1 or less have nothing to spread.
+	std::vector<LightSpreadNode> m_light_queue[LIGHT_SUN + 1];
+	// Highest level added to m_light_queue since the last check
+	u8 m_light_queue_top = 0;
 
 	// isLiquidHorizontallyFlowable() is a helper function for updateLiquid()
 	// that checks whether there are floodable nodes without liquid beneath
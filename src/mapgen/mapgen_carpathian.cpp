@@ -28,7 +28,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "map.h"
 #include "nodedef.h"
 #include "voxelalgorithms.h"
-//#include "profiler.h" // For TimeTaker
+#include "profiler.h"
 #include "settings.h" // For g_settings
 #include "emerge.h"
 #include "dungeongen.h"
@@ -434,30 +434,56 @@ int MapgenCarpathian::getSpawnLevelAtPoint(v2s16 p)
 }
 
 
+bool MapgenCarpathian::getSpawnLevelAtGround(v2s16 p, s16 ground, int *level)
+{
+	if (spflags & MGCARPATHIAN_RIVERS) {
+		float river = std::fabs(NoisePerlin2D(&noise_rivers->np, p.X, p.Y, seed)) -
+			river_width;
+		if (river < 0.0f) {
+			*level = MAX_MAP_GENERATION_LIMIT; // Unsuitable spawn point
+			return true;
+		}
+	}
+
+	// The search above needs the ground and 3 nodes above it
+	// within water_level to water_level + 32
+	if (ground < water_level || ground + 3 > water_level + 32) {
+		*level = MAX_MAP_GENERATION_LIMIT; // No suitable spawn point found
+		return true;
+	}
+
+	*level = ground + 2;
+	return true;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 
 
 int MapgenCarpathian::generateTerrain()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: terrain", SPT_ADD);
+
 	MapNode mn_air(CONTENT_AIR);
 	MapNode mn_stone(c_stone);
 	MapNode mn_water(c_water_source);
 
 	// Calculate noise for terrain generation
-	noise_height1->perlinMap2D(node_min.X, node_min.Z);
-	noise_height2->perlinMap2D(node_min.X, node_min.Z);
-	noise_height3->perlinMap2D(node_min.X, node_min.Z);
-	noise_height4->perlinMap2D(node_min.X, node_min.Z);
-	noise_hills_terrain->perlinMap2D(node_min.X, node_min.Z);
-	noise_ridge_terrain->perlinMap2D(node_min.X, node_min.Z);
-	noise_step_terrain->perlinMap2D(node_min.X, node_min.Z);
-	noise_hills->perlinMap2D(node_min.X, node_min.Z);
-	noise_ridge_mnt->perlinMap2D(node_min.X, node_min.Z);
-	noise_step_mnt->perlinMap2D(node_min.X, node_min.Z);
+	v2s16 pos2d(node_min.X, node_min.Z);
+	noise2d_cache.perlinMap2D(noise_height1, pos2d);
+	noise2d_cache.perlinMap2D(noise_height2, pos2d);
+	noise2d_cache.perlinMap2D(noise_height3, pos2d);
+	noise2d_cache.perlinMap2D(noise_height4, pos2d);
+	noise2d_cache.perlinMap2D(noise_hills_terrain, pos2d);
+	noise2d_cache.perlinMap2D(noise_ridge_terrain, pos2d);
+	noise2d_cache.perlinMap2D(noise_step_terrain, pos2d);
+	noise2d_cache.perlinMap2D(noise_hills, pos2d);
+	noise2d_cache.perlinMap2D(noise_ridge_mnt, pos2d);
+	noise2d_cache.perlinMap2D(noise_step_mnt, pos2d);
 	noise_mnt_var->perlinMap3D(node_min.X, node_min.Y - 1, node_min.Z);
 
 	if (spflags & MGCARPATHIAN_RIVERS)
-		noise_rivers->perlinMap2D(node_min.X, node_min.Z);
+		noise2d_cache.perlinMap2D(noise_rivers, pos2d);
 
 	//// Place nodes
 	const v3s16 &em = vm->m_area.getExtent();
@@ -86,6 +86,7 @@ class MapgenCarpathian : public MapgenBasic
 
 	virtual void makeChunk(BlockMakeData *data);
 	int getSpawnLevelAtPoint(v2s16 p);
+	bool getSpawnLevelAtGround(v2s16 p, s16 ground, int *level);
 
 private:
 	float base_level;
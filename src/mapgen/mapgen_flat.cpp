@@ -27,7 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "map.h"
 #include "nodedef.h"
 #include "voxelalgorithms.h"
-//#include "profiler.h" // For TimeTaker
+#include "profiler.h"
 #include "settings.h" // For g_settings
 #include "emerge.h"
 #include "dungeongen.h"
@@ -289,6 +289,8 @@ void MapgenFlat::makeChunk(BlockMakeData *data)
 
 s16 MapgenFlat::generateTerrain()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: terrain", SPT_ADD);
+
 	MapNode n_air(CONTENT_AIR);
 	MapNode n_stone(c_stone);
 	MapNode n_water(c_water_source);
@@ -299,7 +301,7 @@ s16 MapgenFlat::generateTerrain()
 
 	bool use_noise = (spflags & MGFLAT_LAKES) || (spflags & MGFLAT_HILLS);
 	if (use_noise)
-		noise_terrain->perlinMap2D(node_min.X, node_min.Z);
+		noise2d_cache.perlinMap2D(noise_terrain, v2s16(node_min.X, node_min.Z));
 
 	for (s16 z = node_min.Z; z <= node_max.Z; z++)
 	for (s16 x = node_min.X; x <= node_max.X; x++, ni2d++) {
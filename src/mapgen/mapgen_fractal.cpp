@@ -28,7 +28,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "map.h"
 #include "nodedef.h"
 #include "voxelalgorithms.h"
-//#include "profiler.h" // For TimeTaker
+#include "profiler.h"
 #include "settings.h" // For g_settings
 #include "emerge.h"
 #include "dungeongen.h"
@@ -407,6 +407,8 @@ bool MapgenFractal::getFractalAtPoint(s16 x, s16 y, s16 z)
 
 s16 MapgenFractal::generateTerrain()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: terrain", SPT_ADD);
+
 	MapNode n_air(CONTENT_AIR);
 	MapNode n_stone(c_stone);
 	MapNode n_water(c_water_source);
@@ -415,7 +417,7 @@ s16 MapgenFractal::generateTerrain()
 	u32 index2d = 0;
 
 	if (noise_seabed)
-		noise_seabed->perlinMap2D(node_min.X, node_min.Z);
+		noise2d_cache.perlinMap2D(noise_seabed, v2s16(node_min.X, node_min.Z));
 
 	for (s16 z = node_min.Z; z <= node_max.Z; z++) {
 		for (s16 y = node_min.Y - 1; y <= node_max.Y + 1; y++) {
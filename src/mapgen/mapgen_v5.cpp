@@ -27,7 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "map.h"
 #include "nodedef.h"
 #include "voxelalgorithms.h"
-//#include "profiler.h" // For TimeTaker
+#include "profiler.h"
 #include "settings.h" // For g_settings
 #include "emerge.h"
 #include "dungeongen.h"
@@ -162,6 +162,16 @@ void MapgenV5Params::setDefaultSettings(Settings *settings)
 /////////////////////////////////////////////////////////////////
 
 
+s16 MapgenV5::getMaxSpawnLevel()
+{
+	// noise_height 'offset' is the average level of terrain. At least 50% of
+	// terrain will be below this.
+	// Raising the maximum spawn level above 'water_level + 16' is necessary
+	// for when noise_height 'offset' is set much higher than water_level.
+	return MYMAX(noise_height->np.offset, water_level + 16);
+}
+
+
 int MapgenV5::getSpawnLevelAtPoint(v2s16 p)
 {
 
@@ -172,11 +182,7 @@ int MapgenV5::getSpawnLevelAtPoint(v2s16 p)
 		f *= 1.6;
 	float h = NoisePerlin2D(&noise_height->np, p.X, p.Y, seed);
 
-	// noise_height 'offset' is the average level of terrain. At least 50% of
-	// terrain will be below this.
-	// Raising the maximum spawn level above 'water_level + 16' is necessary
-	// for when noise_height 'offset' is set much higher than water_level.
-	s16 max_spawn_y = MYMAX(noise_height->np.offset, water_level + 16);
+	s16 max_spawn_y = getMaxSpawnLevel();
 
 	// Starting spawn search at max_spawn_y + 128 ensures 128 nodes of open
 	// space above spawn position. Avoids spawning in possibly sealed voids.
@@ -196,6 +202,19 @@ int MapgenV5::getSpawnLevelAtPoint(v2s16 p)
 }
 
 
+bool MapgenV5::getSpawnLevelAtGround(v2s16 p, s16 ground, int *level)
+{
+	if (ground < water_level || ground > getMaxSpawnLevel()) {
+		*level = MAX_MAP_GENERATION_LIMIT;  // Unsuitable spawn point
+		return true;
+	}
+
+	// + 2 because of biome 'dust' nodes, as above
+	*level = ground + 2;
+	return true;
+}
+
+
 void MapgenV5::makeChunk(BlockMakeData *data)
 {
 	// Pre-conditions
@@ -283,12 +302,15 @@ void MapgenV5::makeChunk(BlockMakeData *data)
 
 int MapgenV5::generateBaseTerrain()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: terrain", SPT_ADD);
+
 	u32 index = 0;
 	u32 index2d = 0;
 	int stone_surface_max_y = -MAX_MAP_GENERATION_LIMIT;
 
-	noise_factor->perlinMap2D(node_min.X, node_min.Z);
-	noise_height->perlinMap2D(node_min.X, node_min.Z);
+	v2s16 pos2d(node_min.X, node_min.Z);
+	noise2d_cache.perlinMap2D(noise_factor, pos2d);
+	noise2d_cache.perlinMap2D(noise_height, pos2d);
 	noise_ground->perlinMap3D(node_min.X, node_min.Y - 1, node_min.Z);
 
 	for (s16 z=node_min.Z; z<=node_max.Z; z++) {
@@ -71,6 +71,8 @@ class MapgenV5 : public MapgenBasic
 
 	virtual void makeChunk(BlockMakeData *data);
 	int getSpawnLevelAtPoint(v2s16 p);
+	bool getSpawnLevelAtGround(v2s16 p, s16 ground, int *level);
+	s16 getMaxSpawnLevel();
 	int generateBaseTerrain();
 
 private:
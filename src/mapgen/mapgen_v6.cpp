@@ -29,7 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "map.h"
 #include "nodedef.h"
 #include "voxelalgorithms.h"
-//#include "profiler.h" // For TimeTaker
+#include "profiler.h"
 #include "settings.h" // For g_settings
 #include "emerge.h"
 #include "dungeongen.h"
@@ -358,6 +358,16 @@ int MapgenV6::getSpawnLevelAtPoint(v2s16 p)
 }
 
 
+bool MapgenV6::getSpawnLevelAtGround(v2s16 p, s16 ground, int *level)
+{
+	if (ground <= water_level || ground > water_level + 16)
+		*level = MAX_MAP_GENERATION_LIMIT;  // Unsuitable spawn point
+	else
+		*level = ground;
+	return true;
+}
+
+
 //////////////////////// Noise functions
 
 
@@ -562,6 +572,8 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 	// Add dungeons
 	if ((flags & MG_DUNGEONS) && stone_surface_max_y >= node_min.Y &&
 			full_node_min.Y >= dungeon_ymin && full_node_max.Y <= dungeon_ymax) {
+		ScopeProfiler sp(g_profiler, "Mapgen: dungeons", SPT_ADD);
+
 		u16 num_dungeons = std::fmax(std::floor(
 			NoisePerlin3D(&np_dungeons, node_min.X, node_min.Y, node_min.Z, seed)), 0.0f);
 
@@ -642,6 +654,8 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 
 void MapgenV6::calculateNoise()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: terrain", SPT_ADD);
+
 	int x = node_min.X;
 	int z = node_min.Z;
 	int fx = full_node_min.X;
@@ -666,6 +680,8 @@ void MapgenV6::calculateNoise()
 
 int MapgenV6::generateGround()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: terrain", SPT_ADD);
+
 	//TimeTaker timer1("Generating ground level");
 	MapNode n_air(CONTENT_AIR), n_water_source(c_water_source);
 	MapNode n_stone(c_stone), n_desert_stone(c_desert_stone);
@@ -925,6 +941,8 @@ void MapgenV6::moveMud(u32 remove_index, u32 place_index,
 
 void MapgenV6::placeTreesAndJungleGrass()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: decorations", SPT_ADD);
+
 	//TimeTaker t("placeTrees");
 	if (node_max.Y < water_level)
 		return;
@@ -1039,6 +1057,8 @@ void MapgenV6::placeTreesAndJungleGrass()
 
 void MapgenV6::growGrass() // Add surface nodes
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: biomes", SPT_ADD);
+
 	MapNode n_dirt_with_grass(c_dirt_with_grass);
 	MapNode n_dirt_with_snow(c_dirt_with_snow);
 	MapNode n_snowblock(c_snowblock);
@@ -1090,6 +1110,8 @@ void MapgenV6::growGrass() // Add surface nodes
 
 void MapgenV6::generateCaves(int max_stone_y)
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: caves", SPT_ADD);
+
 	float cave_amount = NoisePerlin2D(np_cave, node_min.X, node_min.Y, seed);
 	int volume_nodes = (node_max.X - node_min.X + 1) *
 					   (node_max.Y - node_min.Y + 1) * MAP_BLOCKSIZE;
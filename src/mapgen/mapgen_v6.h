@@ -141,6 +141,7 @@ class MapgenV6 : public Mapgen {
 	void makeChunk(BlockMakeData *data);
 	int getGroundLevelAtPoint(v2s16 p);
 	int getSpawnLevelAtPoint(v2s16 p);
+	bool getSpawnLevelAtGround(v2s16 p, s16 ground, int *level);
 
 	float baseTerrainLevel(float terrain_base, float terrain_higher,
 		float steepness, float height_select);
@@ -28,7 +28,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "map.h"
 #include "nodedef.h"
 #include "voxelalgorithms.h"
-//#include "profiler.h" // For TimeTaker
+#include "profiler.h"
 #include "settings.h" // For g_settings
 #include "emerge.h"
 #include "dungeongen.h"
@@ -261,25 +261,38 @@ void MapgenV7Params::setDefaultSettings(Settings *settings)
 ////////////////////////////////////////////////////////////////////////////////
 
 
-int MapgenV7::getSpawnLevelAtPoint(v2s16 p)
+bool MapgenV7::isRiverAtPoint(v2s16 p)
 {
-	// If rivers are enabled, first check if in a river
-	if (spflags & MGV7_RIDGES) {
-		float width = 0.2f;
-		float uwatern = NoisePerlin2D(&noise_ridge_uwater->np, p.X, p.Y, seed) *
-			2.0f;
-		if (std::fabs(uwatern) <= width)
-			return MAX_MAP_GENERATION_LIMIT; // Unsuitable spawn point
-	}
+	if (!(spflags & MGV7_RIDGES))
+		return false;
 
+	float width = 0.2f;
+	float uwatern = NoisePerlin2D(&noise_ridge_uwater->np, p.X, p.Y, seed) *
+		2.0f;
+	return std::fabs(uwatern) <= width;
+}
+
+
+s16 MapgenV7::getMaxSpawnLevel()
+{
 	// Terrain noise 'offset' is the average level of that terrain.
 	// At least 50% of terrain will be below the higher of base and alt terrain
 	// 'offset's.
 	// Raising the maximum spawn level above 'water_level + 16' is necessary
 	// for when terrain 'offset's are set much higher than water_level.
-	s16 max_spawn_y = std::fmax(std::fmax(noise_terrain_alt->np.offset,
+	return std::fmax(std::fmax(noise_terrain_alt->np.offset,
 			noise_terrain_base->np.offset),
 			water_level + 16);
+}
+
+
+int MapgenV7::getSpawnLevelAtPoint(v2s16 p)
+{
+	// If rivers are enabled, first check if in a river
+	if (isRiverAtPoint(p))
+		return MAX_MAP_GENERATION_LIMIT; // Unsuitable spawn point
+
+	s16 max_spawn_y = getMaxSpawnLevel();
 	// Base terrain calculation
 	s16 y = baseTerrainLevelAtPoint(p.X, p.Y);
 
@@ -312,6 +325,21 @@ int MapgenV7::getSpawnLevelAtPoint(v2s16 p)
 }
 
 
+bool MapgenV7::getSpawnLevelAtGround(v2s16 p, s16 ground, int *level)
+{
+	if (isRiverAtPoint(p) || ground > getMaxSpawnLevel() ||
+			ground < water_level ||
+			(ground == water_level && (spflags & MGV7_MOUNTAINS))) {
+		*level = MAX_MAP_GENERATION_LIMIT; // Unsuitable spawn point
+		return true;
+	}
+
+	// As above, mountain surfaces only get + 1
+	*level = ground + ((spflags & MGV7_MOUNTAINS) ? 1 : 2);
+	return true;
+}
+
+
 void MapgenV7::makeChunk(BlockMakeData *data)
 {
 	// Pre-conditions
@@ -482,20 +510,22 @@ bool MapgenV7::getFloatlandTerrainFromMap(int idx_xyz, float float_offset)
 
 int MapgenV7::generateTerrain()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: terrain", SPT_ADD);
+
 	MapNode n_air(CONTENT_AIR);
 	MapNode n_stone(c_stone);
 	MapNode n_water(c_water_source);
 
 	//// Calculate noise for terrain generation
-	noise_terrain_persist->perlinMap2D(node_min.X, node_min.Z);
-	float *persistmap = noise_terrain_persist->result;
+	v2s16 pos2d(node_min.X, node_min.Z);
+	float *persistmap = noise2d_cache.perlinMap2D(noise_terrain_persist, pos2d);
 
-	noise_terrain_base->perlinMap2D(node_min.X, node_min.Z, persistmap);
-	noise_terrain_alt->perlinMap2D(node_min.X, node_min.Z, persistmap);
-	noise_height_select->perlinMap2D(node_min.X, node_min.Z);
+	noise2d_cache.perlinMap2D(noise_terrain_base, pos2d, persistmap);
+	noise2d_cache.perlinMap2D(noise_terrain_alt, pos2d, persistmap);
+	noise2d_cache.perlinMap2D(noise_height_select, pos2d);
 
 	if (spflags & MGV7_MOUNTAINS) {
-		noise_mount_height->perlinMap2D(node_min.X, node_min.Z);
+		noise2d_cache.perlinMap2D(noise_mount_height, pos2d);
 		noise_mountain->perlinMap3D(node_min.X, node_min.Y - 1, node_min.Z);
 	}
 
@@ -534,7 +564,7 @@ int MapgenV7::generateTerrain()
 		!gen_floatlands;
 	if (gen_rivers) {
 		noise_ridge->perlinMap3D(node_min.X, node_min.Y - 1, node_min.Z);
-		noise_ridge_uwater->perlinMap2D(node_min.X, node_min.Z);
+		noise2d_cache.perlinMap2D(noise_ridge_uwater, pos2d);
 	}
 
 	//// Place nodes
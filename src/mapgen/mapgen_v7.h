@@ -89,8 +89,11 @@ class MapgenV7 : public MapgenBasic {
 
 	virtual void makeChunk(BlockMakeData *data);
 	int getSpawnLevelAtPoint(v2s16 p);
+	bool getSpawnLevelAtGround(v2s16 p, s16 ground, int *level);
 
 	float baseTerrainLevelAtPoint(s16 x, s16 z);
+	bool isRiverAtPoint(v2s16 p);
+	s16 getMaxSpawnLevel();
 	float baseTerrainLevelFromMap(int index);
 	bool getMountainTerrainAtPoint(s16 x, s16 y, s16 z);
 	bool getMountainTerrainFromMap(int idx_xyz, int idx_xz, s16 y);
@@ -33,7 +33,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "map.h"
 #include "nodedef.h"
 #include "voxelalgorithms.h"
-//#include "profiler.h" // For TimeTaker
+#include "profiler.h"
 #include "settings.h" // For g_settings
 #include "emerge.h"
 #include "dungeongen.h"
@@ -290,6 +290,17 @@ void MapgenValleys::makeChunk(BlockMakeData *data)
 }
 
 
+s16 MapgenValleys::getMaxSpawnLevel()
+{
+	// Raising the maximum spawn level above 'water_level + 16' is necessary for custom
+	// parameters that set average terrain level much higher than water_level.
+	return std::fmax(
+		noise_terrain_height->np.offset +
+		noise_valley_depth->np.offset * noise_valley_depth->np.offset,
+		water_level + 16);
+}
+
+
 int MapgenValleys::getSpawnLevelAtPoint(v2s16 p)
 {
 	// Check if in a river channel
@@ -312,12 +323,7 @@ int MapgenValleys::getSpawnLevelAtPoint(v2s16 p)
 	float slope = n_slope * valley_h;
 	float river_y = base - 1.0f;
 
-	// Raising the maximum spawn level above 'water_level + 16' is necessary for custom
-	// parameters that set average terrain level much higher than water_level.
-	s16 max_spawn_y = std::fmax(
-		noise_terrain_height->np.offset +
-		noise_valley_depth->np.offset * noise_valley_depth->np.offset,
-		water_level + 16);
+	s16 max_spawn_y = getMaxSpawnLevel();
 
 	// Starting spawn search at max_spawn_y + 128 ensures 128 nodes of open
 	// space above spawn position. Avoids spawning in possibly sealed voids.
@@ -342,18 +348,41 @@ int MapgenValleys::getSpawnLevelAtPoint(v2s16 p)
 }
 
 
+bool MapgenValleys::getSpawnLevelAtGround(v2s16 p, s16 ground, int *level)
+{
+	// Same checks as above, the river water level needs some of the noise
+	float n_rivers = NoisePerlin2D(&noise_rivers->np, p.X, p.Y, seed);
+	float n_terrain_height = NoisePerlin2D(&noise_terrain_height->np, p.X, p.Y, seed);
+	float n_valley = NoisePerlin2D(&noise_valley_depth->np, p.X, p.Y, seed);
+	float river_y = n_terrain_height + n_valley * n_valley - 1.0f;
+
+	if (std::fabs(n_rivers) <= river_size_factor || ground < water_level ||
+			ground > getMaxSpawnLevel() || ground < (s16)river_y) {
+		*level = MAX_MAP_GENERATION_LIMIT; // Unsuitable spawn point
+		return true;
+	}
+
+	// + 2 because of biome 'dust' nodes
+	*level = ground + 2;
+	return true;
+}
+
+
 int MapgenValleys::generateTerrain()
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: terrain", SPT_ADD);
+
 	MapNode n_air(CONTENT_AIR);
 	MapNode n_river_water(c_river_water_source);
 	MapNode n_stone(c_stone);
 	MapNode n_water(c_water_source);
 
-	noise_inter_valley_slope->perlinMap2D(node_min.X, node_min.Z);
-	noise_rivers->perlinMap2D(node_min.X, node_min.Z);
-	noise_terrain_height->perlinMap2D(node_min.X, node_min.Z);
-	noise_valley_depth->perlinMap2D(node_min.X, node_min.Z);
-	noise_valley_profile->perlinMap2D(node_min.X, node_min.Z);
+	v2s16 pos2d(node_min.X, node_min.Z);
+	noise2d_cache.perlinMap2D(noise_inter_valley_slope, pos2d);
+	noise2d_cache.perlinMap2D(noise_rivers, pos2d);
+	noise2d_cache.perlinMap2D(noise_terrain_height, pos2d);
+	noise2d_cache.perlinMap2D(noise_valley_depth, pos2d);
+	noise2d_cache.perlinMap2D(noise_valley_profile, pos2d);
 
 	noise_inter_valley_fill->perlinMap3D(node_min.X, node_min.Y - 1, node_min.Z);
 
@@ -91,6 +91,8 @@ class MapgenValleys : public MapgenBasic {
 
 	virtual void makeChunk(BlockMakeData *data);
 	int getSpawnLevelAtPoint(v2s16 p);
+	bool getSpawnLevelAtGround(v2s16 p, s16 ground, int *level);
+	s16 getMaxSpawnLevel();
 
 private:
 	BiomeGenOriginal *m_bgen;
@@ -27,6 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/numeric.h"
 #include "porting.h"
 #include "settings.h"
+#include "profiler.h"
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -184,8 +185,15 @@ Biome *BiomeGenOriginal::calcBiomeAtPoint(v3s16 pos) const
 
 void BiomeGenOriginal::calcBiomeNoise(v3s16 pmin)
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: biomes", SPT_ADD);
+
 	m_pmin = pmin;
 
+	v2s16 pos(pmin.X, pmin.Z);
+	if (m_noise_cache.get(noise_heat, pos) &&
+			m_noise_cache.get(noise_humidity, pos))
+		return;
+
 	noise_heat->perlinMap2D(pmin.X, pmin.Z);
 	noise_humidity->perlinMap2D(pmin.X, pmin.Z);
 	noise_heat_blend->perlinMap2D(pmin.X, pmin.Z);
@@ -195,6 +203,9 @@ void BiomeGenOriginal::calcBiomeNoise(v3s16 pmin)
 		noise_heat->result[i]     += noise_heat_blend->result[i];
 		noise_humidity->result[i] += noise_humidity_blend->result[i];
 	}
+
+	m_noise_cache.put(noise_heat, pos);
+	m_noise_cache.put(noise_humidity, pos);
 }
 
 
@@ -197,6 +197,9 @@ class BiomeGenOriginal : public BiomeGen {
 	Noise *noise_humidity;
 	Noise *noise_heat_blend;
 	Noise *noise_humidity_blend;
+
+	// Blended heat and humidity of the recently generated mapchunk columns
+	Noise2DCache m_noise_cache;
 };
 
 
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "noise.h"
 #include "map.h"
 #include "log.h"
+#include "profiler.h"
 #include "util/numeric.h"
 #include <algorithm>
 #include <vector>
@@ -53,14 +54,17 @@ DecorationManager::DecorationManager(IGameDef *gamedef) :
 size_t DecorationManager::placeAllDecos(Mapgen *mg, u32 blockseed,
 	v3s16 nmin, v3s16 nmax)
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: decorations", SPT_ADD);
+
 	size_t nplaced = 0;
+	m_surfaces.reset(mg, nmin, nmax);
 
 	for (size_t i = 0; i != m_objects.size(); i++) {
 		Decoration *deco = (Decoration *)m_objects[i];
 		if (!deco)
 			continue;
 
-		nplaced += deco->placeDeco(mg, blockseed, nmin, nmax);
+		nplaced += deco->placeDeco(mg, blockseed, nmin, nmax, &m_surfaces);
 		blockseed++;
 	}
 
@@ -78,6 +82,73 @@ DecorationManager *DecorationManager::clone() const
 ///////////////////////////////////////////////////////////////////////////////
 
 
+void DecoSurfaceTable::reset(Mapgen *mg, v3s16 nmin, v3s16 nmax)
+{
+	m_mg = mg;
+	m_nmin = nmin;
+	m_nmax = nmax;
+	m_csize_x = nmax.X - nmin.X + 1;
+
+	m_columns.resize(m_csize_x * (nmax.Z - nmin.Z + 1));
+	for (Column &column : m_columns)
+		column.valid = 0;
+}
+
+
+s16 DecoSurfaceTable::getGroundLevel(v2s16 p2d)
+{
+	Column &column = getColumn(p2d);
+	if (!(column.valid & COLUMN_GROUND)) {
+		column.ground_level = m_mg->findGroundLevel(p2d, m_nmin.Y, m_nmax.Y);
+		column.valid |= COLUMN_GROUND;
+	}
+	return column.ground_level;
+}
+
+
+s16 DecoSurfaceTable::getLiquidSurface(v2s16 p2d)
+{
+	Column &column = getColumn(p2d);
+	if (!(column.valid & COLUMN_LIQUID)) {
+		column.liquid_surface = m_mg->findLiquidSurface(p2d, m_nmin.Y, m_nmax.Y);
+		column.valid |= COLUMN_LIQUID;
+	}
+	return column.liquid_surface;
+}
+
+
+void DecoSurfaceTable::getSurfaces(v2s16 p2d, const std::vector<s16> **floors,
+	const std::vector<s16> **ceilings)
+{
+	Column &column = getColumn(p2d);
+	if (!(column.valid & COLUMN_SURFACES)) {
+		column.floors.clear();
+		column.ceilings.clear();
+		m_mg->getSurfaces(p2d, m_nmin.Y, m_nmax.Y,
+			column.floors, column.ceilings);
+		column.valid |= COLUMN_SURFACES;
+	}
+	*floors = &column.floors;
+	*ceilings = &column.ceilings;
+}
+
+
+void DecoSurfaceTable::invalidate(v2s16 pmin, v2s16 pmax)
+{
+	s16 x_min = MYMAX(pmin.X, m_nmin.X);
+	s16 x_max = MYMIN(pmax.X, m_nmax.X);
+	s16 z_min = MYMAX(pmin.Y, m_nmin.Z);
+	s16 z_max = MYMIN(pmax.Y, m_nmax.Z);
+
+	for (s16 z = z_min; z <= z_max; z++)
+	for (s16 x = x_min; x <= x_max; x++)
+		getColumn(v2s16(x, z)).valid = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
 void Decoration::resolveNodeNames()
 {
 	getIdsFromNrBacklog(&c_place_on);
@@ -134,9 +205,11 @@ bool Decoration::canPlaceDecoration(MMVManip *vm, v3s16 p)
 }
 
 
-size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
+size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	DecoSurfaceTable *surfaces)
 {
 	PcgRandom ps(blockseed + 53);
+	s16 radius = getPlacementRadius();
 	int carea_size = nmax.X - nmin.X + 1;
 
 	// Divide area into parts
@@ -211,14 +284,16 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 						continue;
 				}
 
-				// Get all floors and ceilings in node column
-				u16 size = (nmax.Y - nmin.Y + 1) / 2;
+				// Get all floors and ceilings in node column.
+				// Copied: placing a decoration invalidates the table entry.
+				const std::vector<s16> *column_floors, *column_ceilings;
+				surfaces->getSurfaces(v2s16(x, z), &column_floors, &column_ceilings);
 				std::vector<s16> floors;
+				if (flags & DECO_ALL_FLOORS)
+					floors = *column_floors;
 				std::vector<s16> ceilings;
-				floors.reserve(size);
-				ceilings.reserve(size);
-
-				mg->getSurfaces(v2s16(x, z), nmin.Y, nmax.Y, floors, ceilings);
+				if (flags & DECO_ALL_CEILINGS)
+					ceilings = *column_ceilings;
 
 				if (flags & DECO_ALL_FLOORS) {
 					// Floor decorations
@@ -227,9 +302,13 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 							continue;
 
 						v3s16 pos(x, y, z);
-						if (generate(mg->vm, &ps, pos, false))
+						if (generate(mg->vm, &ps, pos, false)) {
+							surfaces->invalidate(
+								v2s16(x - radius, z - radius),
+								v2s16(x + radius, z + radius));
 							mg->gennotify.addEvent(
 									GENNOTIFY_DECORATION, pos, index);
+						}
 					}
 				}
 
@@ -240,19 +319,23 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 							continue;
 
 						v3s16 pos(x, y, z);
-						if (generate(mg->vm, &ps, pos, true))
+						if (generate(mg->vm, &ps, pos, true)) {
+							surfaces->invalidate(
+								v2s16(x - radius, z - radius),
+								v2s16(x + radius, z + radius));
 							mg->gennotify.addEvent(
 									GENNOTIFY_DECORATION, pos, index);
+						}
 					}
 				}
 			} else { // Heightmap decorations
 				s16 y = -MAX_MAP_GENERATION_LIMIT;
 				if (flags & DECO_LIQUID_SURFACE)
-					y = mg->findLiquidSurface(v2s16(x, z), nmin.Y, nmax.Y);
+					y = surfaces->getLiquidSurface(v2s16(x, z));
 				else if (mg->heightmap)
 					y = mg->heightmap[mapindex];
 				else
-					y = mg->findGroundLevel(v2s16(x, z), nmin.Y, nmax.Y);
+					y = surfaces->getGroundLevel(v2s16(x, z));
 
 				if (y < y_min || y > y_max || y < nmin.Y || y > nmax.Y)
 					continue;
@@ -264,8 +347,11 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 				}
 
 				v3s16 pos(x, y, z);
-				if (generate(mg->vm, &ps, pos, false))
+				if (generate(mg->vm, &ps, pos, false)) {
+					surfaces->invalidate(v2s16(x - radius, z - radius),
+						v2s16(x + radius, z + radius));
 					mg->gennotify.addEvent(GENNOTIFY_DECORATION, pos, index);
+				}
 			}
 		}
 	}
@@ -414,6 +500,13 @@ ObjDef *DecoSchematic::clone() const
 }
 
 
+s16 DecoSchematic::getPlacementRadius() const
+{
+	// Covers all rotations and centering flags
+	return schematic ? MYMAX(schematic->size.X, schematic->size.Z) : 0;
+}
+
+
 size_t DecoSchematic::generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling)
 {
 	// Schematic could have been unloaded but not the decoration
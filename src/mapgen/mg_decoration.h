@@ -50,6 +50,53 @@ enum DecorationType {
 extern FlagDesc flagdesc_deco[];
 
 
+/*
+	Surfaces of the node columns of a mapchunk, shared by all decorations
+	placed in it. A column is scanned on first use only.
+	Placing a decoration changes the surfaces: the columns it covers must be
+	invalidated, so that the results stay the same as scanning every time.
+*/
+class DecoSurfaceTable {
+public:
+	void reset(Mapgen *mg, v3s16 nmin, v3s16 nmax);
+
+	// See Mapgen::findGroundLevel, Mapgen::findLiquidSurface and
+	// Mapgen::getSurfaces, for the Y range of the mapchunk
+	s16 getGroundLevel(v2s16 p2d);
+	s16 getLiquidSurface(v2s16 p2d);
+	void getSurfaces(v2s16 p2d, const std::vector<s16> **floors,
+		const std::vector<s16> **ceilings);
+
+	void invalidate(v2s16 pmin, v2s16 pmax);
+
+private:
+	enum ColumnFlags : u8 {
+		COLUMN_GROUND   = 0x01,
+		COLUMN_LIQUID   = 0x02,
+		COLUMN_SURFACES = 0x04,
+	};
+
+	struct Column {
+		u8 valid = 0;
+		s16 ground_level;
+		s16 liquid_surface;
+		std::vector<s16> floors;
+		std::vector<s16> ceilings;
+	};
+
+	Column &getColumn(v2s16 p2d)
+	{
+		return m_columns[(p2d.Y - m_nmin.Z) * m_csize_x + (p2d.X - m_nmin.X)];
+	}
+
+	Mapgen *m_mg = nullptr;
+	v3s16 m_nmin;
+	v3s16 m_nmax;
+	s16 m_csize_x = 0;
+	std::vector<Column> m_columns;
+};
+
+
 class Decoration : public ObjDef, public NodeResolver {
 public:
 	Decoration() = default;
@@ -58,9 +105,13 @@ class Decoration : public ObjDef, public NodeResolver {
 	virtual void resolveNodeNames();
 
 	bool canPlaceDecoration(MMVManip *vm, v3s16 p);
-	size_t placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
+	size_t placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+		DecoSurfaceTable *surfaces);
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling) = 0;
+	// Horizontal distance from the placement position within which
+	// generate() may change nodes
+	virtual s16 getPlacementRadius() const { return 0; }
 
 	u32 flags = 0;
 	int mapseed = 0;
@@ -104,6 +155,7 @@ class DecoSchematic : public Decoration {
 	virtual ~DecoSchematic();
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling);
+	virtual s16 getPlacementRadius() const;
 
 	Rotation rotation;
 	Schematic *schematic = nullptr;
@@ -149,4 +201,7 @@ class DecorationManager : public ObjDefManager {
 
 private:
 	DecorationManager() {};
+
+	// Kept to reuse its memory, each emerge thread has its own manager
+	DecoSurfaceTable m_surfaces;
 };
@@ -23,7 +23,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "noise.h"
 #include "map.h"
 #include "log.h"
+#include "profiler.h"
+#include "settings.h"
+#include "debug.h"
+#include "threading/thread.h"
 #include "util/numeric.h"
+#include "util/string.h"
 #include <cmath>
 #include <algorithm>
 
@@ -39,23 +44,179 @@ FlagDesc flagdesc_ore[] = {
 ///////////////////////////////////////////////////////////////////////////////
 
 
+class OreThread : public Thread
+{
+public:
+	OreThread(OreManager *mgr, u16 id):
+		Thread("Ore" + itos(id)),
+		m_mgr(mgr)
+	{}
+
+	void runTasks()
+	{
+		m_work.post();
+	}
+
+	void stop()
+	{
+		Thread::stop();
+		m_work.post();
+	}
+
+	void *run();
+
+private:
+	OreManager *m_mgr;
+	Semaphore m_work;
+};
+
+void *OreThread::run()
+{
+	BEGIN_DEBUG_EXCEPTION_HANDLER
+
+	while (!stopRequested()) {
+		m_work.wait();
+		if (stopRequested())
+			break;
+
+		m_mgr->runCandidateTasks();
+		m_mgr->m_tasks_done.post();
+	}
+
+	END_DEBUG_EXCEPTION_HANDLER
+
+	return nullptr;
+}
+
+
+OreManager::OreManager() = default;
+
+
 OreManager::OreManager(IGameDef *gamedef) :
 	ObjDefManager(gamedef, OBJDEF_ORE)
 {
 }
 
 
+OreManager::~OreManager()
+{
+	stopThreads();
+}
+
+
+void OreManager::startThreads()
+{
+	m_threads_started = true;
+
+	// The emerge thread counts as one, with 1 the ores are generated inline
+	u16 nthreads = 1;
+	g_settings->getU16NoEx("num_ore_threads", nthreads);
+	for (u16 i = 1; i < nthreads; i++) {
+		m_threads.emplace_back(new OreThread(this, i));
+		m_threads.back()->start();
+	}
+}
+
+
+void OreManager::stopThreads()
+{
+	for (auto &thread : m_threads)
+		thread->stop();
+	for (auto &thread : m_threads)
+		thread->wait();
+	m_threads.clear();
+}
+
+
+void OreManager::runCandidateTasks()
+{
+	u32 i;
+	while ((i = m_next_task++) < m_tasks.size()) {
+		OreTask &task = m_tasks[i];
+		Ore *ore = (Ore *)m_objects[i];
+		if (!task.place)
+			continue;
+
+		task.candidates.clear();
+		task.has_candidates = ore->getCandidates(m_mapgen->vm,
+			task.read_content, m_mapgen->seed, task.blockseed,
+			task.nmin, task.nmax, m_mapgen->biomemap, task.candidates);
+	}
+}
+
+
 size_t OreManager::placeAllOres(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 {
+	ScopeProfiler sp(g_profiler, "Mapgen: ores", SPT_ADD);
+
+	if (!m_threads_started)
+		startThreads();
+
 	size_t nplaced = 0;
 
+	if (m_threads.empty()) {
+		for (size_t i = 0; i != m_objects.size(); i++) {
+			Ore *ore = (Ore *)m_objects[i];
+			if (!ore)
+				continue;
+
+			nplaced += ore->placeOre(mg, blockseed, nmin, nmax);
+			blockseed++;
+		}
+
+		return nplaced;
+	}
+
+	// Collect the candidates of all ores in parallel, then place them one
+	// ore after the other as above. This gives the same result as long as the
+	// content is only read at placement: ores that have to read it earlier
+	// may only do so if no previous ore places a node they are placed in.
+	m_tasks.resize(m_objects.size());
+	std::unordered_set<content_t> c_placed;
 	for (size_t i = 0; i != m_objects.size(); i++) {
 		Ore *ore = (Ore *)m_objects[i];
+		OreTask &task = m_tasks[i];
+		task.place = false;
 		if (!ore)
 			continue;
 
-		nplaced += ore->placeOre(mg, blockseed, nmin, nmax);
-		blockseed++;
+		task.blockseed = blockseed++;
+		task.nmin = nmin;
+		task.nmax = nmax;
+		task.place = ore->clampToRange(task.nmin, task.nmax);
+		if (!task.place)
+			continue;
+
+		task.read_content = true;
+		for (content_t c : ore->c_wherein) {
+			if (c_placed.count(c)) {
+				task.read_content = false;
+				break;
+			}
+		}
+		c_placed.insert(ore->c_ore);
+	}
+
+	m_mapgen = mg;
+	m_next_task = 0;
+	for (auto &thread : m_threads)
+		thread->runTasks();
+	runCandidateTasks();
+	for (size_t i = 0; i != m_threads.size(); i++)
+		m_tasks_done.wait();
+
+	for (size_t i = 0; i != m_objects.size(); i++) {
+		Ore *ore = (Ore *)m_objects[i];
+		const OreTask &task = m_tasks[i];
+		if (!task.place)
+			continue;
+
+		if (task.has_candidates)
+			ore->placeCandidates(mg->vm, task.candidates);
+		else
+			ore->generate(mg->vm, mg->seed, task.blockseed, task.nmin,
+				task.nmax, mg->biomemap);
+		nplaced++;
 	}
 
 	return nplaced;
@@ -96,24 +257,58 @@ void Ore::resolveNodeNames()
 }
 
 
-size_t Ore::placeOre(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
+bool Ore::clampToRange(v3s16 &nmin, v3s16 &nmax) const
 {
 	if (nmin.Y > y_max || nmax.Y < y_min)
-		return 0;
+		return false;
 
 	int actual_ymin = MYMAX(nmin.Y, y_min);
 	int actual_ymax = MYMIN(nmax.Y, y_max);
 	if (clust_size >= actual_ymax - actual_ymin + 1)
-		return 0;
+		return false;
 
 	nmin.Y = actual_ymin;
 	nmax.Y = actual_ymax;
+	return true;
+}
+
+
+size_t Ore::placeOre(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
+{
+	if (!clampToRange(nmin, nmax))
+		return 0;
+
 	generate(mg->vm, mg->seed, blockseed, nmin, nmax, mg->biomemap);
 
 	return 1;
 }
 
 
+void Ore::generate(MMVManip *vm, int mapseed, u32 blockseed,
+	v3s16 nmin, v3s16 nmax, biome_t *biomemap)
+{
+	// Placing the ore itself can't create more nodes to place it in
+	std::vector<u32> candidates;
+	bool ok = getCandidates(vm, true, mapseed, blockseed, nmin, nmax,
+		biomemap, candidates);
+	sanity_check(ok);
+	placeCandidates(vm, candidates);
+}
+
+
+void Ore::placeCandidates(MMVManip *vm, const std::vector<u32> &candidates)
+{
+	MapNode n_ore(c_ore, 0, ore_param2);
+
+	for (u32 i : candidates) {
+		if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
+			continue;
+
+		vm->m_data[i] = n_ore;
+	}
+}
+
+
 void Ore::cloneTo(Ore *def) const
 {
 	ObjDef::cloneTo(def);
@@ -145,11 +340,11 @@ ObjDef *OreScatter::clone() const
 }
 
 
-void OreScatter::generate(MMVManip *vm, int mapseed, u32 blockseed,
-	v3s16 nmin, v3s16 nmax, biome_t *biomemap)
+bool OreScatter::getCandidates(const MMVManip *vm, bool read_content,
+	int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	biome_t *biomemap, std::vector<u32> &candidates)
 {
 	PcgRandom pr(blockseed);
-	MapNode n_ore(c_ore, 0, ore_param2);
 
 	u32 sizex  = (nmax.X - nmin.X + 1);
 	u32 volume = (nmax.X - nmin.X + 1) *
@@ -181,13 +376,11 @@ void OreScatter::generate(MMVManip *vm, int mapseed, u32 blockseed,
 			if (pr.range(1, cvolume) > clust_num_ores)
 				continue;
 
-			u32 i = vm->m_area.index(x0 + x1, y0 + y1, z0 + z1);
-			if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
-				continue;
-
-			vm->m_data[i] = n_ore;
+			candidates.push_back(vm->m_area.index(x0 + x1, y0 + y1, z0 + z1));
 		}
 	}
+
+	return true;
 }
 
 
@@ -207,11 +400,11 @@ ObjDef *OreSheet::clone() const
 }
 
 
-void OreSheet::generate(MMVManip *vm, int mapseed, u32 blockseed,
-	v3s16 nmin, v3s16 nmax, biome_t *biomemap)
+bool OreSheet::getCandidates(const MMVManip *vm, bool read_content,
+	int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	biome_t *biomemap, std::vector<u32> &candidates)
 {
 	PcgRandom pr(blockseed + 4234);
-	MapNode n_ore(c_ore, 0, ore_param2);
 
 	u16 max_height = column_height_max;
 	int y_start_min = nmin.Y + max_height;
@@ -249,14 +442,12 @@ void OreSheet::generate(MMVManip *vm, int mapseed, u32 blockseed,
 
 		for (int y = y0; y <= y1; y++) {
 			u32 i = vm->m_area.index(x, y, z);
-			if (!vm->m_area.contains(i))
-				continue;
-			if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
-				continue;
-
-			vm->m_data[i] = n_ore;
+			if (vm->m_area.contains(i))
+				candidates.push_back(i);
 		}
 	}
+
+	return true;
 }
 
 
@@ -284,11 +475,11 @@ ObjDef *OrePuff::clone() const
 }
 
 
-void OrePuff::generate(MMVManip *vm, int mapseed, u32 blockseed,
-	v3s16 nmin, v3s16 nmax, biome_t *biomemap)
+bool OrePuff::getCandidates(const MMVManip *vm, bool read_content,
+	int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	biome_t *biomemap, std::vector<u32> &candidates)
 {
 	PcgRandom pr(blockseed + 4234);
-	MapNode n_ore(c_ore, 0, ore_param2);
 
 	int y_start = pr.range(nmin.Y, nmax.Y);
 
@@ -343,14 +534,12 @@ void OrePuff::generate(MMVManip *vm, int mapseed, u32 blockseed,
 
 		for (int y = y0; y <= y1; y++) {
 			u32 i = vm->m_area.index(x, y, z);
-			if (!vm->m_area.contains(i))
-				continue;
-			if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
-				continue;
-
-			vm->m_data[i] = n_ore;
+			if (vm->m_area.contains(i))
+				candidates.push_back(i);
 		}
 	}
+
+	return true;
 }
 
 
@@ -365,11 +554,11 @@ ObjDef *OreBlob::clone() const
 }
 
 
-void OreBlob::generate(MMVManip *vm, int mapseed, u32 blockseed,
-	v3s16 nmin, v3s16 nmax, biome_t *biomemap)
+bool OreBlob::getCandidates(const MMVManip *vm, bool read_content,
+	int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	biome_t *biomemap, std::vector<u32> &candidates)
 {
 	PcgRandom pr(blockseed + 2404);
-	MapNode n_ore(c_ore, 0, ore_param2);
 
 	u32 sizex  = (nmax.X - nmin.X + 1);
 	u32 volume = (nmax.X - nmin.X + 1) *
@@ -401,7 +590,8 @@ void OreBlob::generate(MMVManip *vm, int mapseed, u32 blockseed,
 		for (u32 y1 = 0; y1 != csize; y1++)
 		for (u32 x1 = 0; x1 != csize; x1++, index++) {
 			u32 i = vm->m_area.index(x0 + x1, y0 + y1, z0 + z1);
-			if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
+			if (read_content &&
+					!CONTAINS(c_wherein, vm->m_data[i].getContent()))
 				continue;
 
 			// Lazily generate noise only if there's a chance of ore being placed
@@ -422,9 +612,11 @@ void OreBlob::generate(MMVManip *vm, int mapseed, u32 blockseed,
 			if (noiseval < nthresh)
 				continue;
 
-			vm->m_data[i] = n_ore;
+			candidates.push_back(i);
 		}
 	}
+
+	return true;
 }
 
 
@@ -535,11 +727,11 @@ ObjDef *OreStratum::clone() const
 }
 
 
-void OreStratum::generate(MMVManip *vm, int mapseed, u32 blockseed,
-	v3s16 nmin, v3s16 nmax, biome_t *biomemap)
+bool OreStratum::getCandidates(const MMVManip *vm, bool read_content,
+	int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	biome_t *biomemap, std::vector<u32> &candidates)
 {
 	PcgRandom pr(blockseed + 4234);
-	MapNode n_ore(c_ore, 0, ore_param2);
 
 	if (flags & OREFLAG_USE_NOISE) {
 		if (!noise) {
@@ -589,12 +781,10 @@ void OreStratum::generate(MMVManip *vm, int mapseed, u32 blockseed,
 				continue;
 
 			u32 i = vm->m_area.index(x, y, z);
-			if (!vm->m_area.contains(i))
-				continue;
-			if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
-				continue;
-
-			vm->m_data[i] = n_ore;
+			if (vm->m_area.contains(i))
+				candidates.push_back(i);
 		}
 	}
+
+	return true;
 }
@@ -20,16 +20,21 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <unordered_set>
+#include <vector>
 #include "objdef.h"
 #include "noise.h"
 #include "nodedef.h"
+#include "threading/semaphore.h"
 
 typedef u16 biome_t;  // copy from mg_biome.h to avoid an unnecessary include
 
 class Noise;
 class Mapgen;
 class MMVManip;
+class OreThread;
 
 /////////////////// Ore generation flags
 
@@ -73,9 +78,28 @@ class Ore : public ObjDef, public NodeResolver {
 
 	virtual void resolveNodeNames();
 
+	// Limits the area to the Y range of the ore.
+	// Returns false if the ore is not placed in it.
+	bool clampToRange(v3s16 &nmin, v3s16 &nmax) const;
 	size_t placeOre(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
 	virtual void generate(MMVManip *vm, int mapseed, u32 blockseed,
-		v3s16 nmin, v3s16 nmax, biome_t *biomemap) = 0;
+		v3s16 nmin, v3s16 nmax, biome_t *biomemap);
+
+	/*
+		Collects the VoxelManip indices at which the ore is placed if the node
+		there is one of c_wherein, in placement order. Does not modify vm and
+		only reads its content if read_content is set, to skip work; it is not
+		set if other ores may change the content before these are placed.
+		Returns false if the ore does not support this, generate() must be
+		used instead.
+	*/
+	virtual bool getCandidates(const MMVManip *vm, bool read_content,
+		int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+		biome_t *biomemap, std::vector<u32> &candidates)
+	{
+		return false;
+	}
+	void placeCandidates(MMVManip *vm, const std::vector<u32> &candidates);
 
 protected:
 	void cloneTo(Ore *def) const;
@@ -87,8 +111,9 @@ class OreScatter : public Ore {
 
 	ObjDef *clone() const override;
 
-	void generate(MMVManip *vm, int mapseed, u32 blockseed,
-			v3s16 nmin, v3s16 nmax, biome_t *biomemap) override;
+	bool getCandidates(const MMVManip *vm, bool read_content,
+			int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+			biome_t *biomemap, std::vector<u32> &candidates) override;
 };
 
 class OreSheet : public Ore {
@@ -101,8 +126,9 @@ class OreSheet : public Ore {
 	u16 column_height_max;
 	float column_midpoint_factor;
 
-	void generate(MMVManip *vm, int mapseed, u32 blockseed,
-			v3s16 nmin, v3s16 nmax, biome_t *biomemap) override;
+	bool getCandidates(const MMVManip *vm, bool read_content,
+			int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+			biome_t *biomemap, std::vector<u32> &candidates) override;
 };
 
 class OrePuff : public Ore {
@@ -117,8 +143,9 @@ class OrePuff : public Ore {
 	OrePuff() : Ore(true) {}
 	virtual ~OrePuff();
 
-	void generate(MMVManip *vm, int mapseed, u32 blockseed,
-			v3s16 nmin, v3s16 nmax, biome_t *biomemap) override;
+	bool getCandidates(const MMVManip *vm, bool read_content,
+			int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+			biome_t *biomemap, std::vector<u32> &candidates) override;
 };
 
 class OreBlob : public Ore {
@@ -126,8 +153,9 @@ class OreBlob : public Ore {
 	ObjDef *clone() const override;
 
 	OreBlob() : Ore(true) {}
-	void generate(MMVManip *vm, int mapseed, u32 blockseed,
-			v3s16 nmin, v3s16 nmax, biome_t *biomemap) override;
+	bool getCandidates(const MMVManip *vm, bool read_content,
+			int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+			biome_t *biomemap, std::vector<u32> &candidates) override;
 };
 
 class OreVein : public Ore {
@@ -141,6 +169,8 @@ class OreVein : public Ore {
 	OreVein() : Ore(true) {}
 	virtual ~OreVein();
 
+	// Draws a random number for every node it may be placed in,
+	// so it has to see the content left by the previous ores
 	void generate(MMVManip *vm, int mapseed, u32 blockseed,
 			v3s16 nmin, v3s16 nmax, biome_t *biomemap) override;
 };
@@ -156,14 +186,15 @@ class OreStratum : public Ore {
 	OreStratum() : Ore(false) {}
 	virtual ~OreStratum();
 
-	void generate(MMVManip *vm, int mapseed, u32 blockseed,
-			v3s16 nmin, v3s16 nmax, biome_t *biomemap) override;
+	bool getCandidates(const MMVManip *vm, bool read_content,
+			int mapseed, u32 blockseed, v3s16 nmin, v3s16 nmax,
+			biome_t *biomemap, std::vector<u32> &candidates) override;
 };
 
 class OreManager : public ObjDefManager {
 public:
 	OreManager(IGameDef *gamedef);
-	virtual ~OreManager() = default;
+	virtual ~OreManager();
 
 	OreManager *clone() const;
 
@@ -197,5 +228,35 @@ class OreManager : public ObjDefManager {
 	size_t placeAllOres(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
 
 private:
-	OreManager() {};
+	friend class OreThread;
+
+	OreManager();
+
+	void startThreads();
+	void stopThreads();
+	// Collects the candidates of the ores not taken by another thread yet
+	void runCandidateTasks();
+
+	// Threads helping the emerge thread to collect candidates, none unless
+	// num_ore_threads > 1. Started on first use.
+	std::vector<std::unique_ptr<OreThread>> m_threads;
+	bool m_threads_started = false;
+
+	// State of the current placeAllOres call, per ore
+	struct OreTask {
+		u32 blockseed;
+		v3s16 nmin;
+		v3s16 nmax;
+		// The ore is placed in this mapchunk
+		bool place;
+		// See Ore::getCandidates
+		bool read_content;
+		bool has_candidates;
+		std::vector<u32> candidates;
+	};
+	std::vector<OreTask> m_tasks;
+	Mapgen *m_mapgen = nullptr;
+	std::atomic<u32> m_next_task{0};
+	// Posted by the threads when they ran out of tasks
+	Semaphore m_tasks_done;
 };
@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <algorithm>
 #include <fstream>
 #include <typeinfo>
 #include "mg_schematic.h"
@@ -104,6 +105,7 @@ ObjDef *Schematic::clone() const
 
 void Schematic::resolveNodeNames()
 {
+	clearRotationCache();
 	c_nodes.clear();
 	getIdsFromNrBacklog(&c_nodes, true, CONTENT_AIR);
 
@@ -121,10 +123,19 @@ void Schematic::resolveNodeNames()
 }
 
 
-void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+void Schematic::clearRotationCache()
 {
-	assert(schemdata && slice_probs);
-	sanity_check(m_ndef != NULL);
+	for (auto &rotated : m_rotated)
+		rotated.reset();
+}
+
+
+const Schematic::RotatedSchematic &Schematic::getRotated(Rotation rot)
+{
+	assert(rot >= ROTATE_0 && rot <= ROTATE_270);
+	std::unique_ptr<RotatedSchematic> &cached = m_rotated[rot];
+	if (cached)
+		return *cached;
 
 	int xstride = 1;
 	int ystride = size.X;
@@ -159,44 +170,116 @@ void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_pla
 			i_step_z = zstride;
 	}
 
+	cached = std::make_unique<RotatedSchematic>();
+	RotatedSchematic &rs = *cached;
+	u32 nodecount = sx * sy * sz;
+	rs.size = v3s16(sx, sy, sz);
+	rs.nodes.resize(nodecount);
+	rs.param1.resize(nodecount);
+	rs.row_runs.reserve(sy * sz + 1);
+
+	u32 ri = 0;
+	for (s16 y = 0; y != sy; y++)
+	for (s16 z = 0; z != sz; z++) {
+		rs.row_runs.push_back(rs.runs.size());
+		SchematicRun *run = nullptr;
+
+		u32 i = z * i_step_z + y * ystride + i_start;
+		for (s16 x = 0; x != sx; x++, i += i_step_x, ri++) {
+			MapNode n = schemdata[i];
+			u8 placement_prob = n.param1 & MTSCHEM_PROB_MASK;
+			rs.param1[ri] = n.param1;
+
+			n.param1 = 0;
+			if (rot)
+				n.rotateAlongYAxis(m_ndef, rot);
+			rs.nodes[ri] = n;
+
+			if (n.getContent() == CONTENT_IGNORE ||
+					placement_prob == MTSCHEM_PROB_NEVER) {
+				run = nullptr;
+				continue;
+			}
+
+			SchematicRunType type = RUN_RANDOM;
+			if (placement_prob == MTSCHEM_PROB_ALWAYS)
+				type = (rs.param1[ri] & MTSCHEM_FORCE_PLACE) ?
+					RUN_FORCE_PLACE : RUN_ALWAYS;
+
+			if (run && run->type == type) {
+				run->length++;
+			} else {
+				rs.runs.push_back({x, 1, type});
+				run = &rs.runs.back();
+			}
+		}
+	}
+	rs.row_runs.push_back(rs.runs.size());
+
+	return rs;
+}
+
+
+void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+{
+	assert(schemdata && slice_probs);
+	sanity_check(m_ndef != NULL);
+
+	const RotatedSchematic &rs = getRotated(rot);
+	const VoxelArea &area = vm->m_area;
+	if (area.hasEmptyExtent())
+		return;
+
 	s16 y_map = p.Y;
-	for (s16 y = 0; y != sy; y++) {
+	for (s16 y = 0; y != rs.size.Y; y++) {
 		if ((slice_probs[y] != MTSCHEM_PROB_ALWAYS) &&
 			(slice_probs[y] <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
 			continue;
 
-		for (s16 z = 0; z != sz; z++) {
-			u32 i = z * i_step_z + y * ystride + i_start;
-			for (s16 x = 0; x != sx; x++, i += i_step_x) {
-				v3s16 pos(p.X + x, y_map, p.Z + z);
-				if (!vm->m_area.contains(pos))
-					continue;
+		if (y_map < area.MinEdge.Y || y_map > area.MaxEdge.Y) {
+			y_map++;
+			continue;
+		}
 
-				if (schemdata[i].getContent() == CONTENT_IGNORE)
-					continue;
+		for (s16 z = 0; z != rs.size.Z; z++) {
+			s16 z_map = p.Z + z;
+			if (z_map < area.MinEdge.Z || z_map > area.MaxEdge.Z)
+				continue;
 
-				u8 placement_prob     = schemdata[i].param1 & MTSCHEM_PROB_MASK;
-				bool force_place_node = schemdata[i].param1 & MTSCHEM_FORCE_PLACE;
+			u32 row = y * rs.size.Z + z;
+			for (u32 r = rs.row_runs[row]; r != rs.row_runs[row + 1]; r++) {
+				const SchematicRun &run = rs.runs[r];
 
-				if (placement_prob == MTSCHEM_PROB_NEVER)
+				// Clip the run to the voxel area
+				s32 x_min = MYMAX(p.X + run.x, area.MinEdge.X);
+				s32 x_max = MYMIN(p.X + run.x + run.length - 1, area.MaxEdge.X);
+				if (x_min > x_max)
 					continue;
 
-				u32 vi = vm->m_area.index(pos);
-				if (!force_place && !force_place_node) {
-					content_t c = vm->m_data[vi].getContent();
-					if (c != CONTENT_AIR && c != CONTENT_IGNORE)
-						continue;
-				}
+				u32 count = x_max - x_min + 1;
+				u32 i = row * rs.size.X + (x_min - p.X);
+				u32 vi = area.index(x_min, y_map, z_map);
 
-				if ((placement_prob != MTSCHEM_PROB_ALWAYS) &&
-					(placement_prob <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
+				if (run.type == RUN_FORCE_PLACE ||
+						(run.type == RUN_ALWAYS && force_place)) {
+					std::copy(&rs.nodes[i], &rs.nodes[i] + count, &vm->m_data[vi]);
 					continue;
+				}
+
+				for (u32 k = 0; k != count; k++, i++, vi++) {
+					if (!force_place && !(rs.param1[i] & MTSCHEM_FORCE_PLACE)) {
+						content_t c = vm->m_data[vi].getContent();
+						if (c != CONTENT_AIR && c != CONTENT_IGNORE)
+							continue;
+					}
 
-				vm->m_data[vi] = schemdata[i];
-				vm->m_data[vi].param1 = 0;
+					u8 placement_prob = rs.param1[i] & MTSCHEM_PROB_MASK;
+					if ((placement_prob != MTSCHEM_PROB_ALWAYS) &&
+						(placement_prob <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
+						continue;
 
-				if (rot)
-					vm->m_data[vi].rotateAlongYAxis(m_ndef, rot);
+					vm->m_data[vi] = rs.nodes[i];
+				}
 			}
 		}
 		y_map++;
@@ -303,6 +386,7 @@ bool Schematic::deserializeFromMts(std::istream *is)
 	}
 
 	//// Read size
+	clearRotationCache();
 	size = readV3S16(ss);
 
 	//// Read Y-slice probability values
@@ -555,6 +639,7 @@ bool Schematic::getSchematicFromMap(Map *map, v3s16 p1, v3s16 p2)
 	v3s16 bp2 = getNodeBlockPos(p2);
 	vm->initialEmerge(bp1, bp2);
 
+	clearRotationCache();
 	size = p2 - p1 + 1;
 
 	slice_probs = new u8[size.Y];
@@ -586,6 +671,7 @@ void Schematic::applyProbabilities(v3s16 p0,
 	std::vector<std::pair<v3s16, u8> > *plist,
 	std::vector<std::pair<s16, u8> > *splist)
 {
+	clearRotationCache();
 	for (size_t i = 0; i != plist->size(); i++) {
 		v3s16 p = (*plist)[i].first - p0;
 		int index = p.Z * (size.Y * size.X) + p.Y * size.X + p.X;
@@ -21,6 +21,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <map>
+#include <memory>
+#include <vector>
 #include "mg_decoration.h"
 #include "util/string.h"
 
@@ -118,6 +120,10 @@ class Schematic : public ObjDef, public NodeResolver {
 		std::vector<std::pair<v3s16, u8> > *plist,
 		std::vector<std::pair<s16, u8> > *splist);
 
+	// Drops the rotated copies used by blitToVManip.
+	// Must be called after modifying schemdata of a resolved schematic.
+	void clearRotationCache();
+
 	std::vector<content_t> c_nodes;
 	u32 flags = 0;
 	v3s16 size;
@@ -125,8 +131,45 @@ class Schematic : public ObjDef, public NodeResolver {
 	u8 *slice_probs = nullptr;
 
 private:
+	enum SchematicRunType : u8 {
+		// Always placed, replacing anything
+		RUN_FORCE_PLACE,
+		// Always placed, only replacing air and ignore
+		RUN_ALWAYS,
+		// Placed with a per-node probability
+		RUN_RANDOM,
+	};
+
+	// Consecutive nodes of a row that are placed the same way
+	struct SchematicRun {
+		s16 x;
+		u16 length;
+		SchematicRunType type;
+	};
+
+	/*
+		Copy of the schematic in placement order for one rotation.
+		Nodes are stored X-first in rows of constant Y and Z (row = y * size.Z + z),
+		with param2 already rotated and param1 cleared. Nodes which are never
+		placed are not part of any run.
+	*/
+	struct RotatedSchematic {
+		v3s16 size;
+		std::vector<MapNode> nodes;
+		// Original param1: placement probability and force placement flag
+		std::vector<u8> param1;
+		std::vector<SchematicRun> runs;
+		// Runs of row r are runs[row_runs[r]] to runs[row_runs[r + 1] - 1]
+		std::vector<u32> row_runs;
+	};
+
+	const RotatedSchematic &getRotated(Rotation rot);
+
 	// Counterpart to the node resolver: Condense content_t to a sequential "m_nodenames" list
 	void condenseContentIds();
+
+	// Indexed by rotation, built on first use
+	std::unique_ptr<RotatedSchematic> m_rotated[ROTATE_270 + 1];
 };
 
 class SchematicManager : public ObjDefManager {
@@ -36,6 +36,9 @@ struct ToServerCommandHandler
     const std::string name;
     ToServerConnectionState state;
     void (Server::*handler)(NetworkPacket* pkt);
+    // The handler may run on a packet worker thread without the env lock.
+    // It must only touch the client interface (locked) and the connection.
+    bool concurrent = false;
 };
 
 struct ClientCommandFactory
@@ -311,10 +311,10 @@ void Server::handleCommand_Init2(NetworkPacket* pkt)
 		std::endl;
 
 	// Send item definitions
-	SendItemDef(peer_id, m_itemdef, protocol_version);
+	SendItemDef(peer_id, protocol_version);
 
 	// Send node definitions
-	SendNodeDef(peer_id, m_nodedef, protocol_version);
+	SendNodeDef(peer_id, protocol_version);
 
 	m_clients.event(peer_id, CSE_SetDefinitionsSent);
 
@@ -446,8 +446,11 @@ void Server::handleCommand_GotBlocks(NetworkPacket* pkt)
 				("GOTBLOCKS length is too short");
 	}
 
+	// Runs on a packet worker, the client may be gone already
 	ClientInterface::AutoLock lock(m_clients);
 	RemoteClient *client = m_clients.lockedGetClientNoEx(pkt->getPeerId());
+	if (!client)
+		return;
 
 	for (u16 i = 0; i < count; i++) {
 		v3s16 p;
@@ -556,13 +559,17 @@ void Server::handleCommand_DeletedBlocks(NetworkPacket* pkt)
 	u8 count;
 	*pkt >> count;
 
-	RemoteClient *client = getClient(pkt->getPeerId());
-
 	if ((s16)pkt->getSize() < 1 + (int)count * 6) {
 		throw con::InvalidIncomingDataException
 				("DELETEDBLOCKS length is too short");
 	}
 
+	// Runs on a packet worker, the client may be gone already
+	ClientInterface::AutoLock lock(m_clients);
+	RemoteClient *client = m_clients.lockedGetClientNoEx(pkt->getPeerId());
+	if (!client)
+		return;
+
 	for (u16 i = 0; i < count; i++) {
 		v3s16 p;
 		*pkt >> p;
@@ -1547,74 +1554,88 @@ void Server::handleCommand_FirstSrp(NetworkPacket* pkt)
 
 void Server::handleCommand_SrpBytesA(NetworkPacket* pkt)
 {
+	/*
+		This runs on a packet worker. The client interface is only locked
+		while the client is accessed, not during the SRP computation.
+	*/
 	session_t peer_id = pkt->getPeerId();
-	RemoteClient *client = getClient(peer_id, CS_Invalid);
-	ClientState cstate = client->getState();
-
-	if (!((cstate == CS_HelloSent) || (cstate == CS_Active))) {
-		actionstream << "Server: got SRP _A packet in wrong state " << cstate <<
-			" from " << getPeerAddress(peer_id).serializeString() <<
-			". Ignoring." << std::endl;
-		return;
-	}
-
-	const bool wantSudo = (cstate == CS_Active);
-
-	if (client->chosen_mech != AUTH_MECHANISM_NONE) {
-		actionstream << "Server: got SRP _A packet, while auth is already "
-			"going on with mech " << client->chosen_mech << " from " <<
-			getPeerAddress(peer_id).serializeString() <<
-			" (wantSudo=" << wantSudo << "). Ignoring." << std::endl;
-		if (wantSudo) {
-			DenySudoAccess(peer_id);
-			return;
-		}
-
-		DenyAccess(peer_id, SERVER_ACCESSDENIED_UNEXPECTED_DATA);
-		return;
-	}
-
 	std::string bytes_A;
 	u8 based_on;
-	*pkt >> bytes_A >> based_on;
+	std::string playername, enc_pwd;
+	bool wantSudo;
 
-	infostream << "Server: TOSERVER_SRP_BYTES_A received with "
-		<< "based_on=" << int(based_on) << " and len_A="
-		<< bytes_A.length() << "." << std::endl;
-
-	AuthMechanism chosen = (based_on == 0) ?
-		AUTH_MECHANISM_LEGACY_PASSWORD : AUTH_MECHANISM_SRP;
+	{
+		ClientInterface::AutoLock lock(m_clients);
+		RemoteClient *client = m_clients.lockedGetClientNoEx(peer_id, CS_Invalid);
+		if (!client)
+			return;
+		ClientState cstate = client->getState();
 
-	if (wantSudo) {
-		if (!client->isSudoMechAllowed(chosen)) {
-			actionstream << "Server: Player \"" << client->getName() <<
-				"\" at " << getPeerAddress(peer_id).serializeString() <<
-				" tried to change password using unallowed mech " << chosen <<
-				"." << std::endl;
-			DenySudoAccess(peer_id);
+		if (!((cstate == CS_HelloSent) || (cstate == CS_Active))) {
+			actionstream << "Server: got SRP _A packet in wrong state " << cstate <<
+				" from " << getPeerAddress(peer_id).serializeString() <<
+				". Ignoring." << std::endl;
 			return;
 		}
-	} else {
-		if (!client->isMechAllowed(chosen)) {
-			actionstream << "Server: Client tried to authenticate from " <<
+
+		wantSudo = (cstate == CS_Active);
+
+		if (client->chosen_mech != AUTH_MECHANISM_NONE) {
+			actionstream << "Server: got SRP _A packet, while auth is already "
+				"going on with mech " << client->chosen_mech << " from " <<
 				getPeerAddress(peer_id).serializeString() <<
-				" using unallowed mech " << chosen << "." << std::endl;
+				" (wantSudo=" << wantSudo << "). Ignoring." << std::endl;
+			if (wantSudo) {
+				DenySudoAccess(peer_id);
+				return;
+			}
+
 			DenyAccess(peer_id, SERVER_ACCESSDENIED_UNEXPECTED_DATA);
 			return;
 		}
-	}
 
-	client->chosen_mech = chosen;
+		*pkt >> bytes_A >> based_on;
+
+		infostream << "Server: TOSERVER_SRP_BYTES_A received with "
+			<< "based_on=" << int(based_on) << " and len_A="
+			<< bytes_A.length() << "." << std::endl;
+
+		AuthMechanism chosen = (based_on == 0) ?
+			AUTH_MECHANISM_LEGACY_PASSWORD : AUTH_MECHANISM_SRP;
+
+		if (wantSudo) {
+			if (!client->isSudoMechAllowed(chosen)) {
+				actionstream << "Server: Player \"" << client->getName() <<
+					"\" at " << getPeerAddress(peer_id).serializeString() <<
+					" tried to change password using unallowed mech " << chosen <<
+					"." << std::endl;
+				DenySudoAccess(peer_id);
+				return;
+			}
+		} else {
+			if (!client->isMechAllowed(chosen)) {
+				actionstream << "Server: Client tried to authenticate from " <<
+					getPeerAddress(peer_id).serializeString() <<
+					" using unallowed mech " << chosen << "." << std::endl;
+				DenyAccess(peer_id, SERVER_ACCESSDENIED_UNEXPECTED_DATA);
+				return;
+			}
+		}
+
+		client->chosen_mech = chosen;
+		playername = client->getName();
+		enc_pwd = client->enc_pwd;
+	}
 
 	std::string salt, verifier;
 
 	if (based_on == 0) {
 
-		generate_srp_verifier_and_salt(client->getName(), client->enc_pwd,
+		generate_srp_verifier_and_salt(playername, enc_pwd,
 			&verifier, &salt);
-	} else if (!decode_srp_verifier_and_salt(client->enc_pwd, &verifier, &salt)) {
+	} else if (!decode_srp_verifier_and_salt(enc_pwd, &verifier, &salt)) {
 		// Non-base64 errors should have been catched in the init handler
-		actionstream << "Server: User " << client->getName() <<
+		actionstream << "Server: User " << playername <<
 			" tried to log in, but srp verifier field was invalid (most likely "
 			"invalid base64)." << std::endl;
 		DenyAccess(peer_id, SERVER_ACCESSDENIED_SERVER_FAIL);
@@ -1624,26 +1645,36 @@ void Server::handleCommand_SrpBytesA(NetworkPacket* pkt)
 	char *bytes_B = 0;
 	size_t len_B = 0;
 
-	client->auth_data = srp_verifier_new(SRP_SHA256, SRP_NG_2048,
-		client->getName().c_str(),
+	SRPVerifier *auth_data = srp_verifier_new(SRP_SHA256, SRP_NG_2048,
+		playername.c_str(),
 		(const unsigned char *) salt.c_str(), salt.size(),
 		(const unsigned char *) verifier.c_str(), verifier.size(),
 		(const unsigned char *) bytes_A.c_str(), bytes_A.size(),
 		NULL, 0,
 		(unsigned char **) &bytes_B, &len_B, NULL, NULL);
 
-	if (!bytes_B) {
-		actionstream << "Server: User " << client->getName()
-			<< " tried to log in, SRP-6a safety check violated in _A handler."
-			<< std::endl;
-		if (wantSudo) {
-			DenySudoAccess(peer_id);
-			client->resetChosenMech();
+	{
+		ClientInterface::AutoLock lock(m_clients);
+		RemoteClient *client = m_clients.lockedGetClientNoEx(peer_id, CS_Invalid);
+		if (!client) {
+			srp_verifier_delete(auth_data);
 			return;
 		}
+		client->auth_data = auth_data;
 
-		DenyAccess(peer_id, SERVER_ACCESSDENIED_UNEXPECTED_DATA);
-		return;
+		if (!bytes_B) {
+			actionstream << "Server: User " << playername
+				<< " tried to log in, SRP-6a safety check violated in _A handler."
+				<< std::endl;
+			if (wantSudo) {
+				DenySudoAccess(peer_id);
+				client->resetChosenMech();
+				return;
+			}
+
+			DenyAccess(peer_id, SERVER_ACCESSDENIED_UNEXPECTED_DATA);
+			return;
+		}
 	}
 
 	NetworkPacket resp_pkt(TOCLIENT_SRP_BYTES_S_B, 0, peer_id);
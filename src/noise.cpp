@@ -731,3 +731,69 @@ void Noise::updateResults(float g, float *gmap,
 		}
 	}
 }
+
+
+bool Noise2DCache::get(Noise *noise, v2s16 pos)
+{
+	size_t bufsize = noise->sx * noise->sy * noise->sz;
+
+	for (Entry &e : m_entries) {
+		if (e.noise != noise || e.pos != pos)
+			continue;
+		// The noise was resized since
+		if (e.result.size() != bufsize)
+			return false;
+
+		e.last_used = ++m_use_counter;
+		memcpy(noise->result, e.result.data(), sizeof(float) * bufsize);
+		return true;
+	}
+
+	return false;
+}
+
+
+void Noise2DCache::put(Noise *noise, v2s16 pos)
+{
+	Entry *target = nullptr;
+	Entry *oldest = nullptr;
+	u32 count = 0;
+
+	for (Entry &e : m_entries) {
+		if (e.noise != noise)
+			continue;
+		if (e.pos == pos) {
+			target = &e;
+			break;
+		}
+		count++;
+		if (!oldest || e.last_used < oldest->last_used)
+			oldest = &e;
+	}
+
+	if (!target) {
+		if (count < CAPACITY) {
+			m_entries.emplace_back();
+			target = &m_entries.back();
+		} else {
+			target = oldest;
+		}
+	}
+
+	target->noise = noise;
+	target->pos = pos;
+	target->last_used = ++m_use_counter;
+	target->result.assign(noise->result,
+		noise->result + noise->sx * noise->sy * noise->sz);
+}
+
+
+float *Noise2DCache::perlinMap2D(Noise *noise, v2s16 pos, float *persistence_map)
+{
+	if (!get(noise, pos)) {
+		noise->perlinMap2D(pos.X, pos.Y, persistence_map);
+		put(noise, pos);
+	}
+
+	return noise->result;
+}
@@ -25,6 +25,8 @@
 
 #pragma once
 
+#include <vector>
+#include "irr_v2d.h"
 #include "irr_v3d.h"
 #include "exceptions.h"
 #include "util/string.h"
@@ -192,6 +194,42 @@ class Noise {
 
 };
 
+/*
+	LRU cache of 2D noise map results, keyed by the noise and the position of
+	the map. Vertically stacked mapchunks use the same 2D noise, which then
+	only has to be calculated once per column.
+	The cached results must only depend on the position: cache a noise
+	calculated with a persistence map only if that map is cached too.
+	Not thread-safe, each mapgen has its own.
+*/
+class Noise2DCache {
+public:
+	// Number of maps kept per noise
+	static constexpr u32 CAPACITY = 32;
+
+	// Copies the cached result into noise->result. Returns false if the
+	// result for this position is not cached.
+	bool get(Noise *noise, v2s16 pos);
+	// Stores the current noise->result as the result for this position
+	void put(Noise *noise, v2s16 pos);
+
+	// Cached Noise::perlinMap2D(pos.X, pos.Y, persistence_map)
+	float *perlinMap2D(Noise *noise, v2s16 pos, float *persistence_map = nullptr);
+
+	void clear() { m_entries.clear(); }
+
+private:
+	struct Entry {
+		Noise *noise;
+		v2s16 pos;
+		u64 last_used;
+		std::vector<float> result;
+	};
+
+	std::vector<Entry> m_entries;
+	u64 m_use_counter = 0;
+};
+
 float NoisePerlin2D(const NoiseParams *np, float x, float y, s32 seed);
 float NoisePerlin3D(const NoiseParams *np, float x, float y, float z, s32 seed);
 
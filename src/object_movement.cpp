@@ -0,0 +1,270 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "object_movement.h"
+#include <cmath>
+#include <sstream>
+#include "activeobject.h"
+#include "constants.h"
+#include "util/numeric.h"
+#include "util/serialize.h"
+
+// Quantization steps of delta updates, in world units (BS per node)
+static constexpr f32 POSITION_STEP = BS / 128.0f;
+static constexpr f32 VELOCITY_STEP = BS / 64.0f;
+static constexpr f32 ROTATION_STEP = 360.0f / 65536.0f;
+
+static bool quantize(const v3f &v, f32 step, v3s16 &result)
+{
+	v3f q = v / step;
+	if (std::fabs(q.X) > S16_MAX || std::fabs(q.Y) > S16_MAX ||
+			std::fabs(q.Z) > S16_MAX)
+		return false;
+	result = v3s16(std::round(q.X), std::round(q.Y), std::round(q.Z));
+	return true;
+}
+
+static inline v3f toV3f(const v3s16 &v)
+{
+	return v3f(v.X, v.Y, v.Z);
+}
+
+static u16 quantizeAngle(f32 degrees)
+{
+	return (u16)(s32)std::round(wrapDegrees_0_360(degrees) / ROTATION_STEP);
+}
+
+static u16 quantizeInterval(f32 seconds)
+{
+	return (u16)rangelim(std::round(seconds * 1000.0f), 0.0f, (f32)U16_MAX);
+}
+
+static void writeKeyframe(std::ostream &os, const ObjectMovement &m)
+{
+	writeV3F32(os, m.position);
+	writeV3F32(os, m.velocity);
+	writeV3F32(os, m.acceleration);
+	writeV3F32(os, m.rotation);
+}
+
+static u8 interpolationFlags(const ObjectMovement &m)
+{
+	return (m.do_interpolate ? OBJMOVE_DO_INTERPOLATE : 0) |
+		(m.is_movement_end ? OBJMOVE_MOVEMENT_END : 0);
+}
+
+bool ObjectMovement::isKeyframe(const std::string &datastring)
+{
+	return datastring.size() >= 2 && (datastring[1] & OBJMOVE_KEYFRAME);
+}
+
+/*
+	ObjectMovementEncoder
+*/
+
+bool ObjectMovementEncoder::canEncodeDelta(const ObjectMovement &m) const
+{
+	if (!m_have_keyframe || m_deltas_since_keyframe >= KEYFRAME_INTERVAL)
+		return false;
+
+	v3s16 dummy;
+	return quantize(m.position - m_keyframe.position, POSITION_STEP, dummy) &&
+		quantize(m.velocity, VELOCITY_STEP, dummy) &&
+		quantize(m.acceleration, VELOCITY_STEP, dummy);
+}
+
+std::string ObjectMovementEncoder::encode(const ObjectMovement &m, bool &keyframe,
+		ObjectMovement *decoded)
+{
+	std::ostringstream os(std::ios::binary);
+	writeU8(os, AO_CMD_UPDATE_MOVEMENT);
+
+	keyframe = !canEncodeDelta(m);
+	if (keyframe) {
+		m_keyframe = m;
+		m_have_keyframe = true;
+		m_keyframe_id++;
+		m_deltas_since_keyframe = 0;
+
+		writeU8(os, OBJMOVE_KEYFRAME | interpolationFlags(m));
+		writeU8(os, m_keyframe_id);
+		writeKeyframe(os, m);
+		writeU16(os, quantizeInterval(m.update_interval));
+		if (decoded)
+			*decoded = m;
+		return os.str();
+	}
+
+	m_deltas_since_keyframe++;
+
+	v3s16 offset, velocity, acceleration;
+	quantize(m.position - m_keyframe.position, POSITION_STEP, offset);
+	quantize(m.velocity, VELOCITY_STEP, velocity);
+	quantize(m.acceleration, VELOCITY_STEP, acceleration);
+	v3u16 rotation(quantizeAngle(m.rotation.X), quantizeAngle(m.rotation.Y),
+		quantizeAngle(m.rotation.Z));
+
+	u8 flags = interpolationFlags(m);
+	if (velocity != v3s16())
+		flags |= OBJMOVE_HAS_VELOCITY;
+	if (acceleration != v3s16())
+		flags |= OBJMOVE_HAS_ACCELERATION;
+	if (rotation != v3u16())
+		flags |= OBJMOVE_HAS_ROTATION;
+
+	writeU8(os, flags);
+	writeU8(os, m_keyframe_id);
+	writeV3S16(os, offset);
+	if (flags & OBJMOVE_HAS_VELOCITY)
+		writeV3S16(os, velocity);
+	if (flags & OBJMOVE_HAS_ACCELERATION)
+		writeV3S16(os, acceleration);
+	if (flags & OBJMOVE_HAS_ROTATION) {
+		writeU16(os, rotation.X);
+		writeU16(os, rotation.Y);
+		writeU16(os, rotation.Z);
+	}
+	writeU16(os, quantizeInterval(m.update_interval));
+
+	if (decoded) {
+		// Same as ObjectMovementDecoder::decode
+		*decoded = m;
+		decoded->position = m_keyframe.position + toV3f(offset) * POSITION_STEP;
+		decoded->velocity = toV3f(velocity) * VELOCITY_STEP;
+		decoded->acceleration = toV3f(acceleration) * VELOCITY_STEP;
+		decoded->rotation = v3f(rotation.X, rotation.Y, rotation.Z) * ROTATION_STEP;
+	}
+	return os.str();
+}
+
+std::string ObjectMovementEncoder::encodeReference() const
+{
+	if (!m_have_keyframe)
+		return "";
+
+	std::ostringstream os(std::ios::binary);
+	writeU8(os, AO_CMD_UPDATE_MOVEMENT);
+	writeU8(os, OBJMOVE_KEYFRAME | OBJMOVE_REFERENCE_ONLY);
+	writeU8(os, m_keyframe_id);
+	writeKeyframe(os, m_keyframe);
+	writeU16(os, quantizeInterval(m_keyframe.update_interval));
+	return os.str();
+}
+
+/*
+	ObjectMovementDecoder
+*/
+
+bool ObjectMovementDecoder::decode(std::istream &is, ObjectMovement &m)
+{
+	u8 flags = readU8(is);
+	u8 keyframe_id = readU8(is);
+
+	if (flags & OBJMOVE_KEYFRAME) {
+		m.position = readV3F32(is);
+		m.velocity = readV3F32(is);
+		m.acceleration = readV3F32(is);
+		m.rotation = readV3F32(is);
+	} else {
+		if (!m_have_keyframe || keyframe_id != m_keyframe_id)
+			return false;
+
+		m.position = m_keyframe.position +
+			toV3f(readV3S16(is)) * POSITION_STEP;
+		m.velocity = (flags & OBJMOVE_HAS_VELOCITY) ?
+			toV3f(readV3S16(is)) * VELOCITY_STEP : v3f();
+		m.acceleration = (flags & OBJMOVE_HAS_ACCELERATION) ?
+			toV3f(readV3S16(is)) * VELOCITY_STEP : v3f();
+		m.rotation = v3f();
+		if (flags & OBJMOVE_HAS_ROTATION) {
+			m.rotation.X = readU16(is) * ROTATION_STEP;
+			m.rotation.Y = readU16(is) * ROTATION_STEP;
+			m.rotation.Z = readU16(is) * ROTATION_STEP;
+		}
+	}
+	m.do_interpolate = flags & OBJMOVE_DO_INTERPOLATE;
+	m.is_movement_end = flags & OBJMOVE_MOVEMENT_END;
+	m.update_interval = readU16(is) / 1000.0f;
+
+	if (flags & OBJMOVE_KEYFRAME) {
+		m_keyframe = m;
+		m_have_keyframe = true;
+		m_keyframe_id = keyframe_id;
+		if (flags & OBJMOVE_REFERENCE_ONLY)
+			return false;
+	}
+	return true;
+}
+
+/*
+	MovementPredictor
+*/
+
+void MovementPredictor::reset(const v3f &position, const v3f &velocity,
+	const v3f &acceleration)
+{
+	m_position = position;
+	m_velocity = velocity;
+	m_acceleration = acceleration;
+	m_reset_position = position;
+	m_time = 0.0f;
+}
+
+void MovementPredictor::step(f32 dtime)
+{
+	m_position += dtime * m_velocity + 0.5f * dtime * dtime * m_acceleration;
+	m_velocity += dtime * m_acceleration;
+	m_time += dtime;
+}
+
+void MovementPredictor::applyCollision(int axis, const v3f &position)
+{
+	switch (axis) {
+	case 0:
+		m_position.X = position.X;
+		m_velocity.X = 0.0f;
+		break;
+	case 1:
+		m_position.Y = position.Y;
+		m_velocity.Y = 0.0f;
+		break;
+	case 2:
+		m_position.Z = position.Z;
+		m_velocity.Z = 0.0f;
+		break;
+	default:
+		break;
+	}
+}
+
+bool MovementPredictor::needsUpdate(const v3f &position, const v3f &velocity,
+		f32 max_error) const
+{
+	if (m_time > MAX_EXTRAPOLATION_TIME &&
+			position.getDistanceFrom(m_reset_position) > 0.01f * BS)
+		return true;
+
+	if (m_time > 1.0f)
+		max_error *= 0.05f;
+	else if (m_time > 0.2f)
+		max_error *= 0.25f;
+
+	return m_position.getDistanceFrom(position) > max_error ||
+		m_velocity.getDistanceFrom(velocity) > max_error;
+}
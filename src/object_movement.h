@@ -0,0 +1,143 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <string>
+#include <iostream>
+#include "irrlichttypes_bloated.h"
+
+/*
+	AO_CMD_UPDATE_MOVEMENT (protocol version >= 42)
+
+	u8 command
+	u8 flags (OBJMOVE_*)
+	u8 keyframe id
+	if OBJMOVE_KEYFRAME:
+		v3f32 position, velocity, acceleration, rotation
+	else:
+		v3s16 position offset to the keyframe, in 1/128 nodes
+		if OBJMOVE_HAS_VELOCITY:     v3s16 velocity, in 1/64 nodes/s
+		if OBJMOVE_HAS_ACCELERATION: v3s16 acceleration, in 1/64 nodes/s²
+		if OBJMOVE_HAS_ROTATION:     v3u16 rotation, in 1/65536 turns
+	u16 update interval in ms
+
+	Keyframes are sent reliably. Deltas are sent unreliably and are only
+	applied by clients which hold the keyframe with the same id.
+*/
+
+enum ObjectMovementFlags : u8
+{
+	OBJMOVE_KEYFRAME         = 0x01,
+	// Keyframe that only updates the client's reference (init data)
+	OBJMOVE_REFERENCE_ONLY   = 0x02,
+	OBJMOVE_DO_INTERPOLATE   = 0x04,
+	OBJMOVE_MOVEMENT_END     = 0x08,
+	OBJMOVE_HAS_VELOCITY     = 0x10,
+	OBJMOVE_HAS_ACCELERATION = 0x20,
+	OBJMOVE_HAS_ROTATION     = 0x40,
+};
+
+struct ObjectMovement
+{
+	v3f position;
+	v3f velocity;
+	v3f acceleration;
+	v3f rotation;
+	bool do_interpolate = false;
+	bool is_movement_end = false;
+	f32 update_interval = 0.0f;
+
+	// Returns true if the serialized command (datastring) is a keyframe
+	static bool isKeyframe(const std::string &datastring);
+};
+
+// Server side, one per object
+class ObjectMovementEncoder
+{
+public:
+	// Serializes an update. Sets 'keyframe' if the message must be sent reliably.
+	// 'decoded' receives the movement as clients decode it, after quantization.
+	std::string encode(const ObjectMovement &movement, bool &keyframe,
+			ObjectMovement *decoded = nullptr);
+	// Reference for clients which just got to know the object.
+	// Empty if no update was ever encoded.
+	std::string encodeReference() const;
+
+	// Force a keyframe after this many deltas
+	static constexpr u16 KEYFRAME_INTERVAL = 64;
+
+private:
+	bool canEncodeDelta(const ObjectMovement &movement) const;
+
+	ObjectMovement m_keyframe;
+	bool m_have_keyframe = false;
+	u8 m_keyframe_id = 0;
+	u16 m_deltas_since_keyframe = 0;
+};
+
+// Client side, one per object
+class ObjectMovementDecoder
+{
+public:
+	// Reads the command body (after the command byte).
+	// Returns false if the update must be ignored: either it only updated the
+	// reference or it is a delta to a keyframe that did not arrive (yet).
+	bool decode(std::istream &is, ObjectMovement &movement);
+
+private:
+	ObjectMovement m_keyframe;
+	bool m_have_keyframe = false;
+	u8 m_keyframe_id = 0;
+};
+
+/*
+	Server side: follows what clients extrapolate from the last sent movement
+	(see GenericCAO::step), so updates are only needed when the real movement
+	deviates from it.
+*/
+class MovementPredictor
+{
+public:
+	void reset(const v3f &position, const v3f &velocity, const v3f &acceleration);
+	void step(f32 dtime);
+	// Clients collide physical objects too: follow the real object on
+	// the axis it was stopped
+	void applyCollision(int axis, const v3f &position);
+
+	// Returns true if the real movement deviates by more than max_error.
+	// The allowed error shrinks while no update is sent, so that clients
+	// eventually get the exact position of slow or resting objects.
+	// Objects that moved are resynced after MAX_EXTRAPOLATION_TIME anyway,
+	// in case an unreliable update got lost.
+	bool needsUpdate(const v3f &position, const v3f &velocity,
+			f32 max_error) const;
+
+	static constexpr f32 MAX_EXTRAPOLATION_TIME = 5.0f;
+
+	const v3f &getPosition() const { return m_position; }
+
+private:
+	v3f m_position;
+	v3f m_velocity;
+	v3f m_acceleration;
+	v3f m_reset_position;
+	// Time since the last reset
+	f32 m_time = 0.0f;
+};
@@ -29,7 +29,7 @@ ScopeProfiler::ScopeProfiler(
 {
 	m_name.append(" [ms]");
 	if (m_profiler)
-		m_timer = new TimeTaker(m_name, nullptr, PRECISION_MILLI);
+		m_timer = new TimeTaker(m_name, nullptr, PRECISION_MICRO);
 }
 
 ScopeProfiler::~ScopeProfiler()
@@ -37,8 +37,8 @@ ScopeProfiler::~ScopeProfiler()
 	if (!m_timer)
 		return;
 
-	float duration_ms = m_timer->stop(true);
-	float duration = duration_ms;
+	// Measured in microseconds so that short scopes do not round down to 0 ms
+	float duration = m_timer->stop(true) / 1000.0f;
 	if (m_profiler) {
 		switch (m_type) {
 		case SPT_ADD:
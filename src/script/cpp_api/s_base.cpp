@@ -193,6 +193,24 @@ void ScriptApiBase::clientOpenLibs(lua_State *L)
 	}
 }
 
+LuaSamplingProfiler *ScriptApiBase::getProfiler()
+{
+	if (!m_profiler)
+		m_profiler = std::make_unique<LuaSamplingProfiler>();
+	return m_profiler.get();
+}
+
+void ScriptApiBase::startProfiler(u32 interval_us, MetricsBackend *metrics)
+{
+	getProfiler()->start(m_luastack, interval_us, metrics);
+}
+
+void ScriptApiBase::stopProfiler()
+{
+	if (m_profiler)
+		m_profiler->stop(m_luastack);
+}
+
 void ScriptApiBase::checkSetByBuiltin()
 {
 	lua_State *L = getStack();
@@ -313,25 +331,99 @@ void ScriptApiBase::runCallbacksRaw(int nargs,
 	PUSH_ERROR_HANDLER(L);
 	int error_handler = lua_gettop(L) - nargs - 1;
 	lua_insert(L, error_handler);
+	int callbacks = error_handler + 1;
+	int first_arg = error_handler + 2;
+	FATAL_ERROR_IF(!lua_istable(L, callbacks), "Callbacks must be a table");
 
-	// Insert run_callbacks between error handler and table
+	// Mods of the callbacks, set at registration (server only)
 	lua_getglobal(L, "core");
-	lua_getfield(L, -1, "run_callbacks");
+	lua_getfield(L, -1, "callback_origins");
 	lua_remove(L, -2);
-	lua_insert(L, error_handler + 1);
-
-	// Insert mode after table
-	lua_pushnumber(L, (int)mode);
-	lua_insert(L, error_handler + 3);
+	int origins = lua_gettop(L);
+	bool have_origins = lua_istable(L, origins);
+
+	// Return value
+	int cb_len = lua_objlen(L, callbacks);
+	if (cb_len == 0 && (mode == RUN_CALLBACKS_MODE_AND ||
+			mode == RUN_CALLBACKS_MODE_AND_SC))
+		lua_pushboolean(L, true);
+	else if (cb_len == 0 && (mode == RUN_CALLBACKS_MODE_OR ||
+			mode == RUN_CALLBACKS_MODE_OR_SC))
+		lua_pushboolean(L, false);
+	else
+		lua_pushnil(L);
+	int ret = lua_gettop(L);
 
 	// Stack now looks like this:
-	// ... <error handler> <run_callbacks> <table> <mode> <arg#1> <arg#2> ... <arg#n>
-
-	int result = lua_pcall(L, nargs + 2, 1, error_handler);
-	if (result != 0)
-		scriptError(result, fxn);
+	// ... <error handler> <table> <arg#1> ... <arg#n> <origins> <ret>
+
+	LuaSamplingProfiler *profiler =
+		m_profiler && m_profiler->isRunning() ? m_profiler.get() : nullptr;
+
+	for (int i = 1; i <= cb_len; i++) {
+		lua_rawgeti(L, callbacks, i);
+		if (have_origins) {
+			lua_pushvalue(L, -1);
+			lua_gettable(L, origins);
+			if (lua_istable(L, -1)) {
+				lua_getfield(L, -1, "mod");
+				setOriginDirect(lua_tostring(L, -1));
+				lua_pop(L, 1);
+			}
+			lua_pop(L, 1);
+		}
+		for (int arg = 0; arg < nargs; arg++)
+			lua_pushvalue(L, first_arg + arg);
+
+		// The callback may run other callbacks, which change the origin
+		std::string cb_mod;
+		u64 start_us = 0;
+		if (profiler) {
+			cb_mod = m_last_run_mod;
+			start_us = porting::getTimeUs();
+		}
+		int result = lua_pcall(L, nargs, 1, error_handler);
+		if (result != 0)
+			scriptError(result, fxn);
+		if (profiler)
+			profiler->addCallbackTime(fxn, cb_mod,
+				porting::getTimeUs() - start_us);
+
+		// Callback return value is at the top
+		bool cb_true = lua_toboolean(L, -1);
+		bool replace = false, stop = false;
+		switch (mode) {
+		case RUN_CALLBACKS_MODE_FIRST:
+			replace = i == 1;
+			break;
+		case RUN_CALLBACKS_MODE_LAST:
+			replace = i == cb_len;
+			break;
+		case RUN_CALLBACKS_MODE_AND:
+			replace = !cb_true || i == 1;
+			break;
+		case RUN_CALLBACKS_MODE_AND_SC:
+			replace = true;
+			stop = !cb_true;
+			break;
+		case RUN_CALLBACKS_MODE_OR:
+			replace = (cb_true && !lua_toboolean(L, ret)) || i == 1;
+			break;
+		case RUN_CALLBACKS_MODE_OR_SC:
+			replace = stop = cb_true;
+			break;
+		}
+		if (replace)
+			lua_replace(L, ret);
+		else
+			lua_pop(L, 1);
+		if (stop)
+			break;
+	}
 
-	lua_remove(L, error_handler);
+	// Replace error handler, table and arguments with the return value
+	lua_replace(L, error_handler);
+	lua_settop(L, error_handler);
 }
 
 void ScriptApiBase::realityCheck()
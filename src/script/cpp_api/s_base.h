@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include <string>
 #include <thread>
 #include <mutex>
@@ -35,6 +36,7 @@ extern "C" {
 #include "irrlichttypes.h"
 #include "common/c_types.h"
 #include "common/c_internal.h"
+#include "cpp_api/s_profiler.h"
 #include "debug.h"
 #include "config.h"
 
@@ -60,6 +62,7 @@ extern "C" {
 enum class ScriptingType: u8 {
 	Async,
 	Client,
+	Emerge,
 	MainMenu,
 	Server
 };
@@ -118,6 +121,12 @@ class ScriptApiBase : protected LuaHelper {
 	// Check things that should be set by the builtin mod.
 	void checkSetByBuiltin();
 
+	// Created on first use
+	LuaSamplingProfiler *getProfiler();
+	// Hooks the main thread, so that coroutines are included
+	void startProfiler(u32 interval_us, MetricsBackend *metrics);
+	void stopProfiler();
+
 protected:
 	friend class LuaABM;
 	friend class LuaLBM;
@@ -164,6 +173,7 @@ class ScriptApiBase : protected LuaHelper {
 	std::recursive_mutex m_luastackmutex;
 	std::string     m_last_run_mod;
 	bool            m_secure = false;
+	std::unique_ptr<LuaSamplingProfiler> m_profiler;
 #ifdef SCRIPTAPI_LOCK_DEBUG
 	int             m_lock_recursion_count{};
 	std::thread::id m_owning_thread;
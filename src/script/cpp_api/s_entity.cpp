@@ -24,6 +24,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/c_converter.h"
 #include "common/c_content.h"
 #include "server.h"
+#include "serverenvironment.h"
+#include "server/serveractiveobject.h"
 
 bool ScriptApiEntity::luaentity_Add(u16 id, const char *name)
 {
@@ -204,7 +206,29 @@ void ScriptApiEntity::luaentity_GetProperties(u16 id,
 	lua_pop(L, 1);
 }
 
-void ScriptApiEntity::luaentity_Step(u16 id, float dtime,
+LuaEntityStepMode ScriptApiEntity::luaentity_GetStepMode(u16 id)
+{
+	SCRIPTAPI_PRECHECKHEADER
+
+	// Get core.luaentities[id]
+	luaentity_get(L, id);
+	if (!lua_istable(L, -1)) {
+		lua_pop(L, 1);
+		return LuaEntityStepMode::None;
+	}
+
+	lua_getfield(L, -1, "on_step_batch");
+	bool batch = !lua_isnil(L, -1);
+	lua_getfield(L, -2, "on_step");
+	bool single = !lua_isnil(L, -1);
+	lua_pop(L, 3); // Pop on_step, on_step_batch and entity
+
+	if (batch)
+		return LuaEntityStepMode::Batch;
+	return single ? LuaEntityStepMode::Single : LuaEntityStepMode::None;
+}
+
+bool ScriptApiEntity::luaentity_Step(u16 id, float dtime,
 	const collisionMoveResult *moveresult)
 {
 	SCRIPTAPI_PRECHECKHEADER
@@ -219,7 +243,7 @@ void ScriptApiEntity::luaentity_Step(u16 id, float dtime,
 	lua_getfield(L, -1, "on_step");
 	if (lua_isnil(L, -1)) {
 		lua_pop(L, 2); // Pop on_step and entity
-		return;
+		return false;
 	}
 	luaL_checktype(L, -1, LUA_TFUNCTION);
 	lua_pushvalue(L, object); // self
@@ -234,6 +258,135 @@ void ScriptApiEntity::luaentity_Step(u16 id, float dtime,
 	PCALL_RES(lua_pcall(L, 3, 0, error_handler));
 
 	lua_pop(L, 2); // Pop object and error handler
+	return true;
+}
+
+void ScriptApiEntity::luaentity_QueueStep(u16 id, const std::string &name,
+	const collisionMoveResult *moveresult)
+{
+	std::vector<QueuedStep> &queue = m_step_batches[name].queue;
+	queue.emplace_back();
+	QueuedStep &step = queue.back();
+	step.id = id;
+	step.has_moveresult = moveresult != nullptr;
+	if (moveresult)
+		step.moveresult = *moveresult;
+	m_step_batches_queued = true;
+}
+
+void ScriptApiEntity::luaentity_RunQueuedSteps(float dtime)
+{
+	if (!m_step_batches_queued)
+		return;
+	m_step_batches_queued = false;
+
+	SCRIPTAPI_PRECHECKHEADER
+
+	int error_handler = PUSH_ERROR_HANDLER(L);
+
+	lua_getglobal(L, "core");
+	lua_getfield(L, -1, "registered_entities");
+	int registered_entities = lua_gettop(L);
+	lua_getfield(L, -2, "luaentities");
+	int luaentities = lua_gettop(L);
+
+	ServerEnvironment &env = getServer()->getEnv();
+
+	for (auto &it : m_step_batches) {
+		StepBatch &batch = it.second;
+		if (batch.queue.empty())
+			continue;
+
+		if (batch.entities_ref == LUA_NOREF) {
+			lua_newtable(L);
+			batch.entities_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+			lua_newtable(L);
+			batch.moveresults_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
+		lua_rawgeti(L, LUA_REGISTRYINDEX, batch.entities_ref);
+		int entities = lua_gettop(L);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, batch.moveresults_ref);
+		int moveresults = lua_gettop(L);
+
+		u32 count = 0;
+		for (const QueuedStep &step : batch.queue) {
+			// Objects removed by other callbacks in this step are skipped
+			ServerActiveObject *obj = env.getActiveObject(step.id);
+			if (!obj || obj->isGone())
+				continue;
+
+			lua_pushnumber(L, step.id);
+			lua_rawget(L, luaentities);
+			if (!lua_istable(L, -1)) {
+				lua_pop(L, 1);
+				continue;
+			}
+			lua_rawseti(L, entities, ++count);
+
+			if (step.has_moveresult)
+				push_collision_move_result(L, step.moveresult);
+			else
+				lua_pushboolean(L, false);
+			lua_rawseti(L, moveresults, count);
+		}
+		batch.queue.clear();
+
+		// Remove what is left of the previous step
+		for (u32 i = count + 1; i <= batch.size; i++) {
+			lua_pushnil(L);
+			lua_rawseti(L, entities, i);
+			lua_pushnil(L);
+			lua_rawseti(L, moveresults, i);
+		}
+		batch.size = count;
+
+		// Get on_step_batch from core.registered_entities[name]
+		lua_getfield(L, registered_entities, it.first.c_str());
+		int prototype = lua_gettop(L);
+		if (count == 0 || !lua_istable(L, prototype)) {
+			lua_pop(L, 3); // Pop prototype, moveresults and entities
+			continue;
+		}
+		setOriginFromTable(prototype);
+		lua_getfield(L, prototype, "on_step_batch");
+		if (lua_isnil(L, -1)) {
+			// Removed after the entities were queued, step them one by one
+			lua_pop(L, 1);
+			for (u32 i = 1; i <= count; i++) {
+				lua_rawgeti(L, entities, i);
+				lua_getfield(L, -1, "on_step");
+				if (lua_isnil(L, -1)) {
+					lua_pop(L, 2); // Pop on_step and entity
+					continue;
+				}
+				// on_step(self, dtime, moveresult)
+				lua_pushvalue(L, -2);
+				lua_pushnumber(L, dtime);
+				lua_rawgeti(L, moveresults, i);
+				if (!lua_toboolean(L, -1)) {
+					lua_pop(L, 1);
+					lua_pushnil(L);
+				}
+				PCALL_RES(lua_pcall(L, 3, 0, error_handler));
+				lua_pop(L, 1); // Pop entity
+			}
+			lua_pop(L, 3); // Pop prototype, moveresults and entities
+			continue;
+		}
+
+		// on_step_batch(entities, dtime, moveresults, count)
+		// Values that are no function fail inside the protected call
+		lua_pushvalue(L, entities);
+		lua_pushnumber(L, dtime);
+		lua_pushvalue(L, moveresults);
+		lua_pushinteger(L, count);
+
+		PCALL_RES(lua_pcall(L, 4, 0, error_handler));
+
+		lua_pop(L, 3); // Pop prototype, moveresults and entities
+	}
+
+	lua_pop(L, 4); // Pop luaentities, registered_entities, core and error handler
 }
 
 // Calls entity:on_punch(ObjectRef puncher, time_from_last_punch,
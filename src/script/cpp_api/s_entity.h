@@ -19,12 +19,28 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include <unordered_map>
+#include <vector>
 #include "cpp_api/s_base.h"
 #include "irr_v3d.h"
+#include "collision.h"
+
+extern "C" {
+#include <lauxlib.h>
+}
 
 struct ObjectProperties;
 struct ToolCapabilities;
-struct collisionMoveResult;
+
+enum class LuaEntityStepMode : u8
+{
+	// No on_step, the entity is not stepped in Lua
+	None,
+	// on_step is called for every entity
+	Single,
+	// on_step_batch is called once per entity type with all entities
+	Batch,
+};
 
 class ScriptApiEntity
 		: virtual public ScriptApiBase
@@ -38,8 +54,17 @@ class ScriptApiEntity
 	std::string luaentity_GetStaticdata(u16 id);
 	void luaentity_GetProperties(u16 id,
 			ServerActiveObject *self, ObjectProperties *prop);
-	void luaentity_Step(u16 id, float dtime,
+	// Checked after activation and again whenever the callbacks are missing
+	LuaEntityStepMode luaentity_GetStepMode(u16 id);
+	// Returns false if the entity has no on_step
+	bool luaentity_Step(u16 id, float dtime,
 		const collisionMoveResult *moveresult);
+	// Entities with LuaEntityStepMode::Batch are queued while stepping the
+	// objects, then on_step_batch is called for each entity type.
+	// Falls back to on_step if on_step_batch was removed meanwhile.
+	void luaentity_QueueStep(u16 id, const std::string &name,
+		const collisionMoveResult *moveresult);
+	void luaentity_RunQueuedSteps(float dtime);
 	bool luaentity_Punch(u16 id,
 			ServerActiveObject *puncher, float time_from_last_punch,
 			const ToolCapabilities *toolcap, v3f dir, s32 damage);
@@ -51,4 +76,26 @@ class ScriptApiEntity
 private:
 	bool luaentity_run_simple_callback(u16 id, ServerActiveObject *sao,
 		const char *field);
+
+	struct QueuedStep
+	{
+		u16 id;
+		bool has_moveresult;
+		collisionMoveResult moveresult;
+	};
+
+	struct StepBatch
+	{
+		std::vector<QueuedStep> queue;
+		// Registry references of the tables passed to on_step_batch.
+		// They are reused in every step.
+		int entities_ref = LUA_NOREF;
+		int moveresults_ref = LUA_NOREF;
+		// Number of entries in these tables
+		u32 size = 0;
+	};
+
+	// Indexed by entity name
+	std::unordered_map<std::string, StepBatch> m_step_batches;
+	bool m_step_batches_queued = false;
 };
@@ -82,4 +82,5 @@ class LockChecker {
 		realityCheck();                                                        \
 		lua_State *L = getStack();                                             \
 		assert(lua_checkstack(L, 20));                                         \
-		StackUnroller stack_unroller(L);
+		StackUnroller stack_unroller(L);                                       \
+		LuaProfilerScope profiler_scope(this->m_profiler.get());
@@ -0,0 +1,49 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "cpp_api/s_mapgen.h"
+#include "cpp_api/s_internal.h"
+#include "common/c_converter.h"
+#include "lua_api/l_vmanip.h"
+
+void ScriptApiMapgen::on_generated(MMVManip *vm, v3s16 minp, v3s16 maxp,
+	u32 blockseed)
+{
+	SCRIPTAPI_PRECHECKHEADER
+
+	LuaVoxelManip *o = new LuaVoxelManip(vm, true);
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, LuaVoxelManip::className);
+	lua_setmetatable(L, -2);
+	// Keep a reference until the callbacks are done
+	int vmanip = lua_gettop(L);
+
+	// Get core.registered_on_generateds
+	lua_getglobal(L, "core");
+	lua_getfield(L, -1, "registered_on_generateds");
+	// Call callbacks
+	lua_pushvalue(L, vmanip);
+	push_v3s16(L, minp);
+	push_v3s16(L, maxp);
+	lua_pushnumber(L, blockseed);
+	runCallbacks(4, RUN_CALLBACKS_MODE_FIRST);
+
+	// Lua may keep the object, it must not point to the chunk anymore
+	o->detachMapgenVM();
+}
@@ -0,0 +1,36 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "cpp_api/s_base.h"
+#include "irr_v3d.h"
+
+class MMVManip;
+
+class ScriptApiMapgen : virtual public ScriptApiBase
+{
+public:
+	/*
+		Runs the on_generated callbacks of the mapgen environment on the
+		VoxelManip of a chunk before it is written to the map.
+		The VoxelManip given to Lua is only valid during the callbacks.
+	*/
+	void on_generated(MMVManip *vm, v3s16 minp, v3s16 maxp, u32 blockseed);
+};
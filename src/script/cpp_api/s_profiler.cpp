@@ -0,0 +1,162 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "cpp_api/s_profiler.h"
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include "cpp_api/s_base.h"
+#include "lua_api/l_base.h"
+#include "porting.h"
+
+void LuaSamplingProfiler::start(lua_State *L, u32 interval_us,
+	MetricsBackend *metrics)
+{
+	m_interval_us = std::max<u32>(interval_us, 1);
+	m_metrics = metrics;
+	m_pending_us = 0;
+	// Called from Lua: the current call counts as entered
+	m_depth = 0;
+	m_mark_us = porting::getTimeUs();
+	m_running = true;
+
+	lua_sethook(L, hook, LUA_MASKCOUNT, HOOK_INSTRUCTIONS);
+}
+
+void LuaSamplingProfiler::stop(lua_State *L)
+{
+	lua_sethook(L, nullptr, 0, 0);
+	m_running = false;
+	m_depth = 0;
+}
+
+void LuaSamplingProfiler::reset()
+{
+	m_stacks.clear();
+	// Keep the metric counters, they are monotonic
+	for (auto &it : m_callbacks) {
+		it.second.calls = 0;
+		it.second.time_us = 0;
+	}
+}
+
+void LuaSamplingProfiler::enter()
+{
+	if (m_depth++ == 0)
+		m_mark_us = porting::getTimeUs();
+}
+
+void LuaSamplingProfiler::leave()
+{
+	// Scopes opened before stop() may still close afterwards
+	if (m_depth == 0)
+		return;
+
+	if (--m_depth == 0)
+		m_pending_us += porting::getTimeUs() - m_mark_us;
+}
+
+void LuaSamplingProfiler::hook(lua_State *L, lua_Debug *ar)
+{
+	ScriptApiBase *script = ModApiBase::getScriptApiBase(L);
+	LuaSamplingProfiler *profiler = script->getProfiler();
+	if (!profiler->m_running)
+		return;
+
+	u64 now = porting::getTimeUs();
+	profiler->m_pending_us += now - profiler->m_mark_us;
+	profiler->m_mark_us = now;
+	if (profiler->m_pending_us < profiler->m_interval_us)
+		return;
+
+	profiler->sample(L, script->getOrigin(), profiler->m_pending_us);
+	profiler->m_pending_us = 0;
+}
+
+static void append_frame(std::string &stack, const lua_Debug &ar)
+{
+	std::string frame;
+	if (ar.what && std::string(ar.what) == "C") {
+		frame = "[C] ";
+		frame.append(ar.name ? ar.name : "?");
+	} else {
+		frame.append(ar.name ? ar.name : (ar.what && ar.what[0] == 'm' ?
+			"main chunk" : "?"));
+		frame.append(" ").append(ar.short_src).append(":")
+			.append(std::to_string(ar.linedefined));
+	}
+	// ';' separates frames in the folded format
+	std::replace(frame.begin(), frame.end(), ';', ',');
+	stack.append(";").append(frame);
+}
+
+void LuaSamplingProfiler::sample(lua_State *L, const std::string &mod,
+	u64 weight_us)
+{
+	std::vector<lua_Debug> frames;
+	lua_Debug ar;
+	for (u32 level = 0; level < MAX_STACK_DEPTH && lua_getstack(L, level, &ar);
+			level++) {
+		lua_getinfo(L, "Sn", &ar);
+		frames.push_back(ar);
+	}
+
+	std::string stack = mod.empty() ? "??" : mod;
+	std::replace(stack.begin(), stack.end(), ';', ',');
+	for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+		append_frame(stack, *it);
+	m_stacks[stack] += weight_us;
+
+	if (!m_metrics)
+		return;
+	auto counter = m_mod_counters.find(mod);
+	if (counter == m_mod_counters.end()) {
+		counter = m_mod_counters.emplace(mod, m_metrics->addCounter(
+			"minetest_lua_profiler_time_us",
+			"Sampled Lua time per mod (in microseconds)",
+			{{"mod", mod}})).first;
+	}
+	counter->second->increment(weight_us);
+}
+
+void LuaSamplingProfiler::addCallbackTime(const char *callback,
+	const std::string &mod, u64 time_us)
+{
+	CallbackStats &stats = m_callbacks[std::make_pair(callback, mod)];
+	stats.calls++;
+	stats.time_us += time_us;
+
+	if (!m_metrics)
+		return;
+	if (!stats.counter) {
+		stats.counter = m_metrics->addCounter(
+			"minetest_lua_callback_time_us",
+			"Time spent in registered callbacks (in microseconds)",
+			{{"callback", callback}, {"mod", mod}});
+	}
+	stats.counter->increment(time_us);
+}
+
+std::string LuaSamplingProfiler::getFoldedStacks() const
+{
+	std::ostringstream os;
+	for (const auto &it : m_stacks)
+		os << it.first << " " << it.second << "\n";
+	return os.str();
+}
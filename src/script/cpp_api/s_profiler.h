@@ -0,0 +1,116 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include "irrlichttypes.h"
+#include "util/metricsbackend.h"
+
+extern "C" {
+#include <lua.h>
+}
+
+/*
+	Sampling profiler for one Lua state.
+
+	A count hook checks the time spent in Lua (including the engine API
+	functions called from it) every HOOK_INSTRUCTIONS instructions. Once
+	the sampling interval is reached, the stack is recorded together with
+	the mod currently running and weighted with the time since the last
+	sample. Without the hook there is no cost except for enter()/leave().
+
+	Code compiled by LuaJIT does not run hooks, its time is attributed to
+	the next interpreted sample.
+*/
+class LuaSamplingProfiler
+{
+public:
+	static constexpr int HOOK_INSTRUCTIONS = 1000;
+	static constexpr u32 MAX_STACK_DEPTH = 64;
+
+	void start(lua_State *L, u32 interval_us, MetricsBackend *metrics);
+	void stop(lua_State *L);
+	bool isRunning() const { return m_running; }
+	void reset();
+
+	// Outermost call into Lua, see SCRIPTAPI_PRECHECKHEADER
+	void enter();
+	void leave();
+
+	// Time of a callback run by ScriptApiBase::runCallbacksRaw
+	void addCallbackTime(const char *callback, const std::string &mod, u64 time_us);
+
+	struct CallbackStats
+	{
+		u64 calls = 0;
+		u64 time_us = 0;
+		MetricCounterPtr counter;
+	};
+	// Indexed by callback name and mod
+	using CallbackStatsMap =
+		std::map<std::pair<std::string, std::string>, CallbackStats>;
+	const CallbackStatsMap &getCallbackStats() const { return m_callbacks; }
+
+	// Sampled stacks in the folded format of flamegraph.pl:
+	// "mod;outermost frame;...;innermost frame <microseconds>" per line
+	std::string getFoldedStacks() const;
+
+private:
+	static void hook(lua_State *L, lua_Debug *ar);
+	void sample(lua_State *L, const std::string &mod, u64 weight_us);
+
+	bool m_running = false;
+	u32 m_interval_us = 0;
+	// Depth of nested enter() calls
+	u32 m_depth = 0;
+	// Start of the not yet accounted Lua time
+	u64 m_mark_us = 0;
+	// Lua time since the last sample
+	u64 m_pending_us = 0;
+
+	std::unordered_map<std::string, u64> m_stacks;
+	CallbackStatsMap m_callbacks;
+
+	MetricsBackend *m_metrics = nullptr;
+	std::unordered_map<std::string, MetricCounterPtr> m_mod_counters;
+};
+
+// Calls enter() and leave() if the profiler is running
+class LuaProfilerScope
+{
+public:
+	LuaProfilerScope(LuaSamplingProfiler *profiler) :
+		m_profiler(profiler && profiler->isRunning() ? profiler : nullptr)
+	{
+		if (m_profiler)
+			m_profiler->enter();
+	}
+
+	~LuaProfilerScope()
+	{
+		if (m_profiler)
+			m_profiler->leave();
+	}
+
+private:
+	LuaSamplingProfiler *m_profiler;
+};
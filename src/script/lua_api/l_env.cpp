@@ -36,7 +36,6 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapgen/treegen.h"
 #include "emerge.h"
 #include "pathfinder.h"
-#include "face_position_cache.h"
 #include "remoteplayer.h"
 #include "server/luaentity_sao.h"
 #include "server/player_sao.h"
@@ -359,6 +358,86 @@ int ModApiEnvMod::l_get_node_or_nil(lua_State *L)
 	return 1;
 }
 
+// Reads the nodes at the positions in the list at 'index'.
+// Positions are grouped by MapBlock, so that each block is looked up once.
+static void get_nodes_bulk(lua_State *L, int index, Map &map,
+	std::vector<MapNode> &nodes)
+{
+	luaL_checktype(L, index, LUA_TTABLE);
+	size_t len = lua_objlen(L, index);
+
+	std::vector<v3s16> blockpos(len), relpos(len);
+	std::vector<u32> order(len);
+	for (size_t i = 0; i < len; i++) {
+		lua_rawgeti(L, index, i + 1);
+		getNodeBlockPosWithOffset(read_v3s16(L, -1), blockpos[i], relpos[i]);
+		lua_pop(L, 1);
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [&] (u32 a, u32 b) {
+		const v3s16 &pa = blockpos[a], &pb = blockpos[b];
+		if (pa.Z != pb.Z)
+			return pa.Z < pb.Z;
+		if (pa.Y != pb.Y)
+			return pa.Y < pb.Y;
+		return pa.X < pb.X;
+	});
+
+	nodes.assign(len, MapNode(CONTENT_IGNORE));
+	MapBlock *block = nullptr;
+	for (size_t k = 0; k < len; k++) {
+		u32 i = order[k];
+		if (k == 0 || blockpos[i] != blockpos[order[k - 1]])
+			block = map.getBlockNoCreateNoEx(blockpos[i]);
+		if (block)
+			nodes[i] = block->getNodeNoCheck(relpos[i]);
+	}
+}
+
+// bulk_get_node([pos1, pos2, ...])
+// pos = {x=num, y=num, z=num}
+int ModApiEnvMod::l_bulk_get_node(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	std::vector<MapNode> nodes;
+	get_nodes_bulk(L, 1, env->getMap(), nodes);
+
+	lua_createtable(L, nodes.size(), 0);
+	for (size_t i = 0; i < nodes.size(); i++) {
+		pushnode(L, nodes[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+// bulk_get_node_raw([pos1, pos2, ...], [content_ids], [param1s], [param2s])
+// pos = {x=num, y=num, z=num}
+int ModApiEnvMod::l_bulk_get_node_raw(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	std::vector<MapNode> nodes;
+	get_nodes_bulk(L, 1, env->getMap(), nodes);
+
+	for (int field = 0; field < 3; field++) {
+		// Reuse the given tables, like VoxelManip:get_data(buffer)
+		if (lua_istable(L, 2 + field))
+			lua_pushvalue(L, 2 + field);
+		else
+			lua_createtable(L, nodes.size(), 0);
+
+		for (size_t i = 0; i < nodes.size(); i++) {
+			const MapNode &n = nodes[i];
+			lua_pushinteger(L, field == 0 ? n.getContent() :
+				field == 1 ? n.getParam1() : n.getParam2());
+			lua_rawseti(L, -2, i + 1);
+		}
+	}
+	return 3;
+}
+
 // get_node_light(pos, timeofday)
 // pos = {x=num, y=num, z=num}
 // timeofday: nil = current time, 0 = night, 0.5 = day
@@ -835,16 +914,10 @@ int ModApiEnvMod::l_find_node_near(lua_State *L)
 		radius = client->CSMClampRadius(pos, radius);
 #endif
 
-	for (int d = start_radius; d <= radius; d++) {
-		const std::vector<v3s16> &list = FacePositionCache::getFacePositions(d);
-		for (const v3s16 &i : list) {
-			v3s16 p = pos + i;
-			content_t c = map.getNode(p).getContent();
-			if (CONTAINS(filter, c)) {
-				push_v3s16(L, p);
-				return 1;
-			}
-		}
+	v3s16 found;
+	if (map.findNodeNear(pos, start_radius, radius, filter, &found)) {
+		push_v3s16(L, found);
+		return 1;
 	}
 	return 0;
 }
@@ -901,16 +974,13 @@ int ModApiEnvMod::l_find_nodes_in_area(lua_State *L)
 		for (u32 i = 0; i < filter.size(); i++)
 			lua_newtable(L);
 
-		map.forEachNodeInArea(minp, maxp, [&](v3s16 p, MapNode n) -> bool {
-			content_t c = n.getContent();
-
-			auto it = std::find(filter.begin(), filter.end(), c);
-			if (it != filter.end()) {
-				// Calculate index of the table and append the position
-				u32 filt_index = it - filter.begin();
-				push_v3s16(L, p);
-				lua_rawseti(L, base + 1 + filt_index, ++idx[filt_index]);
-			}
+		map.forEachNodeInAreaWithContent(minp, maxp, filter,
+				[&](v3s16 p, MapNode n) -> bool {
+			// Calculate index of the table and append the position
+			auto it = std::find(filter.begin(), filter.end(), n.getContent());
+			u32 filt_index = it - filter.begin();
+			push_v3s16(L, p);
+			lua_rawseti(L, base + 1 + filt_index, ++idx[filt_index]);
 
 			return true;
 		});
@@ -935,17 +1005,14 @@ int ModApiEnvMod::l_find_nodes_in_area(lua_State *L)
 
 		lua_newtable(L);
 		u32 i = 0;
-		map.forEachNodeInArea(minp, maxp, [&](v3s16 p, MapNode n) -> bool {
-			content_t c = n.getContent();
+		map.forEachNodeInAreaWithContent(minp, maxp, filter,
+				[&](v3s16 p, MapNode n) -> bool {
+			push_v3s16(L, p);
+			lua_rawseti(L, -2, ++i);
 
-			auto it = std::find(filter.begin(), filter.end(), c);
-			if (it != filter.end()) {
-				push_v3s16(L, p);
-				lua_rawseti(L, -2, ++i);
-
-				u32 filt_index = it - filter.begin();
-				individual_count[filt_index]++;
-			}
+			auto it = std::find(filter.begin(), filter.end(), n.getContent());
+			u32 filt_index = it - filter.begin();
+			individual_count[filt_index]++;
 
 			return true;
 		});
@@ -993,22 +1060,17 @@ int ModApiEnvMod::l_find_nodes_in_area_under_air(lua_State *L)
 
 	lua_newtable(L);
 	u32 i = 0;
-	v3s16 p;
-	for (p.X = minp.X; p.X <= maxp.X; p.X++)
-	for (p.Z = minp.Z; p.Z <= maxp.Z; p.Z++) {
-		p.Y = minp.Y;
-		content_t c = map.getNode(p).getContent();
-		for (; p.Y <= maxp.Y; p.Y++) {
-			v3s16 psurf(p.X, p.Y + 1, p.Z);
-			content_t csurf = map.getNode(psurf).getContent();
-			if (c != CONTENT_AIR && csurf == CONTENT_AIR &&
-					CONTAINS(filter, c)) {
-				push_v3s16(L, p);
-				lua_rawseti(L, -2, ++i);
-			}
-			c = csurf;
+	map.forEachNodeInAreaWithContent(minp, maxp, filter,
+			[&](v3s16 p, MapNode n) -> bool {
+		if (n.getContent() == CONTENT_AIR)
+			return true;
+		v3s16 psurf(p.X, p.Y + 1, p.Z);
+		if (map.getNode(psurf).getContent() == CONTENT_AIR) {
+			push_v3s16(L, p);
+			lua_rawseti(L, -2, ++i);
 		}
-	}
+		return true;
+	});
 	return 1;
 }
 
@@ -1421,6 +1483,8 @@ void ModApiEnvMod::Initialize(lua_State *L, int top)
 	API_FCT(remove_node);
 	API_FCT(get_node);
 	API_FCT(get_node_or_nil);
+	API_FCT(bulk_get_node);
+	API_FCT(bulk_get_node_raw);
 	API_FCT(get_node_light);
 	API_FCT(get_natural_light);
 	API_FCT(place_node);
@@ -1464,7 +1464,7 @@ int ModApiMapgen::l_generate_ores(lua_State *L)
 	Mapgen mg;
 	// Intentionally truncates to s32, see Mapgen::Mapgen()
 	mg.seed = (s32)emerge->mgparams->seed;
-	mg.vm   = checkObject<LuaVoxelManip>(L, 1)->vm;
+	mg.vm   = LuaVoxelManip::checkMutable(L, 1)->vm;
 	mg.ndef = getServer(L)->getNodeDefManager();
 
 	v3s16 pmin = lua_istable(L, 2) ? check_v3s16(L, 2) :
@@ -1493,7 +1493,7 @@ int ModApiMapgen::l_generate_decorations(lua_State *L)
 	Mapgen mg;
 	// Intentionally truncates to s32, see Mapgen::Mapgen()
 	mg.seed = (s32)emerge->mgparams->seed;
-	mg.vm   = checkObject<LuaVoxelManip>(L, 1)->vm;
+	mg.vm   = LuaVoxelManip::checkMutable(L, 1)->vm;
 	mg.ndef = getServer(L)->getNodeDefManager();
 
 	v3s16 pmin = lua_istable(L, 2) ? check_v3s16(L, 2) :
@@ -1632,7 +1632,7 @@ int ModApiMapgen::l_place_schematic_on_vmanip(lua_State *L)
 	SchematicManager *schemmgr = getServer(L)->getEmergeManager()->schemmgr;
 
 	//// Read VoxelManip object
-	MMVManip *vm = checkObject<LuaVoxelManip>(L, 1)->vm;
+	MMVManip *vm = LuaVoxelManip::checkMutable(L, 1)->vm;
 
 	//// Read position
 	v3s16 p = check_v3s16(L, 2);
@@ -1846,3 +1846,17 @@ void ModApiMapgen::Initialize(lua_State *L, int top)
 	API_FCT(serialize_schematic);
 	API_FCT(read_schematic);
 }
+
+void ModApiMapgen::InitializeEmerge(lua_State *L, int top)
+{
+	// Only what is safe to call from several emerge threads at once
+	API_FCT(get_biome_id);
+	API_FCT(get_biome_name);
+	API_FCT(get_mapgen_object);
+
+	API_FCT(get_mapgen_edges);
+	API_FCT(get_mapgen_setting);
+	API_FCT(get_mapgen_setting_noiseparams);
+	API_FCT(get_noiseparams);
+	API_FCT(get_decoration_id);
+}
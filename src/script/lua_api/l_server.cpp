@@ -586,6 +586,25 @@ int ModApiServer::l_register_async_dofile(lua_State *L)
 	return 1;
 }
 
+// register_mapgen_script(path)
+int ModApiServer::l_register_mapgen_script(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	std::string path = readParam<std::string>(L, 1);
+	CHECK_SECURE_PATH(L, path.c_str(), false);
+
+	// Find currently running mod name (only at init time)
+	lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_CURRENT_MOD_NAME);
+	if (!lua_isstring(L, -1))
+		return 0;
+	std::string modname = readParam<std::string>(L, -1);
+
+	getServer(L)->m_mapgen_init_files.emplace_back(modname, path);
+	lua_pushboolean(L, true);
+	return 1;
+}
+
 // serialize_roundtrip(value)
 // Meant for unit testing the packer from Lua
 int ModApiServer::l_serialize_roundtrip(lua_State *L)
@@ -610,6 +629,66 @@ int ModApiServer::l_serialize_roundtrip(lua_State *L)
 	return 1;
 }
 
+// sampling_profiler_start([interval_us])
+int ModApiServer::l_sampling_profiler_start(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	u32 interval_us = luaL_optinteger(L, 1, 1000);
+	getScriptApiBase(L)->startProfiler(interval_us,
+		getServer(L)->getMetricsBackend());
+	return 0;
+}
+
+// sampling_profiler_stop()
+int ModApiServer::l_sampling_profiler_stop(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	getScriptApiBase(L)->stopProfiler();
+	return 0;
+}
+
+// sampling_profiler_get_folded([reset]) -> string
+int ModApiServer::l_sampling_profiler_get_folded(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaSamplingProfiler *profiler = getScriptApiBase(L)->getProfiler();
+	std::string folded = profiler->getFoldedStacks();
+	if (readParam<bool>(L, 1, false))
+		profiler->reset();
+
+	lua_pushlstring(L, folded.c_str(), folded.size());
+	return 1;
+}
+
+// sampling_profiler_get_callbacks()
+// -> list of {callback=name, mod=name, calls=int, time_us=int}
+int ModApiServer::l_sampling_profiler_get_callbacks(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	const auto &stats = getScriptApiBase(L)->getProfiler()->getCallbackStats();
+	lua_createtable(L, stats.size(), 0);
+	int i = 0;
+	for (const auto &it : stats) {
+		if (it.second.calls == 0)
+			continue;
+		lua_createtable(L, 0, 4);
+		lua_pushstring(L, it.first.first.c_str());
+		lua_setfield(L, -2, "callback");
+		lua_pushstring(L, it.first.second.c_str());
+		lua_setfield(L, -2, "mod");
+		lua_pushinteger(L, it.second.calls);
+		lua_setfield(L, -2, "calls");
+		lua_pushinteger(L, it.second.time_us);
+		lua_setfield(L, -2, "time_us");
+		lua_rawseti(L, -2, ++i);
+	}
+	return 1;
+}
+
 void ModApiServer::Initialize(lua_State *L, int top)
 {
 	API_FCT(request_shutdown);
@@ -647,7 +726,13 @@ void ModApiServer::Initialize(lua_State *L, int top)
 
 	API_FCT(do_async_callback);
 	API_FCT(register_async_dofile);
+	API_FCT(register_mapgen_script);
 	API_FCT(serialize_roundtrip);
+
+	API_FCT(sampling_profiler_start);
+	API_FCT(sampling_profiler_stop);
+	API_FCT(sampling_profiler_get_folded);
+	API_FCT(sampling_profiler_get_callbacks);
 }
 
 void ModApiServer::InitializeAsync(lua_State *L, int top)
@@ -115,9 +115,25 @@ class ModApiServer : public ModApiBase
 	// register_async_dofile(path)
 	static int l_register_async_dofile(lua_State *L);
 
+	// register_mapgen_script(path)
+	static int l_register_mapgen_script(lua_State *L);
+
 	// serialize_roundtrip(obj)
 	static int l_serialize_roundtrip(lua_State *L);
 
+	// sampling_profiler_start([interval_us])
+	static int l_sampling_profiler_start(lua_State *L);
+
+	// sampling_profiler_stop()
+	static int l_sampling_profiler_stop(lua_State *L);
+
+	// sampling_profiler_get_folded([reset]) -> string
+	static int l_sampling_profiler_get_folded(lua_State *L);
+
+	// sampling_profiler_get_callbacks()
+	// -> list of {callback=name, mod=name, calls=int, time_us=int}
+	static int l_sampling_profiler_get_callbacks(lua_State *L);
+
 public:
 	static void Initialize(lua_State *L, int top);
 	static void InitializeAsync(lua_State *L, int top);
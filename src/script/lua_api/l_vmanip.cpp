@@ -17,6 +17,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <cstddef>
 #include <map>
 #include "lua_api/l_vmanip.h"
 #include "lua_api/l_internal.h"
@@ -44,7 +45,7 @@ int LuaVoxelManip::l_read_from_map(lua_State *L)
 {
 	MAP_LOCK_REQUIRED;
 
-	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	LuaVoxelManip *o = checkMutable(L, 1);
 	MMVManip *vm = o->vm;
 	if (vm->isOrphan())
 		return 0;
@@ -90,7 +91,7 @@ int LuaVoxelManip::l_set_data(lua_State *L)
 {
 	NO_MAP_LOCK_REQUIRED;
 
-	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	LuaVoxelManip *o = checkMutable(L, 1);
 	MMVManip *vm = o->vm;
 
 	if (!lua_istable(L, 2))
@@ -113,7 +114,9 @@ int LuaVoxelManip::l_write_to_map(lua_State *L)
 {
 	MAP_LOCK_REQUIRED;
 
-	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	LuaVoxelManip *o = checkMutable(L, 1);
+	if (o->vm->isOrphan())
+		return 0;
 	bool update_light = !lua_isboolean(L, 2) || readParam<bool>(L, 2);
 
 	GET_ENV_PTR;
@@ -150,7 +153,7 @@ int LuaVoxelManip::l_set_node_at(lua_State *L)
 {
 	NO_MAP_LOCK_REQUIRED;
 
-	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	LuaVoxelManip *o = checkMutable(L, 1);
 	v3s16 pos        = check_v3s16(L, 2);
 	MapNode n        = readnode(L, 3);
 
@@ -163,7 +166,7 @@ int LuaVoxelManip::l_update_liquids(lua_State *L)
 {
 	GET_ENV_PTR;
 
-	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	LuaVoxelManip *o = checkMutable(L, 1);
 
 	ServerMap *map = &(env->getServerMap());
 	const NodeDefManager *ndef = getServer(L)->getNodeDefManager();
@@ -183,7 +186,7 @@ int LuaVoxelManip::l_calc_lighting(lua_State *L)
 {
 	NO_MAP_LOCK_REQUIRED;
 
-	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	LuaVoxelManip *o = checkMutable(L, 1);
 	if (!o->is_mapgen_vm) {
 		warningstream << "VoxelManip:calc_lighting called for a non-mapgen "
 			"VoxelManip object" << std::endl;
@@ -219,7 +222,7 @@ int LuaVoxelManip::l_set_lighting(lua_State *L)
 {
 	NO_MAP_LOCK_REQUIRED;
 
-	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	LuaVoxelManip *o = checkMutable(L, 1);
 	if (!o->is_mapgen_vm) {
 		warningstream << "VoxelManip:set_lighting called for a non-mapgen "
 			"VoxelManip object" << std::endl;
@@ -280,7 +283,7 @@ int LuaVoxelManip::l_set_light_data(lua_State *L)
 {
 	NO_MAP_LOCK_REQUIRED;
 
-	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	LuaVoxelManip *o = checkMutable(L, 1);
 	MMVManip *vm = o->vm;
 
 	if (!lua_istable(L, 2))
@@ -329,7 +332,7 @@ int LuaVoxelManip::l_set_param2_data(lua_State *L)
 {
 	NO_MAP_LOCK_REQUIRED;
 
-	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	LuaVoxelManip *o = checkMutable(L, 1);
 	MMVManip *vm = o->vm;
 
 	if (!lua_istable(L, 2))
@@ -349,6 +352,54 @@ int LuaVoxelManip::l_set_param2_data(lua_State *L)
 	return 0;
 }
 
+int LuaVoxelManip::l_get_buffer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	std::string field = readParam<std::string>(L, 2, "content");
+
+	LuaVoxelManipBuffer::Field f;
+	if (field == "content")
+		f = LuaVoxelManipBuffer::FIELD_CONTENT;
+	else if (field == "light" || field == "param1")
+		f = LuaVoxelManipBuffer::FIELD_PARAM1;
+	else if (field == "param2")
+		f = LuaVoxelManipBuffer::FIELD_PARAM2;
+	else
+		throw LuaError("VoxelManip:get_buffer: invalid field \"" + field + "\"");
+
+	LuaVoxelManipBuffer::create(L, 1, f, 0, o->vm->m_area.getVolume());
+	return 1;
+}
+
+int LuaVoxelManip::l_snapshot(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	if (o->isSnapshot()) {
+		lua_pushvalue(L, 1);
+		return 1;
+	}
+
+	LuaVoxelManip *snapshot = new LuaVoxelManip(
+		std::shared_ptr<MMVManip>(o->vm->clone()));
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = snapshot;
+	luaL_getmetatable(L, className);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+int LuaVoxelManip::l_is_snapshot(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	lua_pushboolean(L, o->isSnapshot());
+	return 1;
+}
+
 int LuaVoxelManip::l_update_map(lua_State *L)
 {
 	return 0;
@@ -398,12 +449,35 @@ LuaVoxelManip::LuaVoxelManip(Map *map, v3s16 p1, v3s16 p2)
 	vm->initialEmerge(bp1, bp2);
 }
 
+LuaVoxelManip::LuaVoxelManip(std::shared_ptr<MMVManip> snapshot) :
+	m_snapshot(std::move(snapshot))
+{
+	vm = m_snapshot.get();
+}
+
 LuaVoxelManip::~LuaVoxelManip()
 {
-	if (!is_mapgen_vm)
+	if (!is_mapgen_vm && !m_snapshot)
 		delete vm;
 }
 
+void LuaVoxelManip::detachMapgenVM()
+{
+	if (!is_mapgen_vm)
+		return;
+
+	is_mapgen_vm = false;
+	vm = MMVManip::createOrphan();
+}
+
+LuaVoxelManip *LuaVoxelManip::checkMutable(lua_State *L, int narg)
+{
+	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, narg);
+	if (o->isSnapshot())
+		throw LuaError("VoxelManip snapshot is read-only");
+	return o;
+}
+
 // LuaVoxelManip()
 // Creates an LuaVoxelManip and leaves it on top of stack
 int LuaVoxelManip::create_object(lua_State *L)
@@ -421,29 +495,52 @@ int LuaVoxelManip::create_object(lua_State *L)
 	return 1;
 }
 
+// Passed between Lua states
+struct PackedVoxelManip
+{
+	// Either an owned copy or the shared data of a snapshot
+	MMVManip *vm = nullptr;
+	std::shared_ptr<MMVManip> snapshot;
+};
+
 void *LuaVoxelManip::packIn(lua_State *L, int idx)
 {
 	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, idx);
 
 	if (o->is_mapgen_vm)
 		throw LuaError("nope");
-	return o->vm->clone();
+
+	PackedVoxelManip *packed = new PackedVoxelManip();
+	// Snapshots are immutable, no need to copy them
+	if (o->isSnapshot())
+		packed->snapshot = o->m_snapshot;
+	else
+		packed->vm = o->vm->clone();
+	return packed;
 }
 
 void LuaVoxelManip::packOut(lua_State *L, void *ptr)
 {
-	MMVManip *vm = reinterpret_cast<MMVManip*>(ptr);
+	PackedVoxelManip *packed = reinterpret_cast<PackedVoxelManip*>(ptr);
 	if (!L) {
-		delete vm;
+		delete packed->vm;
+		delete packed;
 		return;
 	}
 
-	// Associate vmanip with map if the Lua env has one
-	Environment *env = getEnv(L);
-	if (env)
-		vm->reparent(&(env->getMap()));
+	LuaVoxelManip *o;
+	if (packed->snapshot) {
+		o = new LuaVoxelManip(std::move(packed->snapshot));
+	} else {
+		// Associate vmanip with map if the Lua env has one
+		Environment *env = getEnv(L);
+		if (env)
+			packed->vm->reparent(&(env->getMap()));
+
+		o = new LuaVoxelManip(packed->vm, false);
+	}
+	delete packed;
 
-	LuaVoxelManip *o = new LuaVoxelManip(vm, false);
 	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
 	luaL_getmetatable(L, className);
 	lua_setmetatable(L, -2);
@@ -479,7 +576,228 @@ const luaL_Reg LuaVoxelManip::methods[] = {
 	luamethod(LuaVoxelManip, set_light_data),
 	luamethod(LuaVoxelManip, get_param2_data),
 	luamethod(LuaVoxelManip, set_param2_data),
+	luamethod(LuaVoxelManip, get_buffer),
+	luamethod(LuaVoxelManip, snapshot),
+	luamethod(LuaVoxelManip, is_snapshot),
 	luamethod(LuaVoxelManip, was_modified),
 	luamethod(LuaVoxelManip, get_emerged_area),
 	{0,0}
 };
+
+/*
+	LuaVoxelManipBuffer
+*/
+
+int LuaVoxelManipBuffer::gc_object(lua_State *L)
+{
+	LuaVoxelManipBuffer *o = *(LuaVoxelManipBuffer **)(lua_touserdata(L, 1));
+	luaL_unref(L, LUA_REGISTRYINDEX, o->m_vm_ref);
+	delete o;
+
+	return 0;
+}
+
+u32 LuaVoxelManipBuffer::checkIndex(lua_State *L, int idx) const
+{
+	lua_Integer i = luaL_checkinteger(L, idx);
+	if (i < 1 || i > (lua_Integer)m_length)
+		throw LuaError("VoxelManipBuffer: index " + std::to_string(i) +
+			" out of range 1.." + std::to_string(m_length));
+
+	// read_from_map() may have replaced the data
+	if (m_offset + m_length > (u32)m_vmanip->vm->m_area.getVolume())
+		throw LuaError("VoxelManipBuffer: VoxelManip area has changed");
+
+	return m_offset + (u32)i - 1;
+}
+
+lua_Integer LuaVoxelManipBuffer::getValue(u32 i) const
+{
+	const MapNode &n = m_vmanip->vm->m_data[i];
+	switch (m_field) {
+	case FIELD_CONTENT:
+		return n.getContent();
+	case FIELD_PARAM1:
+		return n.param1;
+	default:
+		return n.param2;
+	}
+}
+
+void LuaVoxelManipBuffer::setValue(u32 i, lua_Integer value)
+{
+	MapNode &n = m_vmanip->vm->m_data[i];
+	switch (m_field) {
+	case FIELD_CONTENT:
+		n.setContent(value);
+		break;
+	case FIELD_PARAM1:
+		n.param1 = value;
+		break;
+	default:
+		n.param2 = value;
+		break;
+	}
+}
+
+// __index: buf[i], or a method
+int LuaVoxelManipBuffer::l_index(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkObject<LuaVoxelManipBuffer>(L, 1);
+	if (lua_type(L, 2) == LUA_TNUMBER) {
+		lua_pushinteger(L, o->getValue(o->checkIndex(L, 2)));
+		return 1;
+	}
+
+	lua_pushvalue(L, 2);
+	lua_rawget(L, lua_upvalueindex(1));
+	return 1;
+}
+
+// __newindex: buf[i] = value
+int LuaVoxelManipBuffer::l_newindex(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkObject<LuaVoxelManipBuffer>(L, 1);
+	if (o->m_vmanip->isSnapshot())
+		throw LuaError("VoxelManip snapshot is read-only");
+	o->setValue(o->checkIndex(L, 2), luaL_checkinteger(L, 3));
+	return 0;
+}
+
+// __len: #buf
+int LuaVoxelManipBuffer::l_len(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkObject<LuaVoxelManipBuffer>(L, 1);
+	lua_pushinteger(L, o->m_length);
+	return 1;
+}
+
+// get(self, i)
+int LuaVoxelManipBuffer::l_get(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkObject<LuaVoxelManipBuffer>(L, 1);
+	lua_pushinteger(L, o->getValue(o->checkIndex(L, 2)));
+	return 1;
+}
+
+// set(self, i, value)
+int LuaVoxelManipBuffer::l_set(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkObject<LuaVoxelManipBuffer>(L, 1);
+	if (o->m_vmanip->isSnapshot())
+		throw LuaError("VoxelManip snapshot is read-only");
+	o->setValue(o->checkIndex(L, 2), luaL_checkinteger(L, 3));
+	return 0;
+}
+
+// slice(self, first, last) -> view of the indices first..last
+int LuaVoxelManipBuffer::l_slice(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkObject<LuaVoxelManipBuffer>(L, 1);
+	lua_Integer first = luaL_checkinteger(L, 2);
+	lua_Integer last = luaL_optinteger(L, 3, o->m_length);
+	if (first < 1 || last > (lua_Integer)o->m_length || first > last + 1)
+		throw LuaError("VoxelManipBuffer:slice: invalid range");
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, o->m_vm_ref);
+	create(L, lua_gettop(L), o->m_field, o->m_offset + first - 1,
+		last - first + 1);
+	return 1;
+}
+
+// get_pointer(self) -> pointer to the first value, stride in bytes
+int LuaVoxelManipBuffer::l_get_pointer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkObject<LuaVoxelManipBuffer>(L, 1);
+	// The pointer could be written through, the data of snapshots is shared
+	if (o->m_vmanip->isSnapshot())
+		throw LuaError("VoxelManip snapshot is read-only");
+
+	MMVManip *vm = o->m_vmanip->vm;
+	if (o->m_length == 0 || o->m_offset + o->m_length > (u32)vm->m_area.getVolume())
+		return 0;
+
+	size_t field_offset;
+	switch (o->m_field) {
+	case FIELD_CONTENT:
+		field_offset = offsetof(MapNode, param0);
+		break;
+	case FIELD_PARAM1:
+		field_offset = offsetof(MapNode, param1);
+		break;
+	default:
+		field_offset = offsetof(MapNode, param2);
+		break;
+	}
+
+	u8 *p = reinterpret_cast<u8 *>(&vm->m_data[o->m_offset]) + field_offset;
+	lua_pushlightuserdata(L, p);
+	lua_pushinteger(L, sizeof(MapNode));
+	return 2;
+}
+
+LuaVoxelManipBuffer::LuaVoxelManipBuffer(int vm_ref, LuaVoxelManip *vmanip,
+		Field field, u32 offset, u32 length) :
+	m_vm_ref(vm_ref),
+	m_vmanip(vmanip),
+	m_field(field),
+	m_offset(offset),
+	m_length(length)
+{
+}
+
+void LuaVoxelManipBuffer::create(lua_State *L, int vm_idx, Field field,
+		u32 offset, u32 length)
+{
+	LuaVoxelManip *vmanip = checkObject<LuaVoxelManip>(L, vm_idx);
+	lua_pushvalue(L, vm_idx);
+	int vm_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	LuaVoxelManipBuffer *o = new LuaVoxelManipBuffer(vm_ref, vmanip, field,
+		offset, length);
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, className);
+	lua_setmetatable(L, -2);
+}
+
+void LuaVoxelManipBuffer::Register(lua_State *L)
+{
+	static const luaL_Reg metamethods[] = {
+		{"__gc", gc_object},
+		{"__newindex", l_newindex},
+		{"__len", l_len},
+		{0, 0}
+	};
+	registerClass(L, className, methods, metamethods);
+
+	// Numeric indices read the data, everything else looks up the methods
+	luaL_getmetatable(L, className);
+	lua_getfield(L, -1, "__index");
+	lua_pushcclosure(L, l_index, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+}
+
+const char LuaVoxelManipBuffer::className[] = "VoxelManipBuffer";
+const luaL_Reg LuaVoxelManipBuffer::methods[] = {
+	luamethod(LuaVoxelManipBuffer, get),
+	luamethod(LuaVoxelManipBuffer, set),
+	luamethod(LuaVoxelManipBuffer, len),
+	luamethod(LuaVoxelManipBuffer, slice),
+	luamethod(LuaVoxelManipBuffer, get_pointer),
+	{0,0}
+};
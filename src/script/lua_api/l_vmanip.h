@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include <memory>
 #include "irr_v3d.h"
 #include "lua_api/l_base.h"
 
@@ -33,6 +34,8 @@ class LuaVoxelManip : public ModApiBase
 {
 private:
 	bool is_mapgen_vm = false;
+	// Immutable data, possibly shared with other Lua states
+	std::shared_ptr<MMVManip> m_snapshot;
 
 	static const luaL_Reg methods[];
 
@@ -57,6 +60,10 @@ class LuaVoxelManip : public ModApiBase
 	static int l_get_param2_data(lua_State *L);
 	static int l_set_param2_data(lua_State *L);
 
+	static int l_get_buffer(lua_State *L);
+	static int l_snapshot(lua_State *L);
+	static int l_is_snapshot(lua_State *L);
+
 	static int l_was_modified(lua_State *L);
 	static int l_get_emerged_area(lua_State *L);
 
@@ -66,8 +73,17 @@ class LuaVoxelManip : public ModApiBase
 	LuaVoxelManip(MMVManip *mmvm, bool is_mapgen_vm);
 	LuaVoxelManip(Map *map, v3s16 p1, v3s16 p2);
 	LuaVoxelManip(Map *map);
+	LuaVoxelManip(std::shared_ptr<MMVManip> snapshot);
 	~LuaVoxelManip();
 
+	bool isSnapshot() const { return !!m_snapshot; }
+
+	// Replaces a mapgen VoxelManip by an empty one once the chunk is done
+	void detachMapgenVM();
+
+	// Like checkObject, but raises an error for read-only snapshots
+	static LuaVoxelManip *checkMutable(lua_State *L, int narg);
+
 	// LuaVoxelManip()
 	// Creates a LuaVoxelManip and leaves it on top of stack
 	static int create_object(lua_State *L);
@@ -79,3 +95,54 @@ class LuaVoxelManip : public ModApiBase
 
 	static const char className[];
 };
+
+/*
+  VoxelManipBuffer: view of one field of a VoxelManip's data, without copying
+ */
+class LuaVoxelManipBuffer : public ModApiBase
+{
+public:
+	enum Field : u8 {
+		FIELD_CONTENT,
+		FIELD_PARAM1,
+		FIELD_PARAM2,
+	};
+
+private:
+	static const luaL_Reg methods[];
+
+	static int gc_object(lua_State *L);
+	static int l_index(lua_State *L);
+	static int l_newindex(lua_State *L);
+	static int l_len(lua_State *L);
+
+	static int l_get(lua_State *L);
+	static int l_set(lua_State *L);
+	static int l_slice(lua_State *L);
+	static int l_get_pointer(lua_State *L);
+
+	// Returns the index into MMVManip::m_data for the 1-based index at idx
+	u32 checkIndex(lua_State *L, int idx) const;
+	lua_Integer getValue(u32 i) const;
+	void setValue(u32 i, lua_Integer value);
+
+	// Keeps the VoxelManip userdata alive
+	int m_vm_ref;
+	LuaVoxelManip *m_vmanip;
+	Field m_field;
+	u32 m_offset;
+	u32 m_length;
+
+public:
+	LuaVoxelManipBuffer(int vm_ref, LuaVoxelManip *vmanip, Field field,
+			u32 offset, u32 length);
+
+	// Creates a buffer viewing the VoxelManip at vm_idx and leaves it on
+	// top of stack
+	static void create(lua_State *L, int vm_idx, Field field,
+			u32 offset, u32 length);
+
+	static void Register(lua_State *L);
+
+	static const char className[];
+};
@@ -0,0 +1,90 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "scripting_emerge.h"
+#include "server.h"
+#include "settings.h"
+#include "filesys.h"
+#include "cpp_api/s_internal.h"
+#include "common/c_packer.h"
+#include "lua_api/l_base.h"
+#include "lua_api/l_craft.h"
+#include "lua_api/l_item.h"
+#include "lua_api/l_mapgen.h"
+#include "lua_api/l_noise.h"
+#include "lua_api/l_server.h"
+#include "lua_api/l_settings.h"
+#include "lua_api/l_util.h"
+#include "lua_api/l_vmanip.h"
+
+EmergeScripting::EmergeScripting(Server *server):
+		ScriptApiBase(ScriptingType::Emerge)
+{
+	setGameDef(server);
+
+	SCRIPTAPI_PRECHECKHEADER
+
+	if (g_settings->getBool("secure.enable_security"))
+		initializeSecurity();
+
+	lua_getglobal(L, "core");
+	int top = lua_gettop(L);
+
+	InitializeModApi(L, top);
+	lua_pop(L, 1);
+
+	// Push builtin initialization type
+	lua_pushstring(L, "emerge");
+	lua_setglobal(L, "INIT");
+}
+
+void EmergeScripting::loadScripts()
+{
+	loadMod(Server::getBuiltinLuaPath() + DIR_DELIM + "init.lua",
+		BUILTIN_MOD_NAME);
+	checkSetByBuiltin();
+
+	for (const auto &it : getServer()->m_mapgen_init_files)
+		loadMod(it.second, it.first);
+}
+
+void EmergeScripting::InitializeModApi(lua_State *L, int top)
+{
+	// classes
+	LuaItemStack::Register(L);
+	LuaPerlinNoise::Register(L);
+	LuaPerlinNoiseMap::Register(L);
+	LuaPseudoRandom::Register(L);
+	LuaPcgRandom::Register(L);
+	LuaSecureRandom::Register(L);
+	LuaVoxelManip::Register(L);
+	LuaVoxelManipBuffer::Register(L);
+	LuaSettings::Register(L);
+
+	// globals data, the same as for the async environment
+	auto *data = ModApiBase::getServer(L)->m_async_globals_data.get();
+	script_unpack(L, data);
+	lua_setfield(L, top, "transferred_globals");
+
+	ModApiUtil::InitializeAsync(L, top);
+	ModApiCraft::InitializeAsync(L, top);
+	ModApiItemMod::InitializeAsync(L, top);
+	ModApiServer::InitializeAsync(L, top);
+	ModApiMapgen::InitializeEmerge(L, top);
+}
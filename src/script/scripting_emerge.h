@@ -0,0 +1,48 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+#include "cpp_api/s_base.h"
+#include "cpp_api/s_mapgen.h"
+#include "cpp_api/s_security.h"
+
+/*****************************************************************************/
+/* Scripting <-> Emerge Thread Interface                                     */
+/*****************************************************************************/
+
+/*
+	Lua state owned by one emerge thread ("mapgen environment").
+	Like the async environment it has no access to the map, it only sees
+	the chunk being generated. Scripts are registered by mods using
+	core.register_mapgen_script().
+*/
+class EmergeScripting:
+		virtual public ScriptApiBase,
+		public ScriptApiMapgen,
+		public ScriptApiSecurity
+{
+public:
+	EmergeScripting(Server *server);
+
+	// Loads builtin and the registered mapgen scripts, throws ModError
+	void loadScripts();
+
+private:
+	void InitializeModApi(lua_State *L, int top);
+};
@@ -145,6 +145,7 @@ void ServerScripting::InitializeModApi(lua_State *L, int top)
 	LuaRaycast::Register(L);
 	LuaSecureRandom::Register(L);
 	LuaVoxelManip::Register(L);
+	LuaVoxelManipBuffer::Register(L);
 	NodeMetaRef::Register(L);
 	NodeTimerRef::Register(L);
 	ObjectRef::Register(L);
@@ -179,6 +180,7 @@ void ServerScripting::InitializeAsync(lua_State *L, int top)
 	LuaPcgRandom::Register(L);
 	LuaSecureRandom::Register(L);
 	LuaVoxelManip::Register(L);
+	LuaVoxelManipBuffer::Register(L);
 	LuaSettings::Register(L);
 
 	// globals data
@@ -65,6 +65,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "remoteplayer.h"
 #include "server/player_sao.h"
 #include "server/serverinventorymgr.h"
+#include "server/packet_workers.h"
 #include "translation.h"
 #include "database/database-sqlite3.h"
 #if USE_POSTGRESQL
@@ -300,6 +301,8 @@ Server::Server(
 			"minetest_core_map_edit_events",
 			"Number of map edit events");
 
+	m_craftdef->setMetricsBackend(m_metrics_backend.get());
+
 	m_lag_gauge->set(g_settings->getFloat("dedicated_server_step"));
 }
 
@@ -482,6 +485,10 @@ void Server::init()
 	// init the recipe hashes to speed up crafting
 	m_craftdef->initHashes(this);
 
+	// Definitions are final now, compress them ahead of the first join
+	getCompressedItemDef(LATEST_PROTOCOL_VERSION);
+	getCompressedNodeDef(LATEST_PROTOCOL_VERSION);
+
 	// Initialize Environment
 	m_startup_server_map = nullptr; // Ownership moved to ServerEnvironment
 	m_env = new ServerEnvironment(servermap, m_script, this,
@@ -519,6 +526,10 @@ void Server::init()
 	m_max_chatmessage_length = g_settings->getU16("chat_message_max_size");
 	m_csm_restriction_flags = g_settings->getU64("csm_restriction_flags");
 	m_csm_restriction_noderange = g_settings->getU32("csm_restriction_noderange");
+
+	u16 packet_threads = g_settings->getU16("num_packet_worker_threads");
+	if (packet_threads > 0)
+		m_packet_workers = std::make_unique<PacketWorkerPool>(this, packet_threads);
 }
 
 void Server::start()
@@ -535,7 +546,9 @@ void Server::start()
 	m_con->SetTimeoutMs(30);
 	m_con->Serve(m_bind_addr);
 
-	// Start thread
+	// Start threads
+	if (m_packet_workers)
+		m_packet_workers->start();
 	m_thread->start();
 
 	// ASCII art for the win!
@@ -560,6 +573,8 @@ void Server::stop()
 	// Stop threads (set run=false first so both start stopping)
 	m_thread->stop();
 	m_thread->wait();
+	if (m_packet_workers)
+		m_packet_workers->stop();
 
 	infostream<<"Server: Threads stopped"<<std::endl;
 }
@@ -635,8 +650,26 @@ void Server::AsyncRunStep(bool initial_step)
 		m_timeofday_gauge->set(time);
 	}
 
+	// Movement messages are only queued for the protocols in use
+	bool legacy_movement = false, delta_movement = false;
+	{
+		ClientInterface::AutoLock clientlock(m_clients);
+		for (const auto &client_it : m_clients.getClientList()) {
+			u16 proto = client_it.second->net_proto_version;
+			// Not known before the client sent TOSERVER_INIT
+			if (proto == 0)
+				continue;
+			if (proto >= 42)
+				delta_movement = true;
+			else
+				legacy_movement = true;
+		}
+	}
+
 	{
 		MutexAutoLock lock(m_env_mutex);
+		m_env->setMovementMessageKinds(legacy_movement, delta_movement);
+
 		// Figure out and report maximum lag to environment
 		float max_lag = m_env->getMaxLagEstimate();
 		max_lag *= 0.9998; // Decrease slowly (about half per 5 minutes)
@@ -844,15 +877,24 @@ void Server::AsyncRunStep(bool initial_step)
 					// Go through every message
 					for (const ActiveObjectMessage &aom : *list) {
 						// Send position updates to players who do not see the attachment
-						if (aom.datastring[0] == AO_CMD_UPDATE_POSITION) {
+						u8 cmd = aom.datastring[0];
+						if (cmd == AO_CMD_UPDATE_POSITION || cmd == AO_CMD_UPDATE_MOVEMENT) {
+							// Only one of both is sent, depending on the protocol
+							if ((cmd == AO_CMD_UPDATE_MOVEMENT) !=
+									(client->net_proto_version >= 42))
+								continue;
+
 							if (sao->getId() == player->getId())
 								continue;
 
 							// Do not send position updates for attached players
-							// as long the parent is known to the client
+							// as long the parent is known to the client.
+							// Keyframes are still needed as reference for later deltas.
 							ServerActiveObject *parent = sao->getParent();
 							if (parent && client->m_known_objects.find(parent->getId()) !=
-									client->m_known_objects.end())
+									client->m_known_objects.end() &&
+									!(cmd == AO_CMD_UPDATE_MOVEMENT &&
+									ObjectMovement::isKeyframe(aom.datastring)))
 								continue;
 						}
 
@@ -1006,9 +1048,7 @@ void Server::AsyncRunStep(bool initial_step)
 	{
 		float &counter = m_savemap_timer;
 		counter += dtime;
-		static thread_local const float save_interval =
-			g_settings->getFloat("server_map_save_interval");
-		if (counter >= save_interval) {
+		if (counter >= m_cache_save_interval.get()) {
 			counter = 0.0;
 			MutexAutoLock lock(m_env_mutex);
 
@@ -1036,11 +1076,25 @@ void Server::AsyncRunStep(bool initial_step)
 void Server::Receive()
 {
 	NetworkPacket pkt;
-	session_t peer_id;
 	bool first = true;
 	for (;;) {
+		if (m_packet_workers) {
+			// Peers denied by a packet worker
+			std::vector<session_t> denied = m_packet_workers->takeDisconnects();
+			if (!denied.empty()) {
+				MutexAutoLock envlock(m_env_mutex);
+				for (session_t peer_id : denied) {
+					m_clients.event(peer_id, CSE_SetDenied);
+					DisconnectPeer(peer_id);
+				}
+			}
+
+			// Packets that had to wait for a packet worker of their peer
+			for (auto &ready : m_packet_workers->takeReadyPackets())
+				ProcessPacket(ready.get());
+		}
+
 		pkt.clear();
-		peer_id = 0;
 		try {
 			/*
 				In the first iteration *wait* for a packet, afterwards process
@@ -1053,26 +1107,39 @@ void Server::Receive()
 				if (!m_con->TryReceive(&pkt))
 					return;
 			}
-
-			peer_id = pkt.getPeerId();
-			m_packet_recv_counter->increment();
-			ProcessData(&pkt);
-			m_packet_recv_processed_counter->increment();
-		} catch (const con::InvalidIncomingDataException &e) {
-			infostream << "Server::Receive(): InvalidIncomingDataException: what()="
-					<< e.what() << std::endl;
-		} catch (const SerializationError &e) {
-			infostream << "Server::Receive(): SerializationError: what()="
-					<< e.what() << std::endl;
-		} catch (const ClientStateError &e) {
-			errorstream << "ProcessData: peer=" << peer_id << " what()="
-					 << e.what() << std::endl;
-			DenyAccess(peer_id, SERVER_ACCESSDENIED_UNEXPECTED_DATA);
-		} catch (const con::PeerNotFoundException &e) {
-			// Do nothing
 		} catch (const con::NoIncomingDataException &e) {
 			return;
 		}
+
+		m_packet_recv_counter->increment();
+		if (m_packet_workers && m_packet_workers->dispatch(pkt))
+			continue;
+		ProcessPacket(&pkt);
+	}
+}
+
+void Server::ProcessPacket(NetworkPacket *pkt)
+{
+	session_t peer_id = pkt->getPeerId();
+	try {
+		ProcessData(pkt);
+		m_packet_recv_processed_counter->increment();
+	} catch (const con::InvalidIncomingDataException &e) {
+		infostream << "Server::Receive(): InvalidIncomingDataException: what()="
+				<< e.what() << std::endl;
+	} catch (const SerializationError &e) {
+		infostream << "Server::Receive(): SerializationError: what()="
+				<< e.what() << std::endl;
+	} catch (const ClientStateError &e) {
+		errorstream << "ProcessData: peer=" << peer_id << " what()="
+				 << e.what() << std::endl;
+		DenyAccess(peer_id, SERVER_ACCESSDENIED_UNEXPECTED_DATA);
+	} catch (const con::PeerNotFoundException &e) {
+		// Do nothing
+	} catch (const ClientNotFoundException &e) {
+		// Packet workers can lag behind the removal of a client
+		infostream << "Server::Receive(): Client of peer " << peer_id
+				<< " is gone" << std::endl;
 	}
 }
 
@@ -1157,8 +1224,11 @@ inline void Server::handleCommand(NetworkPacket *pkt)
 
 void Server::ProcessData(NetworkPacket *pkt)
 {
-	// Environment is locked first.
-	MutexAutoLock envlock(m_env_mutex);
+	// Environment is locked first, except for the concurrent handlers
+	// run by the packet workers.
+	MutexAutoLock envlock(m_env_mutex, std::defer_lock);
+	if (!m_packet_workers || !m_packet_workers->isWorkerThread())
+		envlock.lock();
 
 	ScopeProfiler sp(g_profiler, "Server: Process network packet (sum)");
 	u32 peer_id = pkt->getPeerId();
@@ -1203,7 +1273,16 @@ void Server::ProcessData(NetworkPacket *pkt)
 			return;
 		}
 
-		u8 peer_ser_ver = getClient(peer_id, CS_InitDone)->serialization_version;
+		// Copied under the client lock, packet workers don't hold the
+		// environment lock which keeps DeleteClient from running
+		u8 peer_ser_ver;
+		{
+			ClientInterface::AutoLock clientlock(m_clients);
+			RemoteClient *client = m_clients.lockedGetClientNoEx(peer_id, CS_InitDone);
+			if (!client)
+				throw ClientNotFoundException("Client not found");
+			peer_ser_ver = client->serialization_version;
+		}
 
 		if(peer_ser_ver == SER_FMT_VER_INVALID) {
 			errorstream << "Server::ProcessData(): Cancelling: Peer"
@@ -1436,8 +1515,35 @@ void Server::SendDeathscreen(session_t peer_id, bool set_camera_point_target,
 	Send(&pkt);
 }
 
-void Server::SendItemDef(session_t peer_id,
-		IItemDefManager *itemdef, u16 protocol_version)
+const std::string &Server::getCompressedItemDef(u16 protocol_version)
+{
+	auto it = m_itemdef_cache.find(protocol_version);
+	if (it != m_itemdef_cache.end())
+		return it->second;
+
+	std::ostringstream tmp_os(std::ios::binary);
+	m_itemdef->serialize(tmp_os, protocol_version);
+	std::ostringstream tmp_os2(std::ios::binary);
+	compressZlib(tmp_os.str(), tmp_os2);
+
+	return m_itemdef_cache[protocol_version] = tmp_os2.str();
+}
+
+const std::string &Server::getCompressedNodeDef(u16 protocol_version)
+{
+	auto it = m_nodedef_cache.find(protocol_version);
+	if (it != m_nodedef_cache.end())
+		return it->second;
+
+	std::ostringstream tmp_os(std::ios::binary);
+	m_nodedef->serialize(tmp_os, protocol_version);
+	std::ostringstream tmp_os2(std::ios::binary);
+	compressZlib(tmp_os.str(), tmp_os2);
+
+	return m_nodedef_cache[protocol_version] = tmp_os2.str();
+}
+
+void Server::SendItemDef(session_t peer_id, u16 protocol_version)
 {
 	NetworkPacket pkt(TOCLIENT_ITEMDEF, 0, peer_id);
 
@@ -1446,11 +1552,7 @@ void Server::SendItemDef(session_t peer_id,
 		u32 length of the next item
 		zlib-compressed serialized ItemDefManager
 	*/
-	std::ostringstream tmp_os(std::ios::binary);
-	itemdef->serialize(tmp_os, protocol_version);
-	std::ostringstream tmp_os2(std::ios::binary);
-	compressZlib(tmp_os.str(), tmp_os2);
-	pkt.putLongString(tmp_os2.str());
+	pkt.putLongString(getCompressedItemDef(protocol_version));
 
 	// Make data buffer
 	verbosestream << "Server: Sending item definitions to id(" << peer_id
@@ -1459,8 +1561,7 @@ void Server::SendItemDef(session_t peer_id,
 	Send(&pkt);
 }
 
-void Server::SendNodeDef(session_t peer_id,
-	const NodeDefManager *nodedef, u16 protocol_version)
+void Server::SendNodeDef(session_t peer_id, u16 protocol_version)
 {
 	NetworkPacket pkt(TOCLIENT_NODEDEF, 0, peer_id);
 
@@ -1469,12 +1570,7 @@ void Server::SendNodeDef(session_t peer_id,
 		u32 length of the next item
 		zlib-compressed serialized NodeDefManager
 	*/
-	std::ostringstream tmp_os(std::ios::binary);
-	nodedef->serialize(tmp_os, protocol_version);
-	std::ostringstream tmp_os2(std::ios::binary);
-	compressZlib(tmp_os.str(), tmp_os2);
-
-	pkt.putLongString(tmp_os2.str());
+	pkt.putLongString(getCompressedNodeDef(protocol_version));
 
 	// Make data buffer
 	verbosestream << "Server: Sending node definitions to id(" << peer_id
@@ -1556,8 +1652,8 @@ void Server::SendShowFormspecMessage(session_t peer_id, const std::string &forms
 void Server::SendSpawnParticle(session_t peer_id, u16 protocol_version,
 	const ParticleParameters &p)
 {
-	static thread_local const float radius =
-			g_settings->getS16("max_block_send_distance") * MAP_BLOCKSIZE * BS;
+	const float radius =
+			m_cache_max_block_send_distance.get() * MAP_BLOCKSIZE * BS;
 
 	if (peer_id == PEER_ID_INEXISTENT) {
 		std::vector<session_t> clients = m_clients.getClientIDs();
@@ -1599,8 +1695,8 @@ void Server::SendSpawnParticle(session_t peer_id, u16 protocol_version,
 void Server::SendAddParticleSpawner(session_t peer_id, u16 protocol_version,
 	const ParticleSpawnerParameters &p, u16 attached_id, u32 id)
 {
-	static thread_local const float radius =
-			g_settings->getS16("max_block_send_distance") * MAP_BLOCKSIZE * BS;
+	const float radius =
+			m_cache_max_block_send_distance.get() * MAP_BLOCKSIZE * BS;
 
 	if (peer_id == PEER_ID_INEXISTENT) {
 		std::vector<session_t> clients = m_clients.getClientIDs();
@@ -2002,16 +2098,16 @@ void Server::SendPlayerFormspecPrepend(session_t peer_id)
 void Server::SendActiveObjectRemoveAdd(RemoteClient *client, PlayerSAO *playersao)
 {
 	// Radius inside which objects are active
-	static thread_local const s16 radius =
-		g_settings->getS16("active_object_send_range_blocks") * MAP_BLOCKSIZE;
+	const s16 radius =
+		m_cache_active_object_send_range.get() * MAP_BLOCKSIZE;
 
 	// Radius inside which players are active
 	static thread_local const bool is_transfer_limited =
 		g_settings->exists("unlimited_player_transfer_distance") &&
 		!g_settings->getBool("unlimited_player_transfer_distance");
 
-	static thread_local const s16 player_transfer_dist =
-		g_settings->getS16("player_transfer_distance") * MAP_BLOCKSIZE;
+	const s16 player_transfer_dist =
+		m_cache_player_transfer_distance.get() * MAP_BLOCKSIZE;
 
 	s16 player_radius = player_transfer_dist == 0 && is_transfer_limited ?
 		radius : player_transfer_dist;
@@ -2360,7 +2456,7 @@ void Server::sendMetadataChanged(const std::unordered_set<v3s16> &positions, flo
 void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
 		u16 net_proto_version, SerializedBlockCache *cache)
 {
-	thread_local const int net_compression_level = rangelim(g_settings->getS16("map_compression_level_net"), -1, 9);
+	const int net_compression_level = rangelim(m_cache_compression_level_net.get(), -1, 9);
 	std::string s, *sptr = nullptr;
 
 	if (cache) {
@@ -2425,8 +2521,8 @@ void Server::SendBlocks(float dtime)
 
 	// Maximal total count calculation
 	// The per-client block sends is halved with the maximal online users
-	u32 max_blocks_to_send = (m_env->getPlayerCount() + g_settings->getU32("max_users")) *
-		g_settings->getU32("max_simultaneous_block_sends_per_client") / 4 + 1;
+	u32 max_blocks_to_send = (m_env->getPlayerCount() + m_cache_max_users.get()) *
+		m_cache_max_block_sends.get() / 4 + 1;
 
 	ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Send to clients");
 	Map &map = m_env->getMap();
@@ -2526,6 +2622,7 @@ bool Server::addMediaFile(const std::string &filename,
 
 	// Put in list
 	m_media[filename] = MediaInfo(filepath, sha1_base64);
+	m_media_announcement_cache.clear();
 	verbosestream << "Server: " << sha1_hex << " is " << filename
 			<< std::endl;
 
@@ -2567,37 +2664,68 @@ void Server::fillMediaCache()
 	infostream << "Server: " << m_media.size() << " media files collected" << std::endl;
 }
 
-void Server::sendMediaAnnouncement(session_t peer_id, const std::string &lang_code)
+const std::string &Server::getMediaAnnouncement(const std::string &lang_code)
 {
-	// Make packet
-	NetworkPacket pkt(TOCLIENT_ANNOUNCE_MEDIA, 0, peer_id);
-
-	u16 media_sent = 0;
 	std::string lang_suffix;
 	lang_suffix.append(".").append(lang_code).append(".tr");
+
+	// The language code comes from the client. All languages without
+	// translation files get the same announcement, so they share one cache
+	// entry and made-up language codes can't grow the cache.
+	bool has_translations = false;
 	for (const auto &i : m_media) {
-		if (i.second.no_announce)
-			continue;
-		if (str_ends_with(i.first, ".tr") && !str_ends_with(i.first, lang_suffix))
-			continue;
-		media_sent++;
+		if (!i.second.no_announce && str_ends_with(i.first, lang_suffix)) {
+			has_translations = true;
+			break;
+		}
 	}
+	if (!has_translations)
+		lang_suffix.clear();
 
-	pkt << media_sent;
+	auto it = m_media_announcement_cache.find(lang_suffix);
+	if (it != m_media_announcement_cache.end())
+		return it->second;
 
+	u16 media_sent = 0;
+	std::ostringstream os(std::ios::binary);
 	for (const auto &i : m_media) {
 		if (i.second.no_announce)
 			continue;
-		if (str_ends_with(i.first, ".tr") && !str_ends_with(i.first, lang_suffix))
+		if (str_ends_with(i.first, ".tr") &&
+				(lang_suffix.empty() || !str_ends_with(i.first, lang_suffix)))
 			continue;
-		pkt << i.first << i.second.sha1_digest;
+		os << serializeString16(i.first) << serializeString16(i.second.sha1_digest);
+		media_sent++;
 	}
 
+	std::string &announcement = m_media_announcement_cache[lang_suffix];
+	announcement.resize(2);
+	writeU16((u8 *)&announcement[0], media_sent);
+	announcement.append(os.str());
+	return announcement;
+}
+
+void Server::sendMediaAnnouncement(session_t peer_id, const std::string &lang_code)
+{
+	// Make packet
+	NetworkPacket pkt(TOCLIENT_ANNOUNCE_MEDIA, 0, peer_id);
+
+	/*
+		u16 number of files
+		for each file:
+			u16 length of name, string name
+			u16 length of digest, string sha1_digest (base64)
+		u16 length of URL, string remote_media
+	*/
+	const std::string &announcement = getMediaAnnouncement(lang_code);
+	pkt.putRawString(announcement);
+
 	pkt << g_settings->get("remote_media");
 	Send(&pkt);
 
 	verbosestream << "Server: Announcing files to id(" << peer_id
-		<< "): count=" << media_sent << " size=" << pkt.getSize() << std::endl;
+		<< "): count=" << readU16((const u8 *)announcement.data())
+		<< " size=" << pkt.getSize() << std::endl;
 }
 
 struct SendableMedia
@@ -2826,6 +2954,13 @@ void Server::DenyAccess(session_t peer_id, AccessDeniedCode reason,
 		const std::string &custom_reason, bool reconnect)
 {
 	SendAccessDenied(peer_id, reason, custom_reason, reconnect);
+
+	// The rest touches the environment, leave it to the server thread
+	if (m_packet_workers && m_packet_workers->isWorkerThread()) {
+		m_packet_workers->deferDisconnect(peer_id);
+		return;
+	}
+
 	m_clients.event(peer_id, CSE_SetDenied);
 	DisconnectPeer(peer_id);
 }
@@ -4114,3 +4249,203 @@ bool Server::migrateModStorageDatabase(const GameParams &game_params, const Sett
 
 	return succeeded;
 }
+
+// Progress of --pregenerate in the world directory, to resume it
+#define PREGENERATE_PROGRESS_FILE "pregenerate.txt"
+
+struct PregenerateState
+{
+	std::atomic<u32> pending{0};
+	std::atomic<u32> generated{0};
+	std::atomic<u32> failed{0};
+};
+
+static void pregenerate_callback(v3s16 blockpos, EmergeAction action, void *param)
+{
+	PregenerateState *state = reinterpret_cast<PregenerateState *>(param);
+	if (action == EMERGE_GENERATED)
+		state->generated++;
+	else if (action == EMERGE_CANCELLED || action == EMERGE_ERRORED)
+		state->failed++;
+	state->pending--;
+}
+
+// Parses "(x1,y1,z1) (x2,y2,z2)"
+static bool parse_pregenerate_area(std::string str, v3s16 &minp, v3s16 &maxp)
+{
+	for (char &c : str) {
+		if (c == '(' || c == ')' || c == ',')
+			c = ' ';
+	}
+	std::istringstream is(str);
+	s32 v[6];
+	for (s32 &i : v) {
+		if (!(is >> i) || i < -MAX_MAP_GENERATION_LIMIT ||
+				i > MAX_MAP_GENERATION_LIMIT)
+			return false;
+	}
+	std::string rest;
+	if (is >> rest)
+		return false;
+
+	minp = v3s16(v[0], v[1], v[2]);
+	maxp = v3s16(v[3], v[4], v[5]);
+	sortBoxVerticies(minp, maxp);
+	return true;
+}
+
+bool Server::pregenerateMap(const GameParams &game_params,
+	const Settings &cmd_args, const Address &bind_addr)
+{
+	const std::string area = cmd_args.get("pregenerate");
+	v3s16 minp, maxp;
+	if (!parse_pregenerate_area(area, minp, maxp)) {
+		errorstream << "Invalid area for --pregenerate, expected "
+			"\"(x1,y1,z1) (x2,y2,z2)\"" << std::endl;
+		return false;
+	}
+
+	// Use all cores unless configured otherwise, nothing else is running
+	s16 nthreads = g_settings->getS16("num_emerge_threads");
+	if (nthreads <= 0)
+		nthreads = std::max<s16>(Thread::getNumberOfProcessors(), 1);
+
+	// Only for this run, don't write it to the config file.
+	// Restored on every way out of this function.
+	struct RestoreNumThreads {
+		std::string old_value = g_settings->existsLocal("num_emerge_threads") ?
+			g_settings->get("num_emerge_threads") : "";
+		bool restored = false;
+
+		void restore()
+		{
+			if (restored)
+				return;
+			restored = true;
+			if (old_value.empty())
+				g_settings->remove("num_emerge_threads");
+			else
+				g_settings->set("num_emerge_threads", old_value);
+		}
+		~RestoreNumThreads() { restore(); }
+	} restore_nthreads;
+	g_settings->setS16("num_emerge_threads", nthreads);
+
+	try {
+		Server server(game_params.world_path, game_params.game_spec, false,
+			bind_addr, true);
+		server.init();
+		restore_nthreads.restore();
+
+		EmergeManager *emerge = server.m_emerge;
+		ServerMap *map = &server.m_env->getServerMap();
+		const s16 csize = emerge->mgparams->chunksize;
+
+		// One block per chunk is enough to generate it. Take a block within
+		// the requested area, the chunk itself may extend past the map edge.
+		const v3s16 bpmin = getNodeBlockPos(minp);
+		const v3s16 bpmax = getNodeBlockPos(maxp);
+		const v3s16 cmin = EmergeManager::getContainingChunk(bpmin, csize);
+		std::vector<v3s16> blocks;
+		for (s32 z = cmin.Z; z <= bpmax.Z; z += csize)
+		for (s32 x = cmin.X; x <= bpmax.X; x += csize)
+		for (s32 y = cmin.Y; y <= bpmax.Y; y += csize) {
+			v3s16 p(x, y, z);
+			p.X = rangelim(p.X, bpmin.X, bpmax.X);
+			p.Y = rangelim(p.Y, bpmin.Y, bpmax.Y);
+			p.Z = rangelim(p.Z, bpmin.Z, bpmax.Z);
+			if (!blockpos_over_max_limit(p))
+				blocks.push_back(p);
+		}
+
+		// Resume where a previous run with the same area stopped
+		const std::string progress_path = game_params.world_path +
+			DIR_DELIM PREGENERATE_PROGRESS_FILE;
+		Settings progress;
+		u32 done = 0;
+		if (progress.readConfigFile(progress_path.c_str()) &&
+				progress.get("area") == area &&
+				progress.getS16("chunksize") == csize) {
+			done = std::min<u64>(progress.getU64("chunks_done"), blocks.size());
+			actionstream << "Resuming pregeneration after " << done
+				<< " chunks" << std::endl;
+		}
+		progress.set("area", area);
+		progress.setS16("chunksize", csize);
+
+		actionstream << "Pregenerating " << blocks.size() << " chunks from "
+			<< PP(minp) << " to " << PP(maxp) << std::endl;
+
+		emerge->startThreads();
+
+		// Generate in batches: each batch is written to the database and
+		// unloaded at once, which keeps the memory usage bounded.
+		const u32 batch_size = 16 * nthreads;
+		const u32 done_start = done;
+		const u64 time_start = porting::getTimeMs();
+		u64 last_report = time_start;
+		PregenerateState state;
+		bool &kill = *porting::signal_handler_killstatus();
+
+		while (done < blocks.size() && !kill) {
+			u32 count = std::min<u32>(batch_size, blocks.size() - done);
+			state.pending = count;
+			for (u32 i = done; i < done + count; i++) {
+				if (!emerge->enqueueBlockEmergeEx(blocks[i], PEER_ID_INEXISTENT,
+						BLOCK_EMERGE_ALLOW_GEN | BLOCK_EMERGE_FORCE_QUEUE,
+						pregenerate_callback, &state))
+					state.pending--;
+			}
+			while (state.pending > 0)
+				sleep_ms(10);
+
+			if (!server.m_async_fatal_error.get().empty())
+				break;
+
+			{
+				MutexAutoLock envlock(server.m_env_mutex);
+				// Writes all modified blocks in one transaction
+				map->unloadUnreferencedBlocks();
+			}
+			done += count;
+
+			progress.setU64("chunks_done", done);
+			if (!progress.updateConfigFile(progress_path.c_str()))
+				errorstream << "Failed to write " << progress_path << std::endl;
+
+			u64 now = porting::getTimeMs();
+			if (now - last_report >= 1000 || done == blocks.size()) {
+				actionstream << "Pregenerated " << done << "/" << blocks.size()
+					<< " chunks, " << ((done - done_start) * 1000.0f /
+					std::max<u64>(now - time_start, 1)) << " chunks/s" << std::endl;
+				last_report = now;
+			}
+		}
+
+		emerge->stopThreads();
+
+		const std::string &async_err = server.m_async_fatal_error.get();
+		if (!async_err.empty()) {
+			errorstream << "Pregeneration failed: " << async_err << std::endl;
+			return false;
+		}
+		if (done < blocks.size()) {
+			actionstream << "Pregeneration interrupted, run again to resume"
+				<< std::endl;
+			return true;
+		}
+
+		fs::DeleteSingleFileOrEmptyDirectory(progress_path);
+		actionstream << "Done, " << state.generated << " chunks were generated, "
+			<< (blocks.size() - done_start - state.generated - state.failed)
+			<< " existed already, " << state.failed << " failed" << std::endl;
+	} catch (const ModError &e) {
+		errorstream << "ModError: " << e.what() << std::endl;
+		return false;
+	} catch (const ServerError &e) {
+		errorstream << "ServerError: " << e.what() << std::endl;
+		return false;
+	}
+
+	return true;
+}
@@ -73,6 +73,7 @@ struct Lighting;
 class ServerThread;
 class ServerModManager;
 class ServerInventoryManager;
+class PacketWorkerPool;
 struct PackedValue;
 
 enum ClientDeletionReason {
@@ -197,6 +198,9 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void handleCommand_HaveMedia(NetworkPacket *pkt);
 
 	void ProcessData(NetworkPacket *pkt);
+	// ProcessData() with the error handling for bad client data.
+	// Called by Receive() and by the packet workers.
+	void ProcessPacket(NetworkPacket *pkt);
 
 	void Send(NetworkPacket *pkt);
 	void Send(session_t peer_id, NetworkPacket *pkt);
@@ -277,6 +281,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	IRollbackManager *getRollbackManager() { return m_rollback; }
 	virtual EmergeManager *getEmergeManager() { return m_emerge; }
 	virtual ModStorageDatabase *getModStorageDatabase() { return m_mod_storage_database; }
+	MetricsBackend *getMetricsBackend() { return m_metrics_backend.get(); }
 
 	IWritableItemDefManager* getWritableItemDefManager();
 	NodeDefManager* getWritableNodeDefManager();
@@ -377,9 +382,16 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	static bool migrateModStorageDatabase(const GameParams &game_params,
 			const Settings &cmd_args);
 
+	// Generates the area given by --pregenerate without running the server
+	static bool pregenerateMap(const GameParams &game_params,
+			const Settings &cmd_args, const Address &bind_addr);
+
 	// Lua files registered for init of async env, pair of modname + path
 	std::vector<std::pair<std::string, std::string>> m_async_init_files;
 
+	// Lua files registered for init of the mapgen env, pair of modname + path
+	std::vector<std::pair<std::string, std::string>> m_mapgen_init_files;
+
 	// Data transferred into async envs at init time
 	std::unique_ptr<PackedValue> m_async_globals_data;
 
@@ -435,9 +447,11 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void SendAccessDenied_Legacy(session_t peer_id, const std::wstring &reason);
 	void SendDeathscreen(session_t peer_id, bool set_camera_point_target,
 		v3f camera_point_target);
-	void SendItemDef(session_t peer_id, IItemDefManager *itemdef, u16 protocol_version);
-	void SendNodeDef(session_t peer_id, const NodeDefManager *nodedef,
-		u16 protocol_version);
+	void SendItemDef(session_t peer_id, u16 protocol_version);
+	void SendNodeDef(session_t peer_id, u16 protocol_version);
+	// Serializes and compresses the definitions once per protocol version
+	const std::string &getCompressedItemDef(u16 protocol_version);
+	const std::string &getCompressedNodeDef(u16 protocol_version);
 
 	/* mark blocks not sent for all clients */
 	void SetBlocksNotSent(std::map<v3s16, MapBlock *>& block);
@@ -497,6 +511,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	bool addMediaFile(const std::string &filename, const std::string &filepath,
 			std::string *filedata = nullptr, std::string *digest = nullptr);
 	void fillMediaCache();
+	const std::string &getMediaAnnouncement(const std::string &lang_code);
 	void sendMediaAnnouncement(session_t peer_id, const std::string &lang_code);
 	void sendRequestedMedia(session_t peer_id,
 			const std::vector<std::string> &tosend);
@@ -578,6 +593,15 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	float m_savemap_timer = 0.0f;
 	IntervalLimiter m_map_timer_and_unload_interval;
 
+	// Settings read in every step
+	CachedSetting<float> m_cache_save_interval{"server_map_save_interval"};
+	CachedSetting<s16> m_cache_max_block_send_distance{"max_block_send_distance"};
+	CachedSetting<s16> m_cache_active_object_send_range{"active_object_send_range_blocks"};
+	CachedSetting<s16> m_cache_player_transfer_distance{"player_transfer_distance"};
+	CachedSetting<s16> m_cache_compression_level_net{"map_compression_level_net"};
+	CachedSetting<u32> m_cache_max_users{"max_users"};
+	CachedSetting<u32> m_cache_max_block_sends{"max_simultaneous_block_sends_per_client"};
+
 	// Environment
 	ServerEnvironment *m_env = nullptr;
 
@@ -626,6 +650,9 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// The server mainly operates in this thread
 	ServerThread *m_thread = nullptr;
 
+	// Runs the concurrent packet handlers, null if disabled
+	std::unique_ptr<PacketWorkerPool> m_packet_workers;
+
 	/*
 		Time related stuff
 	*/
@@ -683,6 +710,15 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 
 	// media files known to server
 	std::unordered_map<std::string, MediaInfo> m_media;
+	// serialized TOCLIENT_ANNOUNCE_MEDIA file lists, by translation file
+	// suffix (empty for languages without translations).
+	// Must be cleared whenever m_media changes.
+	std::unordered_map<std::string, std::string> m_media_announcement_cache;
+
+	// zlib-compressed item and node definitions, by protocol version.
+	// Definitions are immutable after mod loading, so these never expire.
+	std::unordered_map<u16, std::string> m_itemdef_cache;
+	std::unordered_map<u16, std::string> m_nodedef_cache;
 
 	// pending dynamic media callbacks, clients inform the server when they have a file fetched
 	std::unordered_map<u32, PendingDynamicMediaCallback> m_pending_dyn_media;
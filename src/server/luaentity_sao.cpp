@@ -107,6 +107,7 @@ void LuaEntitySAO::addedToEnvironment(u32 dtime_s)
 		// Activate entity, supplying serialized state
 		m_env->getScriptIface()->
 			luaentity_Activate(m_id, m_init_state, dtime_s);
+		m_step_mode = m_env->getScriptIface()->luaentity_GetStepMode(m_id);
 	} else {
 		// It's an unknown object
 		// Use entitystring as infotext for debugging
@@ -134,8 +135,54 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 		std::string str = getPropertyPacket();
 		// create message and add to list
 		m_messages_out.emplace(getId(), true, str);
+		// The physics may have changed
+		wakeUp();
 	}
 
+	if (m_attachment_parent_id)
+		wakeUp();
+
+	// Far entities are stepped less often, with the summed up dtime.
+	// Attached entities follow their parent and batched steps share one dtime.
+	u8 lod_tier = 0;
+	if (m_step_mode != LuaEntityStepMode::Batch && !m_attachment_parent_id &&
+			getAttachmentChildIds().empty())
+		lod_tier = m_env->getEntityLodTier(m_base_position);
+
+	if (m_sleeping) {
+		m_sleep_timer += dtime;
+		if (m_sleep_timer < SLEEP_CHECK_INTERVAL) {
+			m_env->reportEntityLod(lod_tier, true);
+			if (send_recommended)
+				sendOutdatedData();
+			return;
+		}
+		// Check whether the entity still rests. Nothing moved meanwhile,
+		// so the time slept is not simulated.
+		m_sleeping = false;
+	}
+	m_env->reportEntityLod(lod_tier, false);
+
+	m_lod_dtime += dtime;
+	m_lod_send_recommended |= send_recommended;
+	// Keep the dtime within what collisionMoveSimple handles
+	if (++m_lod_skipped_steps < (1U << lod_tier) &&
+			m_lod_dtime + dtime <= MAX_LOD_DTIME) {
+		if (send_recommended)
+			sendOutdatedData();
+		return;
+	}
+	dtime = m_lod_dtime;
+	send_recommended = m_lod_send_recommended;
+	m_lod_dtime = 0.0f;
+	m_lod_skipped_steps = 0;
+	m_lod_send_recommended = false;
+
+	// Mods may add the callbacks after activation. This lookup costs no more
+	// than the one of on_step that stepping the entity would do.
+	if (m_registered && m_step_mode == LuaEntityStepMode::None)
+		m_step_mode = m_env->getScriptIface()->luaentity_GetStepMode(m_id);
+
 	// If attached, check that our parent is still there. If it isn't, detach.
 	if (m_attachment_parent_id && !isAttached()) {
 		// This is handled when objects are removed from the map
@@ -145,8 +192,6 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 		sendPosition(false, true);
 	}
 
-	m_last_sent_position_timer += dtime;
-
 	collisionMoveResult moveresult, *moveresult_p = nullptr;
 
 	// Each frame, parent position is copied if the object is attached, otherwise it's calculated normally
@@ -179,6 +224,30 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 			m_velocity += dtime * m_acceleration;
 		}
 
+		m_predictor.step(dtime);
+		if (moveresult_p) {
+			for (const CollisionInfo &info : moveresult.collisions)
+				m_predictor.applyCollision(info.axis, m_base_position);
+		}
+
+		// Entities without on_step only move by physics: once resting on
+		// the ground they do not need to be stepped until something changes.
+		// Part of the simulation LOD, so only if that is enabled.
+		if (m_env->isEntityLodEnabled() &&
+				moveresult_p && moveresult.touching_ground &&
+				m_step_mode == LuaEntityStepMode::None &&
+				m_velocity.getLengthSQ() < 1e-6f &&
+				m_acceleration.X == 0.0f && m_acceleration.Z == 0.0f &&
+				m_acceleration.Y <= 0.0f &&
+				fabs(m_prop.automatic_rotate) <= 0.001f) {
+			m_velocity = v3f();
+			m_sleeping = true;
+			m_sleep_timer = 0.0f;
+			// Clients must have the final position, no update is sent while sleeping
+			if (m_predictor.needsUpdate(m_base_position, m_velocity, 0.01f * BS))
+				sendPosition(false, true);
+		}
+
 		if (m_prop.automatic_face_movement_dir &&
 				(fabs(m_velocity.Z) > 0.001 || fabs(m_velocity.X) > 0.001)) {
 			float target_yaw = atan2(m_velocity.Z, m_velocity.X) * 180 / M_PI
@@ -202,8 +271,20 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 				m_prop.automatic_rotate);
 	}
 
-	if(m_registered) {
-		m_env->getScriptIface()->luaentity_Step(m_id, dtime, moveresult_p);
+	if (m_registered) {
+		switch (m_step_mode) {
+		case LuaEntityStepMode::Single:
+			// on_step was removed, check again in the next step
+			if (!m_env->getScriptIface()->luaentity_Step(m_id, dtime, moveresult_p))
+				m_step_mode = LuaEntityStepMode::None;
+			break;
+		case LuaEntityStepMode::Batch:
+			m_env->getScriptIface()->luaentity_QueueStep(m_id, m_init_name,
+				moveresult_p);
+			break;
+		case LuaEntityStepMode::None:
+			break;
+		}
 	}
 
 	if (!send_recommended)
@@ -211,17 +292,9 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 
 	if(!isAttached())
 	{
-		// TODO: force send when acceleration changes enough?
-		float minchange = 0.2*BS;
-		if(m_last_sent_position_timer > 1.0){
-			minchange = 0.01*BS;
-		} else if(m_last_sent_position_timer > 0.2){
-			minchange = 0.05*BS;
-		}
-		float move_d = m_base_position.getDistanceFrom(m_last_sent_position);
-		move_d += m_last_sent_move_precision;
-		float vel_d = m_velocity.getDistanceFrom(m_last_sent_velocity);
-		if (move_d > minchange || vel_d > minchange ||
+		// Clients extrapolate the movement, only correct them when needed
+		if (m_predictor.needsUpdate(m_base_position, m_velocity,
+					m_env->getEntityPredictionMaxError()) ||
 				std::fabs(m_rotation.X - m_last_sent_rotation.X) > 1.0f ||
 				std::fabs(m_rotation.Y - m_last_sent_rotation.Y) > 1.0f ||
 				std::fabs(m_rotation.Z - m_last_sent_rotation.Z) > 1.0f) {
@@ -269,6 +342,14 @@ std::string LuaEntitySAO::getClientInitializationData(u16 protocol_version)
 	msg_os << serializeString32(generateSetTextureModCommand());
 	message_count++;
 
+	if (protocol_version >= 42) {
+		std::string reference = generateMovementReferenceCommand();
+		if (!reference.empty()) {
+			msg_os << serializeString32(reference);
+			message_count++;
+		}
+	}
+
 	writeU8(os, message_count);
 	std::string serialized = msg_os.str();
 	os.write(serialized.c_str(), serialized.size());
@@ -366,6 +447,7 @@ void LuaEntitySAO::setPos(const v3f &pos)
 {
 	if(isAttached())
 		return;
+	wakeUp();
 	m_base_position = pos;
 	sendPosition(false, true);
 }
@@ -374,6 +456,7 @@ void LuaEntitySAO::moveTo(v3f pos, bool continuous)
 {
 	if(isAttached())
 		return;
+	wakeUp();
 	m_base_position = pos;
 	if(!continuous)
 		sendPosition(true, true);
@@ -419,6 +502,7 @@ u16 LuaEntitySAO::getHP() const
 
 void LuaEntitySAO::setVelocity(v3f velocity)
 {
+	wakeUp();
 	m_velocity = velocity;
 }
 
@@ -429,6 +513,7 @@ v3f LuaEntitySAO::getVelocity()
 
 void LuaEntitySAO::setAcceleration(v3f acceleration)
 {
+	wakeUp();
 	m_acceleration = acceleration;
 }
 
@@ -506,27 +591,22 @@ void LuaEntitySAO::sendPosition(bool do_interpolate, bool is_movement_end)
 	// Send attachment updates instantly to the client prior updating position
 	sendOutdatedData();
 
-	m_last_sent_move_precision = m_base_position.getDistanceFrom(
-			m_last_sent_position);
-	m_last_sent_position_timer = 0;
-	m_last_sent_position = m_base_position;
-	m_last_sent_velocity = m_velocity;
-	//m_last_sent_acceleration = m_acceleration;
 	m_last_sent_rotation = m_rotation;
 
 	float update_interval = m_env->getSendRecommendedInterval();
 
-	std::string str = generateUpdatePositionCommand(
-		m_base_position,
-		m_velocity,
-		m_acceleration,
-		m_rotation,
-		do_interpolate,
-		is_movement_end,
-		update_interval
-	);
-	// create message and add to list
-	m_messages_out.emplace(getId(), false, str);
+	ObjectMovement movement;
+	movement.position = m_base_position;
+	movement.velocity = m_velocity;
+	movement.acceleration = m_acceleration;
+	movement.rotation = m_rotation;
+	movement.do_interpolate = do_interpolate;
+	movement.is_movement_end = is_movement_end;
+	movement.update_interval = update_interval;
+	movement = queueMovementUpdate(movement);
+
+	// Predict from the quantized values, so that their error is corrected too
+	m_predictor.reset(movement.position, movement.velocity, movement.acceleration);
 }
 
 bool LuaEntitySAO::getCollisionBox(aabb3f *toset) const
@@ -22,6 +22,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "unit_sao.h"
 
+enum class LuaEntityStepMode : u8;
+
 class LuaEntitySAO : public UnitSAO
 {
 public:
@@ -65,7 +67,7 @@ class LuaEntitySAO : public UnitSAO
 
 	/* LuaEntitySAO-specific */
 	void setVelocity(v3f velocity);
-	void addVelocity(v3f velocity) { m_velocity += velocity; }
+	void addVelocity(v3f velocity) { m_velocity += velocity; wakeUp(); }
 	v3f getVelocity();
 	void setAcceleration(v3f acceleration);
 	v3f getAcceleration();
@@ -86,6 +88,7 @@ class LuaEntitySAO : public UnitSAO
 
 private:
 	std::string getPropertyPacket();
+	void wakeUp() { m_sleeping = false; }
 	void sendPosition(bool do_interpolate, bool is_movement_end);
 	std::string generateSetTextureModCommand() const;
 	static std::string generateSetSpriteCommand(v2s16 p, u16 num_frames,
@@ -94,14 +97,27 @@ class LuaEntitySAO : public UnitSAO
 	std::string m_init_name;
 	std::string m_init_state;
 	bool m_registered = false;
+	// Set on activation and updated when the callbacks change,
+	// zero is LuaEntityStepMode::None
+	LuaEntityStepMode m_step_mode{};
+
+	// Simulation level of detail, see ServerEnvironment::getEntityLodTier
+	static constexpr float MAX_LOD_DTIME = 0.5f;
+	u8 m_lod_skipped_steps = 0;
+	float m_lod_dtime = 0.0f;
+	bool m_lod_send_recommended = false;
+
+	// Physics-only entity resting on the ground, woken by any change of its
+	// movement and checked again every SLEEP_CHECK_INTERVAL seconds
+	static constexpr float SLEEP_CHECK_INTERVAL = 1.0f;
+	bool m_sleeping = false;
+	float m_sleep_timer = 0.0f;
 
 	v3f m_velocity;
 	v3f m_acceleration;
 
-	v3f m_last_sent_position;
-	v3f m_last_sent_velocity;
+	// What clients extrapolate from the last sent position
+	MovementPredictor m_predictor;
 	v3f m_last_sent_rotation;
-	float m_last_sent_position_timer = 0.0f;
-	float m_last_sent_move_precision = 0.0f;
 	std::string m_current_texture_modifier = "";
 };
@@ -0,0 +1,208 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "packet_workers.h"
+#include "debug.h"
+#include "log.h"
+#include "server.h"
+#include "network/networkpacket.h"
+#include "network/serveropcodes.h"
+#include "threading/thread.h"
+#include "util/container.h"
+#include "util/string.h"
+
+class PacketWorkerThread : public Thread
+{
+public:
+	PacketWorkerThread(PacketWorkerPool *pool, Server *server, u16 id):
+		Thread("PacketWorker" + itos(id)),
+		m_pool(pool),
+		m_server(server)
+	{}
+
+	void push(std::unique_ptr<NetworkPacket> pkt)
+	{
+		m_queue.push_back(std::move(pkt));
+	}
+
+	void stop()
+	{
+		Thread::stop();
+
+		// an empty packet wakes up the thread
+		m_queue.push_back(nullptr);
+	}
+
+	void *run();
+
+private:
+	PacketWorkerPool *m_pool;
+	Server *m_server;
+	MutexedQueue<std::unique_ptr<NetworkPacket>> m_queue;
+};
+
+void *PacketWorkerThread::run()
+{
+	BEGIN_DEBUG_EXCEPTION_HANDLER
+
+	while (!stopRequested()) {
+		std::unique_ptr<NetworkPacket> pkt = m_queue.pop_frontNoEx();
+		if (!pkt)
+			continue;
+
+		session_t peer_id = pkt->getPeerId();
+		m_server->ProcessPacket(pkt.get());
+		m_pool->finished(peer_id);
+	}
+
+	END_DEBUG_EXCEPTION_HANDLER
+
+	return nullptr;
+}
+
+
+PacketWorkerPool::PacketWorkerPool(Server *server, u16 num_threads)
+{
+	sanity_check(num_threads > 0);
+	for (u16 i = 0; i < num_threads; i++)
+		m_threads.emplace_back(new PacketWorkerThread(this, server, i));
+}
+
+PacketWorkerPool::~PacketWorkerPool()
+{
+	stop();
+}
+
+void PacketWorkerPool::start()
+{
+	for (auto &thread : m_threads)
+		thread->start();
+
+	infostream << "Server: Started " << m_threads.size()
+		<< " packet worker threads" << std::endl;
+}
+
+void PacketWorkerPool::stop()
+{
+	for (auto &thread : m_threads)
+		thread->stop();
+	for (auto &thread : m_threads)
+		thread->wait();
+}
+
+bool PacketWorkerPool::isWorkerThread()
+{
+	for (auto &thread : m_threads) {
+		if (thread->isCurrentThread())
+			return true;
+	}
+	return false;
+}
+
+bool PacketWorkerPool::isConcurrent(NetworkPacket *pkt)
+{
+	u16 command = pkt->getCommand();
+	return command < TOSERVER_NUM_MSG_TYPES &&
+		toServerCommandTable[command].concurrent;
+}
+
+void PacketWorkerPool::sendToWorker(PeerQueue &queue,
+	std::unique_ptr<NetworkPacket> pkt)
+{
+	queue.in_flight++;
+	m_threads[pkt->getPeerId() % m_threads.size()]->push(std::move(pkt));
+}
+
+bool PacketWorkerPool::dispatch(NetworkPacket &pkt)
+{
+	bool concurrent = isConcurrent(&pkt);
+
+	MutexAutoLock lock(m_mutex);
+	auto it = m_peers.find(pkt.getPeerId());
+	if (it == m_peers.end()) {
+		if (!concurrent)
+			return false;
+		it = m_peers.emplace(pkt.getPeerId(), PeerQueue()).first;
+	}
+
+	PeerQueue &queue = it->second;
+	std::unique_ptr<NetworkPacket> packet(new NetworkPacket(pkt));
+	if (queue.in_flight > 0 || !queue.held.empty())
+		queue.held.push_back(std::move(packet));
+	else
+		sendToWorker(queue, std::move(packet));
+	return true;
+}
+
+std::vector<std::unique_ptr<NetworkPacket>> PacketWorkerPool::takeReadyPackets()
+{
+	std::vector<std::unique_ptr<NetworkPacket>> ready;
+
+	MutexAutoLock lock(m_mutex);
+	for (auto it = m_peers.begin(); it != m_peers.end();) {
+		PeerQueue &queue = it->second;
+		bool took_any = false;
+		while (queue.in_flight == 0 && !queue.held.empty()) {
+			NetworkPacket *pkt = queue.held.front().get();
+			if (isConcurrent(pkt)) {
+				// Must not overtake the packets we are about to return
+				if (took_any)
+					break;
+				sendToWorker(queue, std::move(queue.held.front()));
+			} else {
+				ready.push_back(std::move(queue.held.front()));
+				took_any = true;
+			}
+			queue.held.pop_front();
+		}
+
+		if (queue.in_flight == 0 && queue.held.empty())
+			it = m_peers.erase(it);
+		else
+			++it;
+	}
+
+	return ready;
+}
+
+void PacketWorkerPool::finished(session_t peer_id)
+{
+	MutexAutoLock lock(m_mutex);
+	auto it = m_peers.find(peer_id);
+	sanity_check(it != m_peers.end() && it->second.in_flight > 0);
+
+	PeerQueue &queue = it->second;
+	queue.in_flight--;
+	if (queue.in_flight == 0 && queue.held.empty())
+		m_peers.erase(it);
+}
+
+void PacketWorkerPool::deferDisconnect(session_t peer_id)
+{
+	MutexAutoLock lock(m_mutex);
+	m_disconnects.push_back(peer_id);
+}
+
+std::vector<session_t> PacketWorkerPool::takeDisconnects()
+{
+	MutexAutoLock lock(m_mutex);
+	std::vector<session_t> peers;
+	peers.swap(m_disconnects);
+	return peers;
+}
@@ -0,0 +1,86 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "network/networkprotocol.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class NetworkPacket;
+class Server;
+class PacketWorkerThread;
+
+/*
+	Runs the handlers marked as concurrent in toServerCommandTable on worker
+	threads, without holding the environment lock.
+
+	The packets of a peer are always handled in the order they arrived:
+	all concurrent packets of a peer go to the same worker, and while a peer
+	has packets in flight every following packet of it is held back.
+	Held back packets are handed out again by takeReadyPackets().
+*/
+class PacketWorkerPool
+{
+public:
+	PacketWorkerPool(Server *server, u16 num_threads);
+	~PacketWorkerPool();
+
+	void start();
+	void stop();
+
+	bool isWorkerThread();
+
+	// Takes over the packet if it has to run on a worker or has to wait for
+	// one. Returns false if the caller should process it right away.
+	bool dispatch(NetworkPacket &pkt);
+
+	// Returns held back packets that the server thread can process now,
+	// in the order they have to be processed.
+	std::vector<std::unique_ptr<NetworkPacket>> takeReadyPackets();
+
+	// Disconnecting a peer touches the environment, so workers queue the
+	// peers they denied access to for the server thread (see Server::DenyAccess)
+	void deferDisconnect(session_t peer_id);
+	std::vector<session_t> takeDisconnects();
+
+private:
+	friend class PacketWorkerThread;
+
+	struct PeerQueue
+	{
+		u32 in_flight = 0;
+		std::deque<std::unique_ptr<NetworkPacket>> held;
+	};
+
+	static bool isConcurrent(NetworkPacket *pkt);
+	// Must be called with m_mutex locked
+	void sendToWorker(PeerQueue &queue, std::unique_ptr<NetworkPacket> pkt);
+	void finished(session_t peer_id);
+
+	std::vector<std::unique_ptr<PacketWorkerThread>> m_threads;
+
+	std::mutex m_mutex;
+	std::unordered_map<session_t, PeerQueue> m_peers;
+	std::vector<session_t> m_disconnects;
+};
@@ -130,6 +130,14 @@ std::string PlayerSAO::getClientInitializationData(u16 protocol_version)
 
 	int message_count = 5 + m_bone_position.size();
 
+	if (protocol_version >= 42) {
+		std::string reference = generateMovementReferenceCommand();
+		if (!reference.empty()) {
+			msg_os << serializeString32(reference);
+			message_count++;
+		}
+	}
+
 	for (const auto &id : getAttachmentChildIds()) {
 		if (ServerActiveObject *obj = m_env->getActiveObject(id)) {
 			message_count++;
@@ -281,17 +289,12 @@ void PlayerSAO::step(float dtime, bool send_recommended)
 		else
 			pos = m_base_position;
 
-		std::string str = generateUpdatePositionCommand(
-			pos,
-			v3f(0.0f, 0.0f, 0.0f),
-			v3f(0.0f, 0.0f, 0.0f),
-			m_rotation,
-			true,
-			false,
-			update_interval
-		);
-		// create message and add to list
-		m_messages_out.emplace(getId(), false, str);
+		ObjectMovement movement;
+		movement.position = pos;
+		movement.rotation = m_rotation;
+		movement.do_interpolate = true;
+		movement.update_interval = update_interval;
+		queueMovementUpdate(movement);
 	}
 
 	if (!m_physics_override_sent) {
@@ -325,6 +325,29 @@ std::string UnitSAO::generateUpdateArmorGroupsCommand() const
 	return os.str();
 }
 
+ObjectMovement UnitSAO::queueMovementUpdate(const ObjectMovement &m)
+{
+	if (m_env->sendsLegacyMovement()) {
+		m_messages_out.emplace(getId(), false, generateUpdatePositionCommand(
+			m.position, m.velocity, m.acceleration, m.rotation,
+			m.do_interpolate, m.is_movement_end, m.update_interval));
+	}
+
+	if (!m_env->sendsDeltaMovement())
+		return m;
+
+	bool keyframe;
+	ObjectMovement decoded;
+	std::string str = m_movement_encoder.encode(m, keyframe, &decoded);
+	m_messages_out.emplace(getId(), keyframe, str);
+	return decoded;
+}
+
+std::string UnitSAO::generateMovementReferenceCommand() const
+{
+	return m_movement_encoder.encodeReference();
+}
+
 std::string UnitSAO::generateUpdatePositionCommand(const v3f &position,
 		const v3f &velocity, const v3f &acceleration, const v3f &rotation,
 		bool do_interpolate, bool is_movement_end, f32 update_interval)
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include "object_movement.h"
 #include "object_properties.h"
 #include "serveractiveobject.h"
 #include <quaternion.h>
@@ -100,6 +101,7 @@ class UnitSAO : public ServerActiveObject
 			const v3f &velocity, const v3f &acceleration, const v3f &rotation,
 			bool do_interpolate, bool is_movement_end, f32 update_interval);
 	std::string generateSetPropertiesCommand(const ObjectProperties &prop) const;
+	std::string generateMovementReferenceCommand() const;
 	static std::string generateUpdateBonePositionCommand(const std::string &bone,
 			const v3f &position, const v3f &rotation);
 	void sendPunchCommand();
@@ -121,6 +123,12 @@ class UnitSAO : public ServerActiveObject
 
 	int m_attachment_parent_id = 0;
 
+	// Queues AO_CMD_UPDATE_POSITION and/or AO_CMD_UPDATE_MOVEMENT, as needed
+	// by the connected clients (see ServerEnvironment::sendsDeltaMovement).
+	// The server forwards the one matching the client's protocol version.
+	// Returns the movement as clients decode it.
+	ObjectMovement queueMovementUpdate(const ObjectMovement &movement);
+
 private:
 	void onAttach(int parent_id);
 	void onDetach(int parent_id);
@@ -138,6 +146,8 @@ class UnitSAO : public ServerActiveObject
 	bool m_animation_sent = false;
 	bool m_animation_speed_sent = false;
 
+	ObjectMovementEncoder m_movement_encoder;
+
 	// Bone positions
 	bool m_bone_position_sent = false;
 
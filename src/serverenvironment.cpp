@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include <algorithm>
+#include <limits>
 #include "serverenvironment.h"
 #include "settings.h"
 #include "log.h"
@@ -406,6 +407,42 @@ ServerEnvironment::ServerEnvironment(ServerMap *map,
 
 	m_active_object_gauge = mb->addGauge(
 		"minetest_env_active_objects", "Number of active objects");
+
+	for (u8 tier = 0; tier < ENTITY_LOD_TIERS; tier++) {
+		m_entity_lod_gauges[tier] = mb->addGauge(
+			"minetest_env_entity_lod", "Number of stepped entities per simulation tier",
+			{{"tier", std::to_string(tier)}});
+	}
+
+	m_sleeping_entity_gauge = mb->addGauge(
+		"minetest_env_sleeping_entities", "Number of entities resting without physics");
+
+	m_cache_entity_prediction_max_error =
+		g_settings->getFloat("entity_prediction_max_error") * BS;
+	m_cache_entity_lod_distance =
+		g_settings->getFloat("entity_lod_distance") * BS;
+}
+
+u8 ServerEnvironment::getEntityLodTier(const v3f &pos) const
+{
+	if (!isEntityLodEnabled())
+		return 0;
+
+	// Without players everything is far away
+	f32 min_d_sq = std::numeric_limits<f32>::max();
+	for (const v3f &player_pos : m_lod_player_positions)
+		min_d_sq = std::min(min_d_sq, player_pos.getDistanceFromSQ(pos));
+
+	f32 tier = std::sqrt(min_d_sq) / m_cache_entity_lod_distance;
+	return tier >= ENTITY_LOD_TIERS - 1 ? ENTITY_LOD_TIERS - 1 : (u8)tier;
+}
+
+void ServerEnvironment::reportEntityLod(u8 tier, bool sleeping)
+{
+	if (sleeping)
+		m_sleeping_entity_count++;
+	else
+		m_entity_lod_counts[tier]++;
 }
 
 void ServerEnvironment::init()
@@ -1301,9 +1338,7 @@ void ServerEnvironment::step(float dtime)
 	// Update this one
 	// NOTE: This is kind of funny on a singleplayer game, but doesn't
 	// really matter that much.
-	static thread_local const float server_step =
-			g_settings->getFloat("dedicated_server_step");
-	m_recommended_send_interval = server_step;
+	m_recommended_send_interval = m_cache_server_step.get();
 
 	/*
 		Increment game time
@@ -1357,13 +1392,10 @@ void ServerEnvironment::step(float dtime)
 		*/
 		// use active_object_send_range_blocks since that is max distance
 		// for active objects sent the client anyway
-		static thread_local const s16 active_object_range =
-				g_settings->getS16("active_object_send_range_blocks");
-		static thread_local const s16 active_block_range =
-				g_settings->getS16("active_block_range");
 		std::set<v3s16> blocks_removed;
 		std::set<v3s16> blocks_added;
-		m_active_blocks.update(players, active_block_range, active_object_range,
+		m_active_blocks.update(players, m_cache_active_block_range.get(),
+			m_cache_active_object_range.get(),
 			blocks_removed, blocks_added);
 
 		/*
@@ -1515,6 +1547,19 @@ void ServerEnvironment::step(float dtime)
 
 		u32 object_count = 0;
 
+		m_lod_player_positions.clear();
+		if (isEntityLodEnabled()) {
+			for (RemotePlayer *player : m_players) {
+				// Ignore disconnected players
+				if (player->getPeerId() == PEER_ID_INEXISTENT)
+					continue;
+				if (PlayerSAO *playersao = player->getPlayerSAO())
+					m_lod_player_positions.push_back(playersao->getBasePosition());
+			}
+		}
+		std::fill(std::begin(m_entity_lod_counts), std::end(m_entity_lod_counts), 0);
+		m_sleeping_entity_count = 0;
+
 		auto cb_state = [&](ServerActiveObject *obj) {
 			if (obj->isGone())
 				return;
@@ -1527,7 +1572,13 @@ void ServerEnvironment::step(float dtime)
 		};
 		m_ao_manager.step(dtime, cb_state);
 
+		// Entities with on_step_batch
+		m_script->luaentity_RunQueuedSteps(dtime);
+
 		m_active_object_gauge->set(object_count);
+		for (u8 tier = 0; tier < ENTITY_LOD_TIERS; tier++)
+			m_entity_lod_gauges[tier]->set(m_entity_lod_counts[tier]);
+		m_sleeping_entity_gauge->set(m_sleeping_entity_count);
 	}
 
 	/*
@@ -228,6 +228,33 @@ class ServerEnvironment final : public Environment
 	float getSendRecommendedInterval()
 	{ return m_recommended_send_interval; }
 
+	// Allowed deviation of client-side entity extrapolation, in world units
+	float getEntityPredictionMaxError() const
+	{ return m_cache_entity_prediction_max_error; }
+
+	/*
+		Simulation level of detail of entities far from all players:
+		tier n is stepped every 2^n server steps. Always 0 if disabled.
+	*/
+	static constexpr u8 ENTITY_LOD_TIERS = 4;
+	bool isEntityLodEnabled() const { return m_cache_entity_lod_distance > 0.0f; }
+	u8 getEntityLodTier(const v3f &pos) const;
+	// Counted for the metrics, once per entity and step
+	void reportEntityLod(u8 tier, bool sleeping);
+
+	/*
+		Movement messages the objects queue: AO_CMD_UPDATE_POSITION for
+		clients before protocol 42, AO_CMD_UPDATE_MOVEMENT for newer ones.
+		Set by the server from the connected clients.
+	*/
+	void setMovementMessageKinds(bool legacy, bool delta)
+	{
+		m_send_legacy_movement = legacy;
+		m_send_delta_movement = delta;
+	}
+	bool sendsLegacyMovement() const { return m_send_legacy_movement; }
+	bool sendsDeltaMovement() const { return m_send_delta_movement; }
+
 	void kickAllPlayers(AccessDeniedCode reason,
 		const std::string &str_reason, bool reconnect);
 	// Save players
@@ -483,6 +510,18 @@ class ServerEnvironment final : public Environment
 	LBMManager m_lbm_mgr;
 	// An interval for generally sending object positions and stuff
 	float m_recommended_send_interval = 0.1f;
+	float m_cache_entity_prediction_max_error;
+	float m_cache_entity_lod_distance;
+	// Settings read in every step
+	CachedSetting<float> m_cache_server_step{"dedicated_server_step"};
+	CachedSetting<s16> m_cache_active_block_range{"active_block_range"};
+	CachedSetting<s16> m_cache_active_object_range{"active_object_send_range_blocks"};
+	// Positions of the connected players in the current step
+	std::vector<v3f> m_lod_player_positions;
+	u32 m_entity_lod_counts[ENTITY_LOD_TIERS] = {};
+	u32 m_sleeping_entity_count = 0;
+	bool m_send_legacy_movement = true;
+	bool m_send_delta_movement = true;
 	// Estimate for general maximum lag as determined by server.
 	// Can raise to high values like 15s with eg. map generation mods.
 	float m_max_lag_estimate = 0.1f;
@@ -505,6 +544,8 @@ class ServerEnvironment final : public Environment
 	MetricCounterPtr m_step_time_counter;
 	MetricGaugePtr m_active_block_gauge;
 	MetricGaugePtr m_active_object_gauge;
+	MetricGaugePtr m_entity_lod_gauges[ENTITY_LOD_TIERS];
+	MetricGaugePtr m_sleeping_entity_gauge;
 
 	ServerActiveObject* createSAO(ActiveObjectType type, v3f pos, const std::string &data);
 };
@@ -1099,3 +1099,56 @@ void Settings::doCallbacks(const std::string &name) const
 			(it->first)(name, it->second);
 	}
 }
+
+/*
+	CachedSetting
+*/
+
+template <typename T>
+CachedSetting<T>::CachedSetting(const std::string &name, Settings *settings) :
+	m_name(name),
+	m_settings(settings),
+	m_value(read())
+{
+	m_settings->registerChangedCallback(m_name, onChanged, this);
+}
+
+template <typename T>
+CachedSetting<T>::~CachedSetting()
+{
+	m_settings->deregisterChangedCallback(m_name, onChanged, this);
+}
+
+template <typename T>
+void CachedSetting<T>::onChanged(const std::string &name, void *data)
+{
+	auto *cached = static_cast<CachedSetting<T> *>(data);
+	try {
+		cached->m_value.store(cached->read(), std::memory_order_relaxed);
+	} catch (SettingNotFoundException &e) {
+		// Removed and without default, keep the last value
+	}
+}
+
+template <>
+bool CachedSetting<bool>::read() const { return m_settings->getBool(m_name); }
+template <>
+u16 CachedSetting<u16>::read() const { return m_settings->getU16(m_name); }
+template <>
+s16 CachedSetting<s16>::read() const { return m_settings->getS16(m_name); }
+template <>
+u32 CachedSetting<u32>::read() const { return m_settings->getU32(m_name); }
+template <>
+s32 CachedSetting<s32>::read() const { return m_settings->getS32(m_name); }
+template <>
+u64 CachedSetting<u64>::read() const { return m_settings->getU64(m_name); }
+template <>
+float CachedSetting<float>::read() const { return m_settings->getFloat(m_name); }
+
+template class CachedSetting<bool>;
+template class CachedSetting<u16>;
+template class CachedSetting<s16>;
+template class CachedSetting<u32>;
+template class CachedSetting<s32>;
+template class CachedSetting<u64>;
+template class CachedSetting<float>;
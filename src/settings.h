@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <list>
 #include <set>
 #include <mutex>
+#include <atomic>
 
 class Settings;
 struct NoiseParams;
@@ -296,3 +297,29 @@ class Settings {
 
 	static std::unordered_map<std::string, const FlagDesc *> s_flags;
 };
+
+/*
+	Typed copy of a setting for code that reads it often.
+	The value is parsed once and updated by a changed callback, so reading
+	it takes no lock. Instantiated for bool, u16, s16, u32, s32, u64 and float.
+	Must not outlive the Settings object.
+*/
+template <typename T>
+class CachedSetting {
+public:
+	CachedSetting(const std::string &name, Settings *settings = g_settings);
+	~CachedSetting();
+
+	DISABLE_CLASS_COPY(CachedSetting)
+
+	T get() const { return m_value.load(std::memory_order_relaxed); }
+	operator T() const { return get(); }
+
+private:
+	static void onChanged(const std::string &name, void *data);
+	T read() const;
+
+	const std::string m_name;
+	Settings *m_settings;
+	std::atomic<T> m_value;
+};
@@ -18,7 +18,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "test.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <unordered_set>
 #include <unordered_map>
 #include "mapblock.h"
@@ -36,6 +38,8 @@ class TestMap : public TestBase
 	void testForEachNodeInArea(IGameDef *gamedef);
 	void testForEachNodeInAreaBlank(IGameDef *gamedef);
 	void testForEachNodeInAreaEmpty(IGameDef *gamedef);
+	void testForEachNodeInAreaWithContent(IGameDef *gamedef);
+	void testFindNodeNear(IGameDef *gamedef);
 };
 
 static TestMap g_test_instance;
@@ -46,6 +50,8 @@ void TestMap::runTests(IGameDef *gamedef)
 	TEST(testForEachNodeInArea, gamedef);
 	TEST(testForEachNodeInAreaBlank, gamedef);
 	TEST(testForEachNodeInAreaEmpty, gamedef);
+	TEST(testForEachNodeInAreaWithContent, gamedef);
+	TEST(testFindNodeNear, gamedef);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -169,3 +175,105 @@ void TestMap::testForEachNodeInAreaEmpty(IGameDef *gamedef)
 		return true;
 	});
 }
+
+void TestMap::testForEachNodeInAreaWithContent(IGameDef *gamedef)
+{
+	DummyMap map(gamedef, v3s16(-1, -1, -1), v3s16(1, 1, 1));
+
+	v3s16 p1(-3, 4, 20);
+	v3s16 p2(17, -16, 0);
+	map.setNode(p1, MapNode(t_CONTENT_STONE));
+	map.setNode(p2, MapNode(t_CONTENT_STONE));
+	map.setNode(v3s16(0, 0, 0), MapNode(t_CONTENT_LAVA));
+
+	std::vector<content_t> filter = {t_CONTENT_STONE, t_CONTENT_TORCH};
+	std::vector<v3s16> visited;
+	auto collect = [&](v3s16 p, MapNode n) -> bool {
+		UASSERT(CONTAINS(filter, n.getContent()));
+		visited.push_back(p);
+		return true;
+	};
+
+	map.forEachNodeInAreaWithContent(v3s16(-16), v3s16(31), filter, collect);
+	UASSERTEQ(size_t, visited.size(), 2);
+	UASSERT(CONTAINS(visited, p1) && CONTAINS(visited, p2));
+
+	// Area bounds are respected
+	visited.clear();
+	map.forEachNodeInAreaWithContent(v3s16(-2, 4, 20), v3s16(20, 4, 20), filter, collect);
+	UASSERTEQ(size_t, visited.size(), 0);
+
+	// The per-block content check follows changes
+	map.setNode(p1, MapNode(t_CONTENT_TORCH));
+	map.setNode(p2, MapNode(CONTENT_AIR));
+	visited.clear();
+	map.forEachNodeInAreaWithContent(v3s16(-16), v3s16(31), filter, collect);
+	UASSERTEQ(size_t, visited.size(), 1);
+	UASSERT(visited[0] == p1);
+
+	// Nodes outside of loaded blocks are ignore
+	filter = {CONTENT_IGNORE};
+	visited.clear();
+	map.forEachNodeInAreaWithContent(v3s16(31, 0, 0), v3s16(32, 0, 0), filter, collect);
+	UASSERTEQ(size_t, visited.size(), 1);
+	UASSERT(visited[0] == v3s16(32, 0, 0));
+}
+
+void TestMap::testFindNodeNear(IGameDef *gamedef)
+{
+	DummyMap map(gamedef, v3s16(-1, -1, -1), v3s16(1, 1, 1));
+	std::vector<content_t> filter = {t_CONTENT_STONE};
+	v3s16 found;
+
+	UASSERT(!map.findNodeNear(v3s16(0, 0, 0), 0, 20, filter, &found));
+
+	map.setNode(v3s16(5, 0, 0), MapNode(t_CONTENT_STONE));
+	map.setNode(v3s16(0, -3, 0), MapNode(t_CONTENT_STONE));
+	UASSERT(map.findNodeNear(v3s16(0, 0, 0), 1, 20, filter, &found));
+	UASSERT(found == v3s16(0, -3, 0));
+	UASSERT(!map.findNodeNear(v3s16(0, 0, 0), 1, 2, filter, &found));
+	UASSERT(!map.findNodeNear(v3s16(0, -3, 0), 1, 1, filter, &found));
+	UASSERT(map.findNodeNear(v3s16(0, -3, 0), 0, 1, filter, &found));
+	UASSERT(found == v3s16(0, -3, 0));
+
+	// Across block borders; of equally distant nodes the euclidean closest wins
+	map.setNode(v3s16(20, 3, 3), MapNode(t_CONTENT_STONE));
+	map.setNode(v3s16(19, 0, 3), MapNode(t_CONTENT_STONE));
+	UASSERT(map.findNodeNear(v3s16(16, 0, 0), 0, 20, filter, &found));
+	UASSERT(found == v3s16(19, 0, 3));
+
+	// Compare with a naive search
+	for (int i = 0; i < 40; i++) {
+		map.setNode(v3s16(myrand_range(-16, 31), myrand_range(-16, 31),
+			myrand_range(-16, 31)), MapNode(t_CONTENT_STONE));
+	}
+	for (int i = 0; i < 40; i++) {
+		v3s16 pos(myrand_range(-20, 35), myrand_range(-20, 35), myrand_range(-20, 35));
+		s32 radius = myrand_range(0, 20);
+		s32 start_radius = myrand_range(0, 1);
+
+		s32 best_d = -1, best_e = 0;
+		v3s16 d;
+		for (d.Z = -radius; d.Z <= radius; d.Z++)
+		for (d.Y = -radius; d.Y <= radius; d.Y++)
+		for (d.X = -radius; d.X <= radius; d.X++) {
+			s32 dist = std::max({std::abs(d.X), std::abs(d.Y), std::abs(d.Z)});
+			s32 e = d.X * d.X + d.Y * d.Y + d.Z * d.Z;
+			if (dist < start_radius || map.getNode(pos + d).getContent() != t_CONTENT_STONE)
+				continue;
+			if (best_d < 0 || dist < best_d || (dist == best_d && e < best_e)) {
+				best_d = dist;
+				best_e = e;
+			}
+		}
+
+		bool ok = map.findNodeNear(pos, start_radius, radius, filter, &found);
+		UASSERTEQ(bool, ok, best_d >= 0);
+		if (!ok)
+			continue;
+		UASSERTEQ(content_t, map.getNode(found).getContent(), t_CONTENT_STONE);
+		d = found - pos;
+		UASSERTEQ(s32, std::max({std::abs(d.X), std::abs(d.Y), std::abs(d.Z)}), best_d);
+		UASSERTEQ(s32, d.X * d.X + d.Y * d.Y + d.Z * d.Z, best_e);
+	}
+}
@@ -0,0 +1,586 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <queue>
+#include <set>
+#include "gamedef.h"
+#include "nodedef.h"
+#include "noise.h"
+#include "dummymap.h"
+#include "mapgen/mapgen.h"
+#include "mapgen/mg_decoration.h"
+#include "mapgen/mg_ore.h"
+#include "mapgen/mg_schematic.h"
+#include "filesys.h"
+#include "mapgen/heightcache.h"
+#include "settings.h"
+#include "util/directiontables.h"
+
+class TestMapgen : public TestBase {
+public:
+	TestMapgen() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMapgen"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testLighting(IGameDef *gamedef);
+	void testOreThreads(IGameDef *gamedef);
+	void testDecoSurfaceTable(IGameDef *gamedef);
+	void testHeightCache();
+};
+
+static TestMapgen g_test_instance;
+
+void TestMapgen::runTests(IGameDef *gamedef)
+{
+	TEST(testLighting, gamedef);
+	TEST(testOreThreads, gamedef);
+	TEST(testDecoSurfaceTable, gamedef);
+	TEST(testHeightCache);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+	Straightforward lighting the mapgen lighting must match:
+	sunlight walks down column by column, light spreads through a FIFO queue.
+*/
+
+static void reference_light_spread(MMVManip *vm, const NodeDefManager *ndef,
+	const VoxelArea &a, std::queue<std::pair<v3s16, u8>> &queue,
+	const v3s16 &p, u8 light)
+{
+	if (light <= 1 || !a.contains(p))
+		return;
+
+	MapNode &n = vm->m_data[vm->m_area.index(p)];
+
+	u8 light_day = light & 0x0F;
+	if (light_day > 0)
+		light_day -= 0x01;
+
+	u8 light_night = light & 0xF0;
+	if (light_night > 0)
+		light_night -= 0x10;
+
+	if ((light_day <= (n.param1 & 0x0F) &&
+			light_night <= (n.param1 & 0xF0)) ||
+			!ndef->getLightingFlags(n).light_propagates)
+		return;
+
+	light = MYMAX(light_day, n.param1 & 0x0F) |
+			MYMAX(light_night, n.param1 & 0xF0);
+	n.param1 = light;
+	queue.emplace(p, light);
+}
+
+static void reference_lighting(MMVManip *vm, const NodeDefManager *ndef,
+	int water_level, v3s16 nmin, v3s16 nmax, v3s16 full_nmin, v3s16 full_nmax,
+	bool propagate_shadow)
+{
+	// Sunlight
+	VoxelArea a(nmin, nmax);
+	bool block_is_underground = (water_level >= nmax.Y);
+	const v3s16 &em = vm->m_area.getExtent();
+
+	for (int z = a.MinEdge.Z; z <= a.MaxEdge.Z; z++)
+	for (int x = a.MinEdge.X; x <= a.MaxEdge.X; x++) {
+		u32 i = vm->m_area.index(x, a.MaxEdge.Y + 1, z);
+		if (vm->m_data[i].getContent() == CONTENT_IGNORE) {
+			if (block_is_underground)
+				continue;
+		} else if ((vm->m_data[i].param1 & 0x0F) != LIGHT_SUN &&
+				propagate_shadow) {
+			continue;
+		}
+		VoxelArea::add_y(em, i, -1);
+
+		for (int y = a.MaxEdge.Y; y >= a.MinEdge.Y; y--) {
+			MapNode &n = vm->m_data[i];
+			if (!ndef->getLightingFlags(n).sunlight_propagates)
+				break;
+			n.param1 = LIGHT_SUN;
+			VoxelArea::add_y(em, i, -1);
+		}
+	}
+
+	// Light spread
+	std::queue<std::pair<v3s16, u8>> queue;
+	VoxelArea full(full_nmin, full_nmax);
+
+	for (int z = full.MinEdge.Z; z <= full.MaxEdge.Z; z++)
+	for (int y = full.MinEdge.Y; y <= full.MaxEdge.Y; y++)
+	for (int x = full.MinEdge.X; x <= full.MaxEdge.X; x++) {
+		MapNode &n = vm->m_data[vm->m_area.index(x, y, z)];
+		if (n.getContent() == CONTENT_IGNORE)
+			continue;
+
+		ContentLightingFlags cf = ndef->getLightingFlags(n);
+		if (!cf.light_propagates)
+			continue;
+
+		u8 light_produced = cf.light_source;
+		if (light_produced)
+			n.param1 = light_produced | (light_produced << 4);
+
+		u8 light = n.param1;
+		if (light) {
+			const v3s16 p(x, y, z);
+			for (const auto &dir : g_6dirs)
+				reference_light_spread(vm, ndef, full, queue, p + dir, light);
+		}
+	}
+
+	while (!queue.empty()) {
+		const auto &i = queue.front();
+		for (const auto &dir : g_6dirs)
+			reference_light_spread(vm, ndef, full, queue, i.first + dir, i.second);
+		queue.pop();
+	}
+}
+
+// Terrain with caves, water, torches and lava, some ignore on top and
+// some random light already set
+static void fill_test_area(MMVManip *vm, u32 seed)
+{
+	PcgRandom pr(seed);
+	const VoxelArea &area = vm->m_area;
+
+	for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+	for (s16 x = area.MinEdge.X; x <= area.MaxEdge.X; x++) {
+		s16 ground = 4 + (x * x + z * z) % 7 - 3 * ((x / 5 + z / 7) % 2);
+		u32 vi = area.index(x, area.MinEdge.Y, z);
+		for (s16 y = area.MinEdge.Y; y <= area.MaxEdge.Y; y++) {
+			content_t c = CONTENT_AIR;
+			u32 r = pr.range(1000);
+			if (y > area.MaxEdge.Y - 2 && x % 3 == 0)
+				c = CONTENT_IGNORE;
+			else if (y <= 0 && y > -4)
+				c = r < 50 ? t_CONTENT_STONE : t_CONTENT_WATER;
+			else if (y < ground)
+				c = r < 150 ? CONTENT_AIR : (r < 160 ? t_CONTENT_LAVA :
+					(r < 170 ? t_CONTENT_TORCH : t_CONTENT_STONE));
+			else if (r < 15)
+				c = t_CONTENT_TORCH;
+			else if (r < 30)
+				c = t_CONTENT_GRASS;
+
+			vm->m_data[vi] = MapNode(c, pr.range(6) == 0 ? pr.range(256) : 0);
+			VoxelArea::add_y(area.getExtent(), vi, 1);
+		}
+	}
+}
+
+void TestMapgen::testLighting(IGameDef *gamedef)
+{
+	const NodeDefManager *ndef = gamedef->getNodeDefManager();
+	v3s16 bpmin(-1, -1, -1), bpmax(1, 1, 1);
+	DummyMap map(gamedef, bpmin, bpmax);
+
+	// As in the mapgens: sunlight in the chunk plus one node above and
+	// below, light spread in the whole voxel area
+	v3s16 full_nmin = bpmin * MAP_BLOCKSIZE;
+	v3s16 full_nmax = (bpmax + 1) * MAP_BLOCKSIZE - 1;
+	v3s16 nmin = full_nmin + v3s16(MAP_BLOCKSIZE, MAP_BLOCKSIZE - 1, MAP_BLOCKSIZE);
+	v3s16 nmax = full_nmax - v3s16(MAP_BLOCKSIZE, MAP_BLOCKSIZE - 1, MAP_BLOCKSIZE);
+
+	for (u32 seed = 0; seed < 8; seed++) {
+		bool propagate_shadow = seed % 2;
+		int water_level = (seed % 4 < 2) ? 1 : nmax.Y;
+
+		MMVManip expected(&map);
+		expected.initialEmerge(bpmin, bpmax, false);
+		fill_test_area(&expected, seed);
+		reference_lighting(&expected, ndef, water_level, nmin, nmax,
+			full_nmin, full_nmax, propagate_shadow);
+
+		MMVManip vm(&map);
+		vm.initialEmerge(bpmin, bpmax, false);
+		fill_test_area(&vm, seed);
+		Mapgen mg;
+		mg.vm = &vm;
+		mg.ndef = ndef;
+		mg.water_level = water_level;
+		mg.calcLighting(nmin, nmax, full_nmin, full_nmax, propagate_shadow);
+
+		s32 volume = vm.m_area.getVolume();
+		for (s32 i = 0; i < volume; i++) {
+			UASSERTEQ(content_t, vm.m_data[i].getContent(),
+				expected.m_data[i].getContent());
+			UASSERTEQ(int, vm.m_data[i].param1, expected.m_data[i].param1);
+		}
+	}
+}
+
+// Stone with some air
+static void fill_ore_test_area(MMVManip *vm, u32 seed)
+{
+	PcgRandom pr(seed);
+	s32 volume = vm->m_area.getVolume();
+	for (s32 i = 0; i < volume; i++)
+		vm->m_data[i] = MapNode(pr.range(8) == 0 ? CONTENT_AIR : t_CONTENT_STONE);
+}
+
+static Ore *create_test_ore(OreType type, content_t c_ore,
+	std::vector<content_t> c_wherein)
+{
+	Ore *ore = OreManager::create(type);
+	ore->c_ore = c_ore;
+	ore->c_wherein = std::move(c_wherein);
+	ore->clust_scarcity = 1;
+	ore->clust_num_ores = 1;
+	ore->clust_size = 1;
+	ore->y_min = -MAX_MAP_GENERATION_LIMIT;
+	ore->y_max = MAX_MAP_GENERATION_LIMIT;
+	ore->ore_param2 = 0;
+	ore->nthresh = 0.0f;
+	return ore;
+}
+
+// One ore of each type, most of them also placed in the nodes of the
+// previous ones, so that the registration order matters
+static void add_test_ores(OreManager *oremgr)
+{
+	Ore *ore = create_test_ore(ORE_SCATTER, t_CONTENT_BRICK, {t_CONTENT_STONE});
+	ore->clust_scarcity = 8 * 8 * 8;
+	ore->clust_num_ores = 8;
+	ore->clust_size = 3;
+	oremgr->add(ore);
+
+	OreSheet *sheet = (OreSheet *)create_test_ore(ORE_SHEET, t_CONTENT_GRASS,
+		{t_CONTENT_STONE, t_CONTENT_BRICK, CONTENT_AIR});
+	sheet->ore_param2 = 3;
+	sheet->nthresh = 0.3f;
+	sheet->np = NoiseParams(0.0f, 1.0f, v3f(16, 16, 16), 1, 2, 0.6f, 2.0f);
+	sheet->column_height_min = 1;
+	sheet->column_height_max = 8;
+	sheet->column_midpoint_factor = 0.5f;
+	oremgr->add(sheet);
+
+	OrePuff *puff = (OrePuff *)create_test_ore(ORE_PUFF, t_CONTENT_WATER,
+		{t_CONTENT_STONE});
+	puff->nthresh = 0.3f;
+	puff->np = NoiseParams(0.0f, 1.0f, v3f(16, 16, 16), 2, 2, 0.6f, 2.0f);
+	puff->np_puff_top = NoiseParams(4.0f, 2.0f, v3f(16, 16, 16), 3, 1, 0.5f, 2.0f);
+	puff->np_puff_bottom = NoiseParams(4.0f, 2.0f, v3f(16, 16, 16), 4, 1, 0.5f, 2.0f);
+	oremgr->add(puff);
+
+	ore = create_test_ore(ORE_BLOB, t_CONTENT_LAVA,
+		{t_CONTENT_STONE, t_CONTENT_GRASS});
+	ore->clust_scarcity = 10 * 10 * 10;
+	ore->clust_size = 5;
+	ore->np = NoiseParams(0.0f, 1.0f, v3f(5, 5, 5), 5, 2, 0.7f, 2.0f);
+	oremgr->add(ore);
+
+	OreVein *vein = (OreVein *)create_test_ore(ORE_VEIN, t_CONTENT_TORCH,
+		{t_CONTENT_STONE, t_CONTENT_LAVA});
+	vein->nthresh = 0.5f;
+	vein->random_factor = 0.1f;
+	vein->np = NoiseParams(0.0f, 1.0f, v3f(24, 24, 24), 6, 2, 0.6f, 2.0f);
+	oremgr->add(vein);
+
+	OreStratum *stratum = (OreStratum *)create_test_ore(ORE_STRATUM,
+		t_CONTENT_BRICK, {t_CONTENT_STONE, t_CONTENT_WATER});
+	stratum->ore_param2 = 5;
+	stratum->flags = OREFLAG_USE_NOISE;
+	stratum->clust_scarcity = 2;
+	stratum->np = NoiseParams(0.0f, 8.0f, v3f(32, 32, 32), 7, 1, 0.5f, 2.0f);
+	stratum->stratum_thickness = 4;
+	oremgr->add(stratum);
+}
+
+void TestMapgen::testOreThreads(IGameDef *gamedef)
+{
+	// A mapchunk of 3x3x3 blocks, plus the border the ores may reach into
+	v3s16 bpmin(-2, -2, -2), bpmax(2, 2, 2);
+	DummyMap map(gamedef, bpmin, bpmax);
+	v3s16 nmin = (bpmin + 1) * MAP_BLOCKSIZE;
+	v3s16 nmax = bpmax * MAP_BLOCKSIZE - 1;
+
+	// The threads are started when the ores are placed the first time
+	std::string num_ore_threads = g_settings->get("num_ore_threads");
+	OreManager oremgr(gamedef), oremgr_threaded(gamedef);
+	add_test_ores(&oremgr);
+	add_test_ores(&oremgr_threaded);
+
+	// Content and param2 of the generated nodes
+	std::set<std::pair<content_t, u8>> placed;
+	for (u32 seed = 0; seed < 4; seed++) {
+		MMVManip expected(&map);
+		expected.initialEmerge(bpmin, bpmax, false);
+		fill_ore_test_area(&expected, seed);
+		Mapgen mg;
+		mg.vm = &expected;
+		mg.seed = seed;
+		g_settings->set("num_ore_threads", "1");
+		oremgr.placeAllOres(&mg, seed * 100, nmin, nmax);
+
+		MMVManip vm(&map);
+		vm.initialEmerge(bpmin, bpmax, false);
+		fill_ore_test_area(&vm, seed);
+		mg.vm = &vm;
+		g_settings->set("num_ore_threads", "4");
+		oremgr_threaded.placeAllOres(&mg, seed * 100, nmin, nmax);
+
+		s32 volume = vm.m_area.getVolume();
+		for (s32 i = 0; i < volume; i++) {
+			UASSERTEQ(content_t, vm.m_data[i].getContent(),
+				expected.m_data[i].getContent());
+			UASSERTEQ(int, vm.m_data[i].param2, expected.m_data[i].param2);
+			placed.emplace(vm.m_data[i].getContent(), vm.m_data[i].param2);
+		}
+	}
+	g_settings->set("num_ore_threads", num_ore_threads);
+
+	// Every ore was placed somewhere
+	UASSERT(placed.count({t_CONTENT_BRICK, 0}));
+	UASSERT(placed.count({t_CONTENT_GRASS, 3}));
+	UASSERT(placed.count({t_CONTENT_WATER, 0}));
+	UASSERT(placed.count({t_CONTENT_LAVA, 0}));
+	UASSERT(placed.count({t_CONTENT_TORCH, 0}));
+	UASSERT(placed.count({t_CONTENT_BRICK, 5}));
+}
+
+// Hills of grass on stone, a lake at y = 1 and a cave below
+static void fill_deco_test_area(MMVManip *vm)
+{
+	const VoxelArea &area = vm->m_area;
+	for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+	for (s16 x = area.MinEdge.X; x <= area.MaxEdge.X; x++) {
+		s16 ground = ((x / 3 * 7 + z / 4 * 13) % 9 + 9) % 9 - 3;
+		bool cave = ((x / 4 + z / 4) % 3 + 3) % 3 != 0;
+		for (s16 y = area.MinEdge.Y; y <= area.MaxEdge.Y; y++) {
+			content_t c = CONTENT_AIR;
+			if (y < -5 && y > -12 && cave)
+				c = CONTENT_AIR;
+			else if (y < ground)
+				c = t_CONTENT_STONE;
+			else if (y == ground)
+				c = t_CONTENT_GRASS;
+			else if (y <= 1)
+				c = t_CONTENT_WATER;
+			vm->m_data[area.index(x, y, z)] = MapNode(c);
+		}
+	}
+}
+
+static DecoSimple *create_test_deco(u32 flags, float fill_ratio,
+	std::vector<content_t> c_place_on, content_t c_deco, s16 height_max)
+{
+	DecoSimple *deco = (DecoSimple *)DecorationManager::create(DECO_SIMPLE);
+	deco->flags = flags;
+	deco->fill_ratio = fill_ratio;
+	deco->sidelen = 16;
+	deco->y_min = -MAX_MAP_GENERATION_LIMIT;
+	deco->y_max = MAX_MAP_GENERATION_LIMIT;
+	deco->nspawnby = -1;
+	deco->c_place_on = std::move(c_place_on);
+	deco->c_decos.push_back(c_deco);
+	deco->deco_height = 1;
+	deco->deco_height_max = height_max;
+	deco->deco_param2 = 0;
+	deco->deco_param2_max = 0;
+	return deco;
+}
+
+static DecoSchematic *create_test_deco_schematic(u32 flags, float fill_ratio,
+	std::vector<content_t> c_place_on, Schematic *schematic)
+{
+	DecoSchematic *deco =
+		(DecoSchematic *)DecorationManager::create(DECO_SCHEMATIC);
+	deco->flags = flags | DECO_PLACE_CENTER_X | DECO_PLACE_CENTER_Z;
+	deco->fill_ratio = fill_ratio;
+	deco->sidelen = 16;
+	deco->y_min = -MAX_MAP_GENERATION_LIMIT;
+	deco->y_max = MAX_MAP_GENERATION_LIMIT;
+	deco->nspawnby = -1;
+	deco->c_place_on = std::move(c_place_on);
+	deco->rotation = ROTATE_RAND;
+	deco->schematic = schematic;
+	return deco;
+}
+
+void TestMapgen::testDecoSurfaceTable(IGameDef *gamedef)
+{
+	NodeDefManager *ndef = (NodeDefManager *)gamedef->getNodeDefManager();
+	ndef->setNodeRegistrationStatus(true);
+
+	v3s16 bpmin(-2, -2, -2), bpmax(2, 2, 2);
+	DummyMap map(gamedef, bpmin, bpmax);
+	v3s16 nmin = (bpmin + 1) * MAP_BLOCKSIZE;
+	v3s16 nmax = bpmax * MAP_BLOCKSIZE - 1;
+
+	// A tree of brick with a stone crown, 5x5 and 4 nodes high
+	static const v3s16 size(5, 4, 5);
+	Schematic schem;
+	schem.size = size;
+	schem.schemdata = new MapNode[size.X * size.Y * size.Z];
+	schem.slice_probs = new u8[size.Y];
+	for (s16 y = 0; y != size.Y; y++)
+		schem.slice_probs[y] = MTSCHEM_PROB_ALWAYS;
+	schem.m_nodenames = { "air", "default:brick", "default:stone" };
+	schem.m_nnlistsizes.push_back(schem.m_nodenames.size());
+	u32 si = 0;
+	for (s16 z = 0; z != size.Z; z++)
+	for (s16 y = 0; y != size.Y; y++)
+	for (s16 x = 0; x != size.X; x++, si++) {
+		if (y == size.Y - 1)
+			schem.schemdata[si] = MapNode(2, MTSCHEM_PROB_ALWAYS, 0);
+		else if (x == 2 && z == 2)
+			schem.schemdata[si] = MapNode(1, MTSCHEM_PROB_ALWAYS, 0);
+		else
+			schem.schemdata[si] = MapNode(0, MTSCHEM_PROB_NEVER, 0);
+	}
+	ndef->pendNodeResolve(&schem);
+
+	// The decorations after the trees are placed on and under them, on
+	// each other, on the lake and in the cave
+	DecorationManager decomgr(gamedef);
+	decomgr.add(create_test_deco_schematic(0, 0.02f,
+		{t_CONTENT_GRASS}, &schem));
+	decomgr.add(create_test_deco(0, 0.1f,
+		{t_CONTENT_GRASS, t_CONTENT_STONE}, t_CONTENT_BRICK, 3));
+	decomgr.add(create_test_deco(0, 0.5f,
+		{t_CONTENT_BRICK}, t_CONTENT_TORCH, 0));
+	decomgr.add(create_test_deco(DECO_LIQUID_SURFACE, 0.2f,
+		{t_CONTENT_WATER}, t_CONTENT_BRICK, 0));
+	decomgr.add(create_test_deco(DECO_ALL_FLOORS | DECO_ALL_CEILINGS, 0.3f,
+		{t_CONTENT_STONE, t_CONTENT_BRICK}, t_CONTENT_BRICK, 0));
+	decomgr.add(create_test_deco_schematic(DECO_ALL_FLOORS, 0.05f,
+		{t_CONTENT_STONE, t_CONTENT_BRICK}, &schem));
+	decomgr.add(create_test_deco(DECO_ALL_FLOORS, 0.2f,
+		{t_CONTENT_STONE, t_CONTENT_BRICK}, t_CONTENT_GRASS, 0));
+
+	for (u32 seed = 0; seed < 4; seed++) {
+		// Every decoration scanning the columns again, as before the table
+		MMVManip expected(&map);
+		expected.initialEmerge(bpmin, bpmax, false);
+		fill_deco_test_area(&expected);
+		Mapgen mg;
+		mg.vm = &expected;
+		mg.ndef = ndef;
+		for (size_t i = 0; i != decomgr.getNumObjects(); i++) {
+			DecoSurfaceTable surfaces;
+			surfaces.reset(&mg, nmin, nmax);
+			Decoration *deco = (Decoration *)decomgr.getRaw(i);
+			deco->placeDeco(&mg, seed * 100 + i, nmin, nmax, &surfaces);
+		}
+
+		MMVManip vm(&map);
+		vm.initialEmerge(bpmin, bpmax, false);
+		fill_deco_test_area(&vm);
+		mg.vm = &vm;
+		decomgr.placeAllDecos(&mg, seed * 100, nmin, nmax);
+
+		u32 torches = 0;
+		s32 volume = vm.m_area.getVolume();
+		for (s32 i = 0; i < volume; i++) {
+			UASSERTEQ(content_t, vm.m_data[i].getContent(),
+				expected.m_data[i].getContent());
+			torches += vm.m_data[i].getContent() == t_CONTENT_TORCH;
+		}
+		UASSERT(torches > 0);
+	}
+}
+
+void TestMapgen::testHeightCache()
+{
+	std::string savedir = getTestTempDirectory() + DIR_DELIM + "heightcache";
+	fs::RecursiveDelete(savedir);
+
+	TerrainHeightCache cache;
+	cache.setSaveDir(savedir);
+	v3s16 nmin(-32, -32, -32), nmax(47, 47, 47);
+	s16 csize = nmax.X - nmin.X + 1;
+
+	// Ground at x + z, none found in the first column, all solid in the last
+	std::vector<s16> heightmap(csize * csize);
+	for (s16 z = nmin.Z; z <= nmax.Z; z++)
+	for (s16 x = nmin.X; x <= nmax.X; x++)
+		heightmap[(z - nmin.Z) * csize + (x - nmin.X)] = x + z;
+	for (s16 z = 0; z < csize; z++) {
+		heightmap[z * csize] = -MAX_MAP_GENERATION_LIMIT;
+		heightmap[z * csize + csize - 1] = nmax.Y;
+	}
+	cache.update(heightmap.data(), nmin, nmax);
+
+	s16 level;
+	UASSERT(cache.getGroundLevel(v2s16(8, -4), &level));
+	UASSERTEQ(s16, level, 4);
+	UASSERT(cache.getGroundLevel(v2s16(-28, 12), &level));
+	UASSERTEQ(s16, level, -16);
+	// Between the sample points the highest surrounding one is taken, if
+	// all of them were recorded
+	UASSERT(cache.getGroundLevel(v2s16(9, -5), &level));
+	UASSERTEQ(s16, level, 8);
+	UASSERT(!cache.getGroundLevel(v2s16(-30, 0), &level));
+	// Ground above the mapchunk, outside of it, or not found
+	UASSERT(!cache.getGroundLevel(v2s16(40, 20), &level));
+	UASSERT(!cache.getGroundLevel(v2s16(100, 0), &level));
+	UASSERT(!cache.getGroundLevel(v2s16(-32, 0), &level));
+
+	// A higher surface above it replaces the ground, a lower one doesn't
+	for (s16 &h : heightmap)
+		h = 60;
+	cache.update(heightmap.data(), nmin + v3s16(0, 80, 0), nmax + v3s16(0, 80, 0));
+	UASSERT(cache.getGroundLevel(v2s16(8, -4), &level));
+	UASSERTEQ(s16, level, 60);
+	for (s16 &h : heightmap)
+		h = -100;
+	cache.update(heightmap.data(), nmin - v3s16(0, 80, 0), nmax - v3s16(0, 80, 0));
+	UASSERT(cache.getGroundLevel(v2s16(8, -4), &level));
+	UASSERTEQ(s16, level, 60);
+
+	// The mapchunk spans the regions around the origin, each gets a file
+	UASSERT(cache.save());
+	UASSERTEQ(size_t, fs::GetDirListing(savedir).size(), 4);
+	UASSERTEQ(size_t, cache.getRegionCount(), 4);
+
+	// Nothing changed, nothing is written
+	fs::RecursiveDelete(savedir);
+	UASSERT(cache.save());
+	UASSERT(!fs::PathExists(savedir));
+
+	// Only the modified region is written
+	for (s16 &h : heightmap)
+		h = 200;
+	v3s16 far(800, 160, 800);
+	cache.update(heightmap.data(), nmin + far, nmax + far);
+	UASSERT(cache.save());
+	UASSERTEQ(size_t, fs::GetDirListing(savedir).size(), 1);
+
+	// Regions are loaded when needed
+	TerrainHeightCache cache2;
+	cache2.setSaveDir(savedir);
+	UASSERTEQ(size_t, cache2.getRegionCount(), 0);
+	UASSERT(cache2.getGroundLevel(v2s16(800, 800), &level));
+	UASSERTEQ(s16, level, 200);
+	UASSERT(!cache2.getGroundLevel(v2s16(8, -4), &level));
+	UASSERTEQ(size_t, cache2.getRegionCount(), 1);
+
+	// Unused regions are unloaded after saving, and loaded again when needed
+	UASSERT(cache.save(0));
+	UASSERTEQ(size_t, cache.getRegionCount(), 0);
+	UASSERT(cache.getGroundLevel(v2s16(800, 800), &level));
+	UASSERTEQ(s16, level, 200);
+
+	fs::RecursiveDelete(savedir);
+}
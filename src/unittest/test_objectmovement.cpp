@@ -0,0 +1,287 @@
+/*
+Minetest
+Copyright (C) 2024 Minetest core developers & community
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <sstream>
+#include "activeobject.h"
+#include "constants.h"
+#include "object_movement.h"
+
+class TestObjectMovement : public TestBase
+{
+public:
+	TestObjectMovement() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestObjectMovement"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testKeyframeThenDelta();
+	void testOutOfRange();
+	void testMissingKeyframe();
+	void testReference();
+	void testPredictionUpdateCount();
+	void testPredictionQuantization();
+};
+
+static TestObjectMovement g_test_instance;
+
+void TestObjectMovement::runTests(IGameDef *gamedef)
+{
+	TEST(testKeyframeThenDelta);
+	TEST(testOutOfRange);
+	TEST(testMissingKeyframe);
+	TEST(testReference);
+	TEST(testPredictionUpdateCount);
+	TEST(testPredictionQuantization);
+}
+
+// Strips the command byte like GenericCAO::processMessage does
+static bool decode(ObjectMovementDecoder &decoder, const std::string &data,
+	ObjectMovement &m)
+{
+	std::istringstream is(data, std::ios::binary);
+	UASSERT(is.get() == AO_CMD_UPDATE_MOVEMENT);
+	return decoder.decode(is, m);
+}
+
+static ObjectMovement makeMovement(v3f pos)
+{
+	ObjectMovement m;
+	m.position = pos;
+	m.velocity = v3f(1.0f, -2.5f, 0.0f) * BS;
+	m.rotation = v3f(0.0f, 270.0f, 0.0f);
+	m.do_interpolate = true;
+	m.update_interval = 0.09f;
+	return m;
+}
+
+void TestObjectMovement::testKeyframeThenDelta()
+{
+	ObjectMovementEncoder encoder;
+	ObjectMovementDecoder decoder;
+	ObjectMovement out;
+	bool keyframe;
+
+	std::string data = encoder.encode(makeMovement(v3f(100, 20, -3000)), keyframe);
+	UASSERT(keyframe);
+	UASSERT(ObjectMovement::isKeyframe(data));
+	UASSERT(decode(decoder, data, out));
+	UASSERT(out.position == v3f(100, 20, -3000));
+
+	v3f pos(103.3f, 19.0f, -2990.1f);
+	data = encoder.encode(makeMovement(pos), keyframe);
+	UASSERT(!keyframe);
+	UASSERT(!ObjectMovement::isKeyframe(data));
+	// Legacy AO_CMD_UPDATE_POSITION is 55 bytes
+	UASSERT(data.size() < 30);
+	UASSERT(decode(decoder, data, out));
+	UASSERT(out.position.getDistanceFrom(pos) < BS / 128.0f);
+	UASSERT(out.velocity.getDistanceFrom(v3f(1.0f, -2.5f, 0.0f) * BS) < BS / 64.0f);
+	UASSERT(std::fabs(out.rotation.Y - 270.0f) < 0.01f);
+	UASSERT(out.acceleration == v3f());
+	UASSERT(out.do_interpolate && !out.is_movement_end);
+	UASSERT(std::fabs(out.update_interval - 0.09f) < 0.001f);
+
+	// Periodic keyframe
+	for (u16 i = 1; i < ObjectMovementEncoder::KEYFRAME_INTERVAL; i++)
+		encoder.encode(makeMovement(pos), keyframe);
+	UASSERT(!keyframe);
+	encoder.encode(makeMovement(pos), keyframe);
+	UASSERT(keyframe);
+}
+
+void TestObjectMovement::testOutOfRange()
+{
+	ObjectMovementEncoder encoder;
+	bool keyframe;
+
+	encoder.encode(makeMovement(v3f(0, 0, 0)), keyframe);
+	encoder.encode(makeMovement(v3f(300 * BS, 0, 0)), keyframe);
+	UASSERT(keyframe);
+
+	ObjectMovement m = makeMovement(v3f(300 * BS, 0, 0));
+	m.velocity.Y = -1000 * BS;
+	encoder.encode(m, keyframe);
+	UASSERT(keyframe);
+}
+
+void TestObjectMovement::testMissingKeyframe()
+{
+	ObjectMovementEncoder encoder;
+	ObjectMovementDecoder decoder;
+	ObjectMovement out;
+	bool keyframe;
+
+	// First keyframe is lost
+	encoder.encode(makeMovement(v3f(0, 0, 0)), keyframe);
+	std::string delta = encoder.encode(makeMovement(v3f(1, 0, 0)), keyframe);
+	UASSERT(!decode(decoder, delta, out));
+
+	// Stale delta after a newer keyframe
+	std::string data = encoder.encode(makeMovement(v3f(5000, 0, 0)), keyframe);
+	UASSERT(keyframe);
+	UASSERT(decode(decoder, data, out));
+	UASSERT(!decode(decoder, delta, out));
+}
+
+void TestObjectMovement::testReference()
+{
+	ObjectMovementEncoder encoder;
+	ObjectMovementDecoder decoder;
+	ObjectMovement out;
+	bool keyframe;
+
+	UASSERT(encoder.encodeReference().empty());
+
+	encoder.encode(makeMovement(v3f(0, 0, 0)), keyframe);
+	std::string delta = encoder.encode(makeMovement(v3f(2, 0, 0)), keyframe);
+
+	// Reference updates the decoder state, but is not applied
+	UASSERT(!decode(decoder, encoder.encodeReference(), out));
+	UASSERT(decode(decoder, delta, out));
+	UASSERT(out.position.getDistanceFrom(v3f(2, 0, 0)) < BS / 128.0f);
+}
+
+// Previous update condition of LuaEntitySAO::step, for comparison
+struct LegacyUpdateCheck
+{
+	v3f last_position, last_velocity;
+	f32 timer = 0.0f;
+
+	bool needsUpdate(const v3f &position, const v3f &velocity)
+	{
+		f32 minchange = 0.2f * BS;
+		if (timer > 1.0f)
+			minchange = 0.01f * BS;
+		else if (timer > 0.2f)
+			minchange = 0.05f * BS;
+		return position.getDistanceFrom(last_position) > minchange ||
+			velocity.getDistanceFrom(last_velocity) > minchange;
+	}
+};
+
+void TestObjectMovement::testPredictionUpdateCount()
+{
+	const f32 dtime = 0.09f;
+	const f32 max_error = 0.2f * BS;
+
+	struct Scenario {
+		const char *name;
+		v3f velocity, acceleration;
+		// Velocity change at this step, to simulate a mod steering the entity
+		u32 turn_step;
+	};
+	const Scenario scenarios[] = {
+		{"walking", v3f(2.0f, 0.0f, 1.0f) * BS, v3f(), 100},
+		{"projectile", v3f(15.0f, 10.0f, 0.0f) * BS, v3f(0.0f, -9.81f, 0.0f) * BS, 1000},
+		{"resting", v3f(), v3f(), 1000},
+	};
+
+	u32 total_legacy = 0, total_predicted = 0;
+	for (const Scenario &sc : scenarios) {
+		v3f pos(0.0f, 0.0f, 0.0f), vel = sc.velocity;
+		LegacyUpdateCheck legacy;
+		MovementPredictor predictor;
+		u32 legacy_count = 0, predicted_count = 0;
+
+		for (u32 i = 0; i < 200; i++) {
+			if (i == sc.turn_step)
+				vel = v3f(-vel.Z, vel.Y, vel.X);
+			pos += (vel + sc.acceleration * 0.5f * dtime) * dtime;
+			vel += dtime * sc.acceleration;
+			legacy.timer += dtime;
+			predictor.step(dtime);
+
+			if (legacy.needsUpdate(pos, vel)) {
+				legacy = LegacyUpdateCheck{pos, vel, 0.0f};
+				legacy_count++;
+			}
+			if (predictor.needsUpdate(pos, vel, max_error)) {
+				predictor.reset(pos, vel, sc.acceleration);
+				predicted_count++;
+			}
+			// Clients never deviate more than allowed
+			UASSERT(predictor.getPosition().getDistanceFrom(pos) <= max_error);
+		}
+
+		rawstream << "    " << sc.name << ": " << legacy_count << " -> "
+			<< predicted_count << " updates in 200 steps" << std::endl;
+		UASSERT(predicted_count <= legacy_count);
+		total_legacy += legacy_count;
+		total_predicted += predicted_count;
+	}
+
+	// Predictable movement needs only a few corrections
+	UASSERT(total_predicted * 10 < total_legacy);
+}
+
+void TestObjectMovement::testPredictionQuantization()
+{
+	const f32 dtime = 0.09f;
+	const f32 max_error = 0.2f * BS;
+	// Almost half a velocity step off on every axis: the largest error
+	const f32 odd = 0.49f * BS / 64.0f;
+
+	ObjectMovementEncoder encoder;
+	ObjectMovementDecoder decoder;
+	MovementPredictor predictor;
+	// What the client extrapolates from the updates it decoded
+	MovementPredictor client;
+	v3f pos(0.0f, 0.0f, 0.0f), vel;
+	u32 updates = 0;
+	f32 time_since_update = 0.0f;
+
+	for (u32 i = 0; i < 1000; i++) {
+		// Steered by a mod now and then, so that deltas are sent
+		if (i % 100 == 0)
+			vel = v3f(1.0f + (i % 300 == 0 ? 1.0f : 0.0f), 0.5f, -0.25f) * BS +
+				v3f(odd, odd, -odd);
+		pos += vel * dtime;
+		predictor.step(dtime);
+		client.step(dtime);
+		time_since_update += dtime;
+
+		if (i == 0 || predictor.needsUpdate(pos, vel, max_error)) {
+			ObjectMovement m, sent, received;
+			m.position = pos;
+			m.velocity = vel;
+			bool keyframe;
+			std::string data = encoder.encode(m, keyframe, &sent);
+			UASSERT(decode(decoder, data, received));
+			UASSERT(received.position.getDistanceFrom(sent.position) < 0.001f);
+			UASSERT(received.velocity.getDistanceFrom(sent.velocity) < 0.001f);
+
+			predictor.reset(sent.position, sent.velocity, sent.acceleration);
+			client.reset(received.position, received.velocity,
+				received.acceleration);
+			updates++;
+			time_since_update = 0.0f;
+		}
+
+		// The server predicts what the client sees and corrects it in time
+		UASSERT(predictor.getPosition().getDistanceFrom(
+			client.getPosition()) < 0.01f);
+		UASSERT(client.getPosition().getDistanceFrom(pos) <= max_error);
+		UASSERT(time_since_update <= MovementPredictor::MAX_EXTRAPOLATION_TIME + dtime);
+	}
+
+	rawstream << "    quantized velocity: " << updates
+		<< " updates in 1000 steps" << std::endl;
+}
@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapgen/mg_schematic.h"
 #include "gamedef.h"
 #include "nodedef.h"
+#include "dummymap.h"
 
 class TestSchematic : public TestBase {
 public:
@@ -33,6 +34,7 @@ class TestSchematic : public TestBase {
 	void testMtsSerializeDeserialize(const NodeDefManager *ndef);
 	void testLuaTableSerialize(const NodeDefManager *ndef);
 	void testFileSerializeDeserialize(const NodeDefManager *ndef);
+	void testBlitToVManip(IGameDef *gamedef, const NodeDefManager *ndef);
 
 	static const content_t test_schem1_data[7 * 6 * 4];
 	static const content_t test_schem2_data[3 * 3 * 3];
@@ -52,6 +54,7 @@ void TestSchematic::runTests(IGameDef *gamedef)
 	TEST(testMtsSerializeDeserialize, ndef);
 	TEST(testLuaTableSerialize, ndef);
 	TEST(testFileSerializeDeserialize, ndef);
+	TEST(testBlitToVManip, gamedef, ndef);
 
 	ndef->resetNodeResolveState();
 }
@@ -187,6 +190,110 @@ void TestSchematic::testFileSerializeDeserialize(const NodeDefManager *ndef)
 }
 
 
+void TestSchematic::testBlitToVManip(IGameDef *gamedef, const NodeDefManager *ndef)
+{
+	static const v3s16 size(3, 2, 4);
+	static const u32 volume = size.X * size.Y * size.Z;
+
+	// Asymmetric schematic: stone and grass alternating, with a hole and
+	// two nodes that replace existing nodes
+	Schematic schem;
+	schem.size        = size;
+	schem.schemdata   = new MapNode[volume];
+	schem.slice_probs = new u8[size.Y];
+	for (s16 y = 0; y != size.Y; y++)
+		schem.slice_probs[y] = MTSCHEM_PROB_ALWAYS;
+	schem.m_nodenames = { "air", "default:stone", "default:dirt_with_grass" };
+	schem.m_nnlistsizes.push_back(schem.m_nodenames.size());
+
+	u32 i = 0;
+	for (s16 z = 0; z != size.Z; z++)
+	for (s16 y = 0; y != size.Y; y++)
+	for (s16 x = 0; x != size.X; x++, i++) {
+		u8 param1 = MTSCHEM_PROB_ALWAYS;
+		if (x == 0 && y == 0 && z == 2)
+			param1 = MTSCHEM_PROB_NEVER;
+		else if (y == 1 && z < 2)
+			param1 |= MTSCHEM_FORCE_PLACE;
+		schem.schemdata[i] = MapNode((x + z) % 2 ? 1 : 2, param1, 0);
+	}
+	ndef->pendNodeResolve(&schem);
+
+	const content_t c_stone = ndef->getId("default:stone");
+	const content_t c_grass = ndef->getId("default:dirt_with_grass");
+
+	// Placed at the edge of the voxel area: the schematic is partly clipped
+	v3s16 bp(0, 0, 0);
+	DummyMap map(gamedef, bp, bp);
+	v3s16 p(MAP_BLOCKSIZE - 3, 0, MAP_BLOCKSIZE - 3);
+
+	for (int r = ROTATE_0; r <= ROTATE_270; r++) {
+		Rotation rot = (Rotation)r;
+		MMVManip vm(&map);
+		vm.initialEmerge(bp, bp, false);
+		s32 vm_volume = vm.m_area.getVolume();
+		for (s32 vi = 0; vi < vm_volume; vi++)
+			vm.m_data[vi] = MapNode(CONTENT_AIR);
+		// Existing nodes below non-forced and forced schematic nodes
+		for (s16 x = 0; x != 3; x++) {
+			vm.setNodeNoEmerge(p + v3s16(x, 0, 0), MapNode(t_CONTENT_BRICK));
+			vm.setNodeNoEmerge(p + v3s16(x, 1, 0), MapNode(t_CONTENT_BRICK));
+		}
+
+		schem.blitToVManip(&vm, p, rot, false);
+
+		bool swap = (rot == ROTATE_90 || rot == ROTATE_270);
+		v3s16 rsize = swap ? v3s16(size.Z, size.Y, size.X) : size;
+		const v3s16 &em_min = vm.m_area.MinEdge, &em_max = vm.m_area.MaxEdge;
+		for (s16 vz = em_min.Z; vz <= em_max.Z; vz++)
+		for (s16 vy = em_min.Y; vy <= em_max.Y; vy++)
+		for (s16 vx = em_min.X; vx <= em_max.X; vx++) {
+			v3s16 rp = v3s16(vx, vy, vz) - p;
+			MapNode n = vm.getNodeNoExNoEmerge(v3s16(vx, vy, vz));
+			bool existing = rp.Z == 0 && rp.X >= 0 && rp.X < 3 &&
+				(rp.Y == 0 || rp.Y == 1);
+			content_t c_before = existing ? t_CONTENT_BRICK : CONTENT_AIR;
+
+			if (rp.X < 0 || rp.Y < 0 || rp.Z < 0 || rp.X >= rsize.X ||
+					rp.Y >= rsize.Y || rp.Z >= rsize.Z) {
+				UASSERTEQ(content_t, n.getContent(), c_before);
+				continue;
+			}
+
+			// Position in the unrotated schematic
+			s16 x = rp.X, z = rp.Z;
+			switch (rot) {
+			case ROTATE_90:
+				x = size.X - 1 - rp.Z;
+				z = rp.X;
+				break;
+			case ROTATE_180:
+				x = size.X - 1 - rp.X;
+				z = size.Z - 1 - rp.Z;
+				break;
+			case ROTATE_270:
+				x = rp.Z;
+				z = size.Z - 1 - rp.X;
+				break;
+			default:
+				break;
+			}
+			const MapNode &sn = schem.schemdata[
+				z * size.Y * size.X + rp.Y * size.X + x];
+
+			content_t expected = (x + z) % 2 ? c_stone : c_grass;
+			if ((sn.param1 & MTSCHEM_PROB_MASK) == MTSCHEM_PROB_NEVER ||
+					(existing && !(sn.param1 & MTSCHEM_FORCE_PLACE)))
+				expected = c_before;
+
+			UASSERTEQ(content_t, n.getContent(), expected);
+			if (expected != c_before)
+				UASSERTEQ(u8, n.param1, 0);
+		}
+	}
+}
+
+
 // Should form a cross-shaped-thing...?
 const content_t TestSchematic::test_schem1_data[7 * 6 * 4] = {
 	3, 3, 1, 1, 1, 3, 3, // Y=0, Z=0
@@ -34,6 +34,7 @@ class TestSettings : public TestBase {
 	void testAllSettings();
 	void testDefaults();
 	void testFlagDesc();
+	void testCachedSetting();
 
 	static const char *config_text_before;
 	static const std::string config_text_after;
@@ -46,6 +47,7 @@ void TestSettings::runTests(IGameDef *gamedef)
 	TEST(testAllSettings);
 	TEST(testDefaults);
 	TEST(testFlagDesc);
+	TEST(testCachedSetting);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -294,3 +296,35 @@ void TestSettings::testFlagDesc()
 
 	delete &s;
 }
+
+void TestSettings::testCachedSetting()
+{
+	Settings s;
+	s.set("cached_u32", "12");
+	s.setFloat("cached_float", 0.5f);
+
+	{
+		CachedSetting<u32> cached_u32("cached_u32", &s);
+		CachedSetting<float> cached_float("cached_float", &s);
+		UASSERTEQ(u32, cached_u32.get(), 12);
+		UASSERTEQ(float, cached_float, 0.5f);
+
+		s.set("cached_u32", "34");
+		s.setFloat("cached_float", -2.0f);
+		UASSERTEQ(u32, cached_u32, 34);
+		UASSERTEQ(float, cached_float, -2.0f);
+
+		// No default to fall back to
+		s.remove("cached_u32");
+		UASSERTEQ(u32, cached_u32, 34);
+	}
+
+	// Callbacks are gone with the cached settings
+	s.set("cached_u32", "56");
+
+	try {
+		CachedSetting<bool> missing("cached_missing", &s);
+		UASSERT(false);
+	} catch (SettingNotFoundException &e) {
+	}
+}
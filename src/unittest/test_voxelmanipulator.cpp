@@ -21,9 +21,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <algorithm>
 
+#include "dummymap.h"
 #include "gamedef.h"
 #include "log.h"
 #include "voxel.h"
+#include "lua_api/l_vmanip.h"
 
 class TestVoxelManipulator : public TestBase {
 public:
@@ -34,6 +36,7 @@ class TestVoxelManipulator : public TestBase {
 
 	void testVoxelArea();
 	void testVoxelManipulator(const NodeDefManager *nodedef);
+	void testDetachedMapgenVM(IGameDef *gamedef);
 };
 
 static TestVoxelManipulator g_test_instance;
@@ -42,6 +45,7 @@ void TestVoxelManipulator::runTests(IGameDef *gamedef)
 {
 	TEST(testVoxelArea);
 	TEST(testVoxelManipulator, gamedef->getNodeDefManager());
+	TEST(testDetachedMapgenVM, gamedef);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -106,3 +110,29 @@ void TestVoxelManipulator::testVoxelManipulator(const NodeDefManager *nodedef)
 	UASSERT(v.getNode(v3s16(-1,0,-1)).getContent() == t_CONTENT_GRASS);
 	EXCEPTION_CHECK(InvalidPositionException, v.getNode(v3s16(0,1,1)));
 }
+
+void TestVoxelManipulator::testDetachedMapgenVM(IGameDef *gamedef)
+{
+	v3s16 bpmin(0, 0, 0), bpmax(0, 0, 0);
+	DummyMap map(gamedef, bpmin, bpmax);
+	MMVManip mapgen_vm(&map);
+	mapgen_vm.initialEmerge(bpmin, bpmax, false);
+
+	// What the mapgen Lua environment does after on_generated
+	LuaVoxelManip o(&mapgen_vm, true);
+	o.detachMapgenVM();
+	UASSERT(o.vm != &mapgen_vm);
+	UASSERT(o.vm->isOrphan());
+	UASSERT(o.vm->m_area.hasEmptyExtent());
+
+	// The detached VoxelManip is empty, but still usable
+	v3s16 p(1, 2, 3);
+	UASSERT(!o.vm->setNodeNoEmerge(p, MapNode(t_CONTENT_GRASS)));
+	UASSERT(o.vm->getNodeNoExNoEmerge(p).getContent() == CONTENT_IGNORE);
+
+	o.vm->setNode(p, MapNode(t_CONTENT_GRASS));
+	UASSERT(o.vm->getNodeNoExNoEmerge(p).getContent() == t_CONTENT_GRASS);
+
+	// The mapgen VoxelManip is left alone
+	UASSERT(mapgen_vm.getNodeNoExNoEmerge(p).getContent() != t_CONTENT_GRASS);
+}
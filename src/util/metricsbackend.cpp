@@ -24,8 +24,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <prometheus/registry.h>
 #include <prometheus/counter.h>
 #include <prometheus/gauge.h>
+#include <mutex>
+#include <unordered_map>
 #include "log.h"
 #include "settings.h"
+#include "threading/mutex_auto_lock.h"
 #endif
 
 /* Plain implementation */
@@ -107,14 +110,10 @@ class PrometheusMetricCounter : public MetricCounter
 public:
 	PrometheusMetricCounter() = delete;
 
-	PrometheusMetricCounter(const std::string &name, const std::string &help_str,
-			MetricsBackend::Labels labels,
-			std::shared_ptr<prometheus::Registry> registry) :
+	PrometheusMetricCounter(prometheus::Family<prometheus::Counter> &family,
+			MetricsBackend::Labels labels) :
 			MetricCounter(),
-			m_family(prometheus::BuildCounter()
-							.Name(name)
-							.Help(help_str)
-							.Register(*registry)),
+			m_family(family),
 			m_counter(m_family.Add(labels))
 	{
 	}
@@ -134,14 +133,10 @@ class PrometheusMetricGauge : public MetricGauge
 public:
 	PrometheusMetricGauge() = delete;
 
-	PrometheusMetricGauge(const std::string &name, const std::string &help_str,
-			MetricsBackend::Labels labels,
-			std::shared_ptr<prometheus::Registry> registry) :
+	PrometheusMetricGauge(prometheus::Family<prometheus::Gauge> &family,
+			MetricsBackend::Labels labels) :
 			MetricGauge(),
-			m_family(prometheus::BuildGauge()
-							.Name(name)
-							.Help(help_str)
-							.Register(*registry)),
+			m_family(family),
 			m_gauge(m_family.Add(labels))
 	{
 	}
@@ -180,18 +175,41 @@ class PrometheusMetricsBackend : public MetricsBackend
 private:
 	std::unique_ptr<prometheus::Exposer> m_exposer;
 	std::shared_ptr<prometheus::Registry> m_registry;
+
+	// Metrics with the same name but different labels share a family
+	std::mutex m_families_mutex;
+	std::unordered_map<std::string, prometheus::Family<prometheus::Counter> *>
+			m_counter_families;
+	std::unordered_map<std::string, prometheus::Family<prometheus::Gauge> *>
+			m_gauge_families;
 };
 
 MetricCounterPtr PrometheusMetricsBackend::addCounter(
 		const std::string &name, const std::string &help_str, Labels labels)
 {
-	return std::make_shared<PrometheusMetricCounter>(name, help_str, labels, m_registry);
+	MutexAutoLock lock(m_families_mutex);
+	auto &family = m_counter_families[name];
+	if (!family) {
+		family = &prometheus::BuildCounter()
+				.Name(name)
+				.Help(help_str)
+				.Register(*m_registry);
+	}
+	return std::make_shared<PrometheusMetricCounter>(*family, labels);
 }
 
 MetricGaugePtr PrometheusMetricsBackend::addGauge(
 		const std::string &name, const std::string &help_str, Labels labels)
 {
-	return std::make_shared<PrometheusMetricGauge>(name, help_str, labels, m_registry);
+	MutexAutoLock lock(m_families_mutex);
+	auto &family = m_gauge_families[name];
+	if (!family) {
+		family = &prometheus::BuildGauge()
+				.Name(name)
+				.Help(help_str)
+				.Register(*m_registry);
+	}
+	return std::make_shared<PrometheusMetricGauge>(*family, labels);
 }
 
 MetricsBackend *createPrometheusMetricsBackend()
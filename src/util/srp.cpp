@@ -43,6 +43,7 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdint>
+#include <mutex>
 
 #include <config.h>
 
@@ -75,6 +76,8 @@ static int g_initialized = 0;
 #define RAND_BUFF_MAX 128
 static unsigned int g_rand_idx;
 static unsigned char g_rand_buff[RAND_BUFF_MAX];
+// The server runs SRP on several packet worker threads
+static std::mutex g_rand_mutex;
 
 void *(*srp_alloc)(size_t) = &malloc;
 void *(*srp_realloc)(void *, size_t) = &realloc;
@@ -556,6 +559,7 @@ static SRP_Result fill_buff()
 static SRP_Result mpz_fill_random(mpz_t num)
 {
 	// was call: BN_rand(num, 256, -1, 0);
+	std::lock_guard<std::mutex> lock(g_rand_mutex);
 	if (RAND_BUFF_MAX - g_rand_idx < 32)
 		if (fill_buff() != SRP_OK) return SRP_ERR;
 	mpz_from_bin((const unsigned char *)(&g_rand_buff[g_rand_idx]), 32, num);
@@ -565,6 +569,7 @@ static SRP_Result mpz_fill_random(mpz_t num)
 
 static SRP_Result init_random()
 {
+	std::lock_guard<std::mutex> lock(g_rand_mutex);
 	if (g_initialized) return SRP_OK;
 	SRP_Result ret = fill_buff();
 	g_initialized = (ret == SRP_OK);
@@ -612,6 +617,7 @@ SRP_Result srp_create_salted_verification_key( SRP_HashAlgorithm alg,
 	if (*bytes_s == NULL) {
 		size_t size_to_fill = 16;
 		*len_s = size_to_fill;
+		std::lock_guard<std::mutex> lock(g_rand_mutex);
 		if (RAND_BUFF_MAX - g_rand_idx < size_to_fill)
 			if (fill_buff() != SRP_OK) goto error_and_exit;
 		*bytes_s = (unsigned char *)srp_alloc(size_to_fill);